@@ -0,0 +1,62 @@
+"""
+Converte os espectros médios do acelerômetro (LOGS/FFT/LOGnnnn.BIN, registros de
+tipo 3, espectro.h) para CSV: uma linha por raia de cada eixo, com a frequência, a
+magnitude |X[k]| e a amplitude em g de uma senoide nessa raia.
+
+Uso: python decodifica_espectro.py pasta/LOGS/FFT [-o espectros.csv]
+     python decodifica_espectro.py LOG0000.BIN [LOG0001.BIN ...] [-o espectros.csv]
+"""
+import struct
+import sys
+
+from decodifica_log import registros_dos, segmentos
+
+TIPO_ESPECTRO = 3
+CABECALHO = struct.Struct('<IIHHBB3bx')
+EIXOS = ['accel_x', 'accel_y', 'accel_z']
+GANHO_JANELA = [1.0, 0.5, 0.54]  # Média dos pesos: retangular, Hann, Hamming
+CONTAGENS_POR_G = 16384.0
+
+
+def espectro(carga):
+    t0, t1, n, hz, quadros, janela, *expoentes = CABECALHO.unpack_from(carga, 0)
+    raias = n // 2 + 1
+    valores = struct.unpack_from(f'<{3 * raias}H', carga, CABECALHO.size)
+    linhas = []
+    for e, eixo in enumerate(EIXOS):
+        for k in range(raias):
+            magnitude = valores[e * raias + k] * 2.0 ** expoentes[e]
+            # Senoide de amplitude A na raia k: |X[k]| = A * n * ganho / 2 (a raia 0 não dobra)
+            amplitude = magnitude / (n * GANHO_JANELA[janela]) * (1 if k == 0 else 2) / CONTAGENS_POR_G
+            linhas.append([t0, t1, quadros, eixo, f'{k * hz / n:.3f}', f'{magnitude:.1f}', f'{amplitude:.6f}'])
+    return linhas
+
+
+def decodifica(arquivos, saida):
+    n = 0
+    with open(saida, 'w') as f:
+        f.write('t0_us,t1_us,quadros,eixo,freq_hz,magnitude,amplitude_g\n')
+        for _, tipo, carga in registros_dos(arquivos):
+            if tipo != TIPO_ESPECTRO:
+                continue
+            for linha in espectro(carga):
+                f.write(','.join(map(str, linha)) + '\n')
+            n += 1
+    print(f'{n} espectros gravados em {saida}')
+
+
+def main():
+    args = sys.argv[1:]
+    saida = 'espectros.csv'
+    if '-o' in args:
+        i = args.index('-o')
+        saida = args[i + 1]
+        del args[i:i + 2]
+    if not args:
+        print(__doc__)
+        sys.exit(1)
+    decodifica(segmentos(args), saida)
+
+
+if __name__ == '__main__':
+    main()
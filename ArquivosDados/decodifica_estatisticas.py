@@ -0,0 +1,55 @@
+"""
+Converte os registros de estatísticas por janela (LOGS/ESTAT/LOGnnnn.BIN, tipo 2,
+estatisticas.h) para CSV: uma linha por janela, com mínimo, máximo, média, RMS e
+desvio padrão de cada eixo, em g (acelerômetro) e °/s (giroscópio).
+
+Uso: python decodifica_estatisticas.py pasta/LOGS/ESTAT [-o estatisticas.csv]
+     python decodifica_estatisticas.py LOG0000.BIN [LOG0001.BIN ...] [-o estatisticas.csv]
+"""
+import struct
+import sys
+
+from decodifica_log import registros_dos, segmentos
+
+TIPO_ESTATISTICAS = 2
+JANELA = struct.Struct('<III')
+CANAL = struct.Struct('<hhfff')
+EIXOS = ['accel_x', 'accel_y', 'accel_z', 'giro_x', 'giro_y', 'giro_z']
+ESCALAS = [16384.0] * 3 + [131.0] * 3  # Contagens por g e por °/s (padrão do MPU6050)
+
+
+def janela(carga):
+    t0, t1, n = JANELA.unpack_from(carga, 0)
+    linha = [t0, t1, n]
+    for c, escala in enumerate(ESCALAS):
+        vmin, vmax, media, rms, desvio = CANAL.unpack_from(carga, JANELA.size + c * CANAL.size)
+        linha += [f'{v / escala:.5f}' for v in (vmin, vmax, media, rms, desvio)]
+    return linha
+
+
+def decodifica(arquivos, saida):
+    janelas = [janela(carga) for _, tipo, carga in registros_dos(arquivos)
+               if tipo == TIPO_ESTATISTICAS]
+    with open(saida, 'w') as f:
+        f.write(','.join(['t0_us', 't1_us', 'n'] +
+                         [f'{e}_{m}' for e in EIXOS for m in ('min', 'max', 'media', 'rms', 'desvio')]) + '\n')
+        for linha in janelas:
+            f.write(','.join(map(str, linha)) + '\n')
+    print(f'{len(janelas)} janelas gravadas em {saida}')
+
+
+def main():
+    args = sys.argv[1:]
+    saida = 'estatisticas.csv'
+    if '-o' in args:
+        i = args.index('-o')
+        saida = args[i + 1]
+        del args[i:i + 2]
+    if not args:
+        print(__doc__)
+        sys.exit(1)
+    decodifica(segmentos(args), saida)
+
+
+if __name__ == '__main__':
+    main()
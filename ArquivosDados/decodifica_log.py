@@ -0,0 +1,144 @@
+"""
+Converte os segmentos do log contínuo (LOGS/LOGnnnn.BIN) para CSV, com as
+amostras brutas (registros de tipo 0) ou comprimidas (tipo 1, compressao.h).
+
+Uso: python decodifica_log.py LOG0000.BIN [LOG0001.BIN ...] [-o amostras.csv]
+     python decodifica_log.py pasta/LOGS [-o amostras.csv]
+"""
+import glob
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = 0x474F4C52  # "RLOG"
+MAGIC_INDICE = 0x58444952  # "RIDX"
+TAM_INDICE = 512  # Bloco de índice no início do segmento (RING_LOG_INDEX_SIZE)
+CABECALHO = struct.Struct('<IIHHI')
+AMOSTRA = struct.Struct('<I3h3h')
+TIPO_BRUTO, TIPO_COMPRIMIDO = 0, 1
+
+
+def registros(dados):
+    """Registros válidos do segmento: (seq, tipo, carga). Para no primeiro inválido."""
+    # Os registros começam depois do índice; segmentos antigos não têm índice
+    pos = TAM_INDICE if dados[:4] == struct.pack('<I', MAGIC_INDICE) else 0
+    while pos + CABECALHO.size <= len(dados):
+        magic, seq, tam, segno, crc = CABECALHO.unpack_from(dados, pos)
+        n = tam & 0x1FFF
+        carga = dados[pos + CABECALHO.size:pos + CABECALHO.size + n]
+        if magic != MAGIC or len(carga) != n:
+            break
+        cab = CABECALHO.pack(magic, seq, tam, segno, 0)
+        if zlib.crc32(carga, zlib.crc32(cab)) != crc:
+            break
+        yield seq, tam >> 13, carga
+        pos += CABECALHO.size + n
+
+
+def ordem_do_anel(nomes):
+    """Segmentos de uma pasta do mais antigo ao mais novo. Os números dão a volta em
+    LOG9999: o mais novo é o que não tem sucessor, e o anel começa depois dele."""
+    numeros = {int(os.path.basename(n)[3:7]): n for n in nomes}
+    mais_novo = next(n for n in sorted(numeros) if (n + 1) % 10000 not in numeros)
+    return [numeros[n] for n in sorted(numeros, key=lambda n: (n - mais_novo - 1) % 10000)]
+
+
+def segmentos(args):
+    """Arquivos dos argumentos: as pastas em ordem de gravação, os arquivos como dados."""
+    arquivos = []
+    for a in args:
+        if os.path.isdir(a):
+            nomes = [n for n in glob.glob(os.path.join(a, 'LOG*.BIN'))
+                     if os.path.basename(n)[3:7].isdigit()]
+            arquivos += ordem_do_anel(nomes) if nomes else []
+        else:
+            arquivos.append(a)
+    return arquivos
+
+
+def registros_dos(arquivos):
+    """Registros de todos os segmentos, na ordem dos segmentos e, em cada um, na do
+    arquivo. A ordem de gravação vem daí, não do seq: logs de versões anteriores
+    recomeçavam o seq a cada "log start"."""
+    for nome in arquivos:
+        with open(nome, 'rb') as seg:
+            yield from registros(seg.read())
+
+
+def brutas(carga):
+    return [AMOSTRA.unpack_from(carga, i) for i in range(0, len(carga) - len(carga) % AMOSTRA.size, AMOSTRA.size)]
+
+
+def para_int16(v):
+    return (v + 0x8000) % 0x10000 - 0x8000
+
+
+def comprimidas(carga):
+    n = carga[0]
+    bits = carga[1:8]
+    t0, periodo = struct.unpack_from('<II', carga, 8)
+    v0 = struct.unpack_from('<6h', carga, 16)
+    fluxo = int.from_bytes(carga[28:], 'little')
+    pos = 0
+
+    def residuos(largura, quantos):
+        nonlocal pos
+        mascara = (1 << largura) - 1
+        saida = []
+        for _ in range(quantos):
+            z = (fluxo >> pos) & mascara
+            pos += largura
+            saida.append((z >> 1) ^ -(z & 1))  # zigzag inverso
+        return saida
+
+    t = [t0]
+    if n > 1:
+        t.append((t0 + periodo) & 0xFFFFFFFF)
+    for r in residuos(bits[0], max(n - 2, 0)):
+        t.append((t[-1] + periodo + r) & 0xFFFFFFFF)
+    canais = []
+    for c in range(6):
+        v = [v0[c]]
+        for r in residuos(bits[c + 1], n - 1):
+            v.append(para_int16(v[-1] + r))
+        canais.append(v)
+    return [(t[i], *(canais[c][i] for c in range(6))) for i in range(n)]
+
+
+def decodifica(arquivos, saida):
+    linhas = 0
+    brutos = comprimidos = 0
+    with open(saida, 'w') as f:
+        f.write('t_us,accel_x,accel_y,accel_z,giro_x,giro_y,giro_z\n')
+        for _, tipo, carga in registros_dos(arquivos):
+            if tipo == TIPO_BRUTO:
+                amostras = brutas(carga)
+                brutos += len(carga)
+            elif tipo == TIPO_COMPRIMIDO:
+                amostras = comprimidas(carga)
+                comprimidos += len(carga)
+            else:
+                continue
+            for a in amostras:
+                f.write(','.join(map(str, a)) + '\n')
+            linhas += len(amostras)
+    print(f'{linhas} amostras gravadas em {saida} '
+          f'({brutos} bytes brutos, {comprimidos} bytes comprimidos nos registros)')
+
+
+def main():
+    args = sys.argv[1:]
+    saida = 'amostras.csv'
+    if '-o' in args:
+        i = args.index('-o')
+        saida = args[i + 1]
+        del args[i:i + 2]
+    if not args:
+        print(__doc__)
+        sys.exit(1)
+    decodifica(segmentos(args), saida)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,63 @@
+"""
+Gera a semente do hash perfeito dos comandos do terminal (CMD_HASH_SEED em
+Cartao_FatFS_SPI.c): lê os nomes de cmds[] e procura a primeira semente, a partir
+da base do FNV-1a, para a qual eles caem em posições distintas de cmd_hash[].
+Rode depois de acrescentar ou renomear um comando; o build confere a semente
+com --verifica e para se ela não serve mais.
+
+Uso: python gera_hash_comandos.py [Cartao_FatFS_SPI.c]             (grava a semente)
+     python gera_hash_comandos.py --verifica [Cartao_FatFS_SPI.c]
+"""
+import os
+import re
+import sys
+
+BASE_FNV = 2166136261
+PRIMO_FNV = 16777619
+
+
+def nomes_e_bits(fonte):
+    tabela = re.search(r'static const cmd_def_t cmds\[\] = \{(.*?)\n\};', fonte, re.S).group(1)
+    nomes = re.findall(r'^ {4}\{"([^"]+)",', tabela, re.M)  # Início de cada entrada (as continuações têm mais recuo)
+    bits = int(re.search(r'#define CMD_HASH_BITS (\d+)', fonte).group(1))
+    return nomes, bits
+
+
+def posicao(nome, semente, bits):
+    h = semente
+    for b in nome.encode():
+        h = ((h ^ b) * PRIMO_FNV) & 0xFFFFFFFF  # Como cmd_hash_slot()
+    return h >> (32 - bits)
+
+
+def separa(nomes, semente, bits):
+    return len({posicao(n, semente, bits) for n in nomes}) == len(nomes)
+
+
+def main():
+    args = sys.argv[1:]
+    verifica = '--verifica' in args
+    args = [a for a in args if a != '--verifica']
+    arquivo = args[0] if args else os.path.join(os.path.dirname(__file__), '..', 'Cartao_FatFS_SPI.c')
+    with open(arquivo, encoding='utf-8') as f:
+        fonte = f.read()
+    nomes, bits = nomes_e_bits(fonte)
+    atual = re.search(r'#define CMD_HASH_SEED (0x[0-9A-Fa-f]+)u', fonte)
+    if verifica:
+        if not atual or not separa(nomes, int(atual.group(1), 16), bits):
+            print(f'{arquivo}: CMD_HASH_SEED não separa os {len(nomes)} comandos; '
+                  f'rode python ArquivosDados/gera_hash_comandos.py', file=sys.stderr)
+            sys.exit(1)
+        return
+    semente = BASE_FNV
+    while not separa(nomes, semente, bits):
+        semente = (semente + 1) & 0xFFFFFFFF
+    fonte = re.sub(r'#define CMD_HASH_SEED 0x[0-9A-Fa-f]+u', f'#define CMD_HASH_SEED 0x{semente:08X}u', fonte)
+    with open(arquivo, 'w', encoding='utf-8') as f:
+        f.write(fonte)
+    print(f'{len(nomes)} comandos em {1 << bits} posições: CMD_HASH_SEED 0x{semente:08X}u '
+          f'({semente - BASE_FNV + 1} sementes testadas)')
+
+
+if __name__ == '__main__':
+    main()
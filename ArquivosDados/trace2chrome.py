@@ -0,0 +1,59 @@
+"""
+Converte a saída de "trace dump" (linhas T,<us>,<núcleo>,<evento>,<B|E>,<arg>)
+para o formato JSON de trace do Chrome (chrome://tracing ou ui.perfetto.dev).
+
+Uso: python trace2chrome.py saida_terminal.txt [trace.json]
+"""
+import json
+import sys
+
+
+def converte(linhas):
+    eventos = []
+    pilhas = {}  # Eventos abertos por núcleo, para descartar fins sem início
+    base = None
+    anterior = None
+    volta = 0
+    for linha in linhas:
+        campos = linha.strip().split(',')
+        if len(campos) != 6 or campos[0] != 'T':
+            continue
+        t, nucleo, nome, fase, arg = int(campos[1]), int(campos[2]), campos[3], campos[4], int(campos[5])
+        # O contador de 32 bits em µs dá a volta a cada ~71 minutos
+        if anterior is not None and t < anterior:
+            volta += 1 << 32
+        anterior = t
+        t += volta
+        if base is None:
+            base = t
+        pilha = pilhas.setdefault(nucleo, [])
+        if fase == 'B':
+            pilha.append(nome)
+        else:
+            if nome not in pilha:
+                continue  # O início ficou fora do buffer circular
+            # Fecha também eventos internos que não registraram o fim
+            while pilha:
+                aberto = pilha.pop()
+                if aberto == nome:
+                    break
+                eventos.append({'name': aberto, 'ph': 'E', 'ts': t - base, 'pid': 0, 'tid': nucleo})
+        eventos.append({'name': nome, 'ph': fase, 'ts': t - base, 'pid': 0, 'tid': nucleo,
+                        'args': {'arg': arg}})
+    return eventos
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    with open(sys.argv[1], encoding='utf-8', errors='replace') as f:
+        eventos = converte(f)
+    saida = sys.argv[2] if len(sys.argv) > 2 else 'trace.json'
+    with open(saida, 'w') as f:
+        json.dump({'traceEvents': eventos, 'displayTimeUnit': 'ms'}, f)
+    print(f'{len(eventos)} eventos gravados em {saida}')
+
+
+if __name__ == '__main__':
+    main()
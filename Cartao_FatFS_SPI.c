@@ -16,15 +16,30 @@
 #include "ff.h"
 #include "diskio.h"
 #include "f_util.h"
+#include "ff_pool.h"
 #include "hw_config.h"
+#include "io_stats.h"
 #include "my_debug.h"
+#include "ring_log.h"
+#include "sd_trace.h"
 #include "rtc.h"
 #include "sd_card.h"
+#include "sd_volume.h"
 
 #include "lib/FatFs_SPI/buzzer.h"
 #include "lib/FatFs_SPI/ssd1306.h"
 #include "lib/FatFs_SPI/rgb.h"
 #include "lib/FatFs_SPI/matriz.h"
+#include "lib/FatFs_SPI/eventos.h"
+#include "lib/FatFs_SPI/aquisicao.h"
+#include "lib/FatFs_SPI/nucleo1.h"
+#include "lib/FatFs_SPI/compressao.h"
+#include "lib/FatFs_SPI/listagem.h"
+#include "lib/FatFs_SPI/csv.h"
+#include "lib/FatFs_SPI/decimacao.h"
+#include "lib/FatFs_SPI/estatisticas.h"
+#include "lib/FatFs_SPI/espectro.h"
+#include "lib/FatFs_SPI/gatilho.h"
 
 #define I2C_PORT_DISPLAY i2c1 // I2C1
 #define I2C_SDA_DISPLAY 14    // GPIO14 - SDA
@@ -49,12 +64,19 @@ const uint DEBOUNCE_MS = 200;
 
 int16_t aceleracao[3], gyro[3], temp;
 
-static void mpu6050_reset()
+// O reset do MPU6050 leva 100 ms; fica dividido em duas partes para que a
+// partida monte o cartão nesse meio tempo.
+static absolute_time_t mpu6050_reset_iniciar()
 {
     uint8_t buf[] = {0x6B, 0x80};
     i2c_write_blocking(I2C_PORT, addr, buf, 2, false);
-    sleep_ms(100);
-    buf[1] = 0x00;
+    return make_timeout_time_ms(100);
+}
+
+static void mpu6050_reset_concluir(absolute_time_t pronto)
+{
+    uint8_t buf[] = {0x6B, 0x00};
+    sleep_until(pronto);
     i2c_write_blocking(I2C_PORT, addr, buf, 2, false);
     sleep_ms(10);
 }
@@ -88,11 +110,13 @@ void gpio_callback(uint gpio, uint32_t events)
     {
         botaoA_pressionado = true;
         ultimo_tempo_botaoA = agora;
+        evt_post(EVT_BOTAO_A);
     }
     else if (gpio == botaoB && absolute_time_diff_us(ultimo_tempo_botaoB, agora) > DEBOUNCE_MS * 1000)
     {
         botaoB_pressionado = true;
         ultimo_tempo_botaoB = agora;
+        evt_post(EVT_BOTAO_B);
     }
 }
 
@@ -102,6 +126,38 @@ static absolute_time_t next_log_time;
 
 static char filename[20] = "MPU6050_data1.csv";
 
+// Log contínuo: segmentos de 4 MiB em LOGS/, trocados a cada hora ou quando cheios.
+// Os dados são confirmados no cartão (f_sync) a cada segundo ou 32 KiB, gastando
+// no máximo 5% do tempo nisso.
+#define LOG_HZ_PADRAO 100
+#define LOG_HZ_MAX 1000
+#define LOG_QUOTA_PCT 90 // Parte do cartão que os segmentos podem ocupar
+
+static ring_log_t ring_log = {
+    .dir = "LOGS",
+    .segment_size = 4 * 1024 * 1024,
+    .segment_ms = 60 * 60 * 1000,
+    .sync_bytes = 32 * 1024,
+    .sync_ms = 1000,
+    .sync_max_pct = 5,
+};
+
+// Logs resumidos ao lado do log bruto. Um por estágio do banco de decimação
+// (decimacao.h): LOGS/DEC10, LOGS/DEC100 e LOGS/DEC1000, com a taxa do log dividida
+// por 10, 100 e 1000; as estatísticas por janela (estatisticas.h) em LOGS/ESTAT; e
+// os espectros médios do acelerômetro (espectro.h) em LOGS/FFT. São poucos bytes
+// por segundo, então as confirmações são mais raras.
+#define RESUMO_QUOTA_PCT 1 // Parte do cartão para cada log resumido
+#define LOG_RESUMO(d) {.dir = d, .segment_size = 1024 * 1024, .segment_ms = 24 * 60 * 60 * 1000, \
+                       .sync_bytes = 4 * 1024, .sync_ms = 5000, .sync_max_pct = 1}
+#define ESTAT_JANELA_MS_PADRAO 1000
+#define ESP_N_PADRAO 512
+#define ESP_MEDIAS_PADRAO 8
+
+static ring_log_t dec_logs[DEC_ESTAGIOS] = {LOG_RESUMO("LOGS/DEC10"), LOG_RESUMO("LOGS/DEC100"), LOG_RESUMO("LOGS/DEC1000")};
+static ring_log_t estat_log = LOG_RESUMO("LOGS/ESTAT");
+static ring_log_t esp_log = LOG_RESUMO("LOGS/FFT");
+
 static sd_card_t *sd_get_by_name(const char *const name)
 {
     for (size_t i = 0; i < sd_get_num(); ++i)
@@ -120,6 +176,37 @@ static FATFS *sd_get_fs_by_name(const char *name)
     return NULL;
 }
 
+static FRESULT log_recuperar_um(ring_log_t *rl, uint32_t *n)
+{
+    uint32_t antes = rl->recovered;
+    FRESULT fr = ring_log_recover(rl);
+    *n += rl->recovered - antes;
+    return fr;
+}
+
+// Logo depois de montar o cartão dos logs: corta os segmentos que uma queda de
+// energia ou a remoção do cartão deixou no tamanho pré-alocado, para ls, cat e
+// range nunca verem o final não gravado, mesmo sem um novo log start.
+// Retorna os registros mantidos nesses segmentos.
+static uint32_t log_recuperar()
+{
+    uint32_t n = 0;
+    if (ring_log.is_open)
+        return n;
+    FRESULT fr = log_recuperar_um(&ring_log, &n);
+    for (int e = 0; e < DEC_ESTAGIOS && FR_OK == fr; e++)
+        fr = log_recuperar_um(&dec_logs[e], &n);
+    if (FR_OK == fr)
+        fr = log_recuperar_um(&estat_log, &n);
+    if (FR_OK == fr)
+        fr = log_recuperar_um(&esp_log, &n);
+    if (FR_OK != fr)
+        printf("[ERRO] Recuperação do log interrompido: %s (%d)\n", FRESULT_str(fr), fr);
+    else if (n)
+        printf("[INFO] Log interrompido: %lu registros recuperados em LOGS/\n", n);
+    return n;
+}
+
 static void run_setrtc()
 {
     const char *dateStr = strtok(NULL, " ");
@@ -181,9 +268,77 @@ static void run_setrtc()
     rtc_set_datetime(&t);
 }
 
+static void oled_show(char const *const linhas[2]);
+
+// Lê uma linha do terminal, com eco, e compara com "palavra". Desiste depois de
+// 15 s sem nenhuma tecla.
+static bool confirmar(const char *palavra)
+{
+    char resposta[16];
+    size_t n = 0;
+    int c;
+    printf("Digite \"%s\" e Enter para confirmar: ", palavra);
+    stdio_flush();
+    while (PICO_ERROR_TIMEOUT != (c = getchar_timeout_us(15 * 1000 * 1000)) && '\r' != c && '\n' != c)
+    {
+        if (('\b' == c || 127 == c) && n)
+        {
+            n--;
+            printf("\b \b");
+        }
+        else if (isprint(c) && n < sizeof resposta - 1)
+        {
+            resposta[n++] = (char)c;
+            printf("%c", c);
+        }
+        stdio_flush();
+    }
+    resposta[n] = '\0';
+    printf("\n");
+    return PICO_ERROR_TIMEOUT != c && 0 == strcmp(resposta, palavra);
+}
+
+// format [<drive#:>] [-t fat|fat32|exfat] [-c <bytes>] [-a <setores>] [-e]
+// Apaga o cartão inteiro, então não tem tecla de atalho e só segue depois de
+// "formatar" digitado por extenso.
+// O buffer de trabalho do f_mkfs é a reserva do log (64 KiB, livre com o log
+// parado): cada disk_write zera 128 setores de uma vez em vez de 2. Com -e a
+// FAT, o bitmap e a raiz são apagados pelo cartão (CMD38) em vez de escritos.
 static void run_format()
 {
-    const char *arg1 = strtok(NULL, " ");
+    const char *arg1 = NULL;
+    MKFS_PARM opt = {.fmt = FM_ANY};
+    const char *arg;
+    while ((arg = strtok(NULL, " ")))
+    {
+        if ('-' != arg[0])
+            arg1 = arg;
+        else if (0 == strcmp(arg, "-t") && (arg = strtok(NULL, " ")))
+        {
+            opt.fmt &= ~FM_ANY;
+            if (0 == strcasecmp(arg, "fat"))
+                opt.fmt |= FM_FAT;
+            else if (0 == strcasecmp(arg, "fat32"))
+                opt.fmt |= FM_FAT32;
+            else if (0 == strcasecmp(arg, "exfat"))
+                opt.fmt |= FM_EXFAT;
+            else
+                arg = NULL;
+        }
+        else if (0 == strcmp(arg, "-c") && (arg = strtok(NULL, " ")))
+            opt.au_size = strtoul(arg, NULL, 0);
+        else if (0 == strcmp(arg, "-a") && (arg = strtok(NULL, " ")))
+            opt.align = strtoul(arg, NULL, 0);
+        else if (0 == strcmp(arg, "-e"))
+            opt.fmt |= FM_ERASE;
+        else
+            arg = NULL;
+        if (!arg)
+        {
+            printf("Uso: format [<drive#:>] [-t fat|fat32|exfat] [-c <bytes>] [-a <setores>] [-e]\n");
+            return;
+        }
+    }
     if (!arg1)
         arg1 = sd_get_by_num(0)->pcName;
     FATFS *p_fs = sd_get_fs_by_name(arg1);
@@ -194,9 +349,24 @@ static void run_format()
         rgb_set_color("amarelo");
         return;
     }
+    if (aq_ativo)
+    {
+        printf("[ERRO] Log contínuo em andamento. Use \"log stop\" antes de formatar.\n");
+        return;
+    }
+    printf("\nTodos os arquivos de %s serão apagados.\n", arg1);
+    if (!confirmar("formatar"))
+    {
+        printf("Formatação cancelada.\n");
+        return;
+    }
 
+    printf("\nProcesso de formatação do SD iniciado. Aguarde...\n");
+    oled_show((char const *const[2]){"Formatacao", "Iniciada..."});
     rgb_set_color("azul");
-    FRESULT fr = f_mkfs(arg1, 0, 0, FF_MAX_SS * 2);
+    uint64_t t0 = time_us_64();
+    FRESULT fr = f_mkfs(arg1, &opt, aq_reserva, sizeof aq_reserva);
+    uint64_t us = time_us_64() - t0;
 
     if (FR_OK != fr)
     {
@@ -205,11 +375,51 @@ static void run_format()
         rgb_set_color("verde");
         return;
     }
-    
+    printf("Formatado em %llu.%03llu s.\n", us / 1000000, us / 1000 % 1000);
+    printf("\nFormatação concluída.\n\n");
+    oled_show((char const *const[2]){"Formatacao", "Concluida"});
+
     blinking_rgb(25, 50, "azul");
     rgb_set_color("verde");
 }
 
+// resync [<drive#:>]: copia o cartão em dia de um espelho sobre o que perdeu
+// gravações, usando a reserva do log como buffer. Com o volume desmontado.
+static void run_resync()
+{
+    const char *arg1 = strtok(NULL, " ");
+    if (!arg1)
+        arg1 = sd_get_by_num(0)->pcName;
+    sd_card_t *pSD = sd_get_by_name(arg1);
+    if (!pSD || !pSD->volume)
+    {
+        printf("\"%s\" não é um volume espelhado\n", arg1);
+        return;
+    }
+    if (aq_ativo)
+    {
+        printf("[ERRO] Log contínuo em andamento. Use \"log stop\" antes.\n");
+        return;
+    }
+    if (pSD->mounted)
+    {
+        printf("[ERRO] Desmonte o volume (unmount) antes de ressincronizar.\n");
+        return;
+    }
+    rgb_set_color("azul");
+    uint64_t t0 = time_us_64();
+    int st = sd_volume_resync(pSD, (uint8_t *)aq_reserva, sizeof aq_reserva);
+    uint64_t us = time_us_64() - t0;
+    if (SD_BLOCK_DEVICE_ERROR_NONE != st)
+    {
+        blinking_rgb(25, 50, "magenta");
+        rgb_set_color("amarelo");
+        return;
+    }
+    printf("Ressincronizado em %llu s. Monte o volume (mount).\n", us / 1000000);
+    rgb_set_color("amarelo");
+}
+
 static void run_mount()
 {
     const char *arg1 = strtok(NULL, " ");
@@ -243,6 +453,8 @@ static void run_mount()
     pSD->mounted = true;
     printf("Processo de montagem do SD ( %s ) concluído\n", pSD->pcName);
     printf("SD 100%% montado\n");
+    if (sd_get_by_num(0) == pSD)
+        log_recuperar();
 
     rgb_set_color("verde");
     buzzer_beep(4000, 50, 2);
@@ -264,6 +476,11 @@ static void run_unmount()
         rgb_set_color("amarelo");
         return;
     }
+    if (aq_ativo)
+    {
+        printf("[ERRO] Log contínuo em andamento. Use \"log stop\" antes de desmontar.\n");
+        return;
+    }
 
     FRESULT fr = f_unmount(arg1);
 
@@ -321,66 +538,99 @@ static void run_getfree()
     printf("%10lu KiB total drive space.\n%10lu KiB available.\n", tot_sect / 2, fre_sect / 2);
 }
 
+// A listagem usa a reserva do log como área de trabalho, como o format.
+_Static_assert(sizeof(ls_trabalho_t) <= sizeof aq_reserva, "ls_trabalho_t não cabe na reserva do log");
+
 static void run_ls()
 {
-    const char *arg1 = strtok(NULL, " ");
-    if (!arg1)
-        arg1 = "";
-    char cwdbuf[FF_LFN_BUF] = {0};
-    FRESULT fr;
-    char const *p_dir;
-    if (arg1[0])
+    ls_opcoes_t op = {.ordenar = true, .ordem = LS_NOME, .por_pagina = LS_POR_PAGINA};
+    const char *alvo = NULL;
+    const char *arg;
+    while ((arg = strtok(NULL, " ")))
     {
-        p_dir = arg1;
+        if ('-' != arg[0])
+        {
+            alvo = arg;
+            continue;
+        }
+        for (const char *c = arg + 1; *c; c++)
+        {
+            if ('l' == *c)
+                op.longo = true;
+            else if ('s' == *c)
+                op.ordem = LS_TAMANHO;
+            else if ('t' == *c)
+                op.ordem = LS_DATA;
+            else if ('f' == *c)
+                op.ordenar = false;
+            else if ('r' == *c)
+                op.inverso = true;
+            else if ('p' == *c && (arg = strtok(NULL, " ")) && atoi(arg) > 0)
+                op.pagina = atoi(arg);
+            else
+            {
+                printf("Uso: ls [-l] [-s | -t | -f] [-r] [-p <página>] [<pasta>] [<padrão>]\n");
+                return;
+            }
+        }
     }
-    else
+
+    // "LOGS/*.BIN": pasta e padrão; "*.csv": padrão na pasta atual; "LOGS": só a pasta
+    char caminho[FF_LFN_BUF] = {0};
+    const char *padrao = NULL;
+    FRESULT fr = FR_OK;
+    if (alvo && strpbrk(alvo, "*?"))
     {
-        fr = f_getcwd(cwdbuf, sizeof cwdbuf);
-        if (FR_OK != fr)
+        const char *barra = strrchr(alvo, '/');
+        if (barra)
         {
-            printf("f_getcwd error: %s (%d)\n", FRESULT_str(fr), fr);
-            blinking_rgb(25, 50, "magenta");
-            rgb_set_color("amarelo");
-            return;
+            snprintf(caminho, sizeof caminho, "%.*s", (int)(barra - alvo), alvo);
+            if (!caminho[0])
+                strcpy(caminho, "/");
+            padrao = barra + 1;
+        }
+        else
+        {
+            padrao = alvo;
+            alvo = NULL;
         }
-        p_dir = cwdbuf;
     }
-
-    printf("Directory Listing: %s\n\n", p_dir);
-    DIR dj;
-    FILINFO fno;
-    memset(&dj, 0, sizeof dj);
-    memset(&fno, 0, sizeof fno);
-    fr = f_findfirst(&dj, &fno, p_dir, "*");
-
+    else if (alvo)
+        snprintf(caminho, sizeof caminho, "%s", alvo);
+    if (!alvo)
+        fr = f_getcwd(caminho, sizeof caminho);
     if (FR_OK != fr)
     {
-        printf("f_findfirst error: %s (%d)\n", FRESULT_str(fr), fr);
+        printf("f_getcwd error: %s (%d)\n", FRESULT_str(fr), fr);
         blinking_rgb(25, 50, "magenta");
         rgb_set_color("amarelo");
         return;
     }
 
-    while (fr == FR_OK && fno.fname[0])
+    if (aq_ativo)
     {
-        rgb_set_color("azul");
-        const char *pcWritableFile = "writable file",
-                   *pcReadOnlyFile = "read only file",
-                   *pcDirectory = "directory";
-        const char *pcAttrib;
-        if (fno.fattrib & AM_DIR)
-            pcAttrib = pcDirectory;
-        else if (fno.fattrib & AM_RDO)
-            pcAttrib = pcReadOnlyFile;
-        else
-            pcAttrib = pcWritableFile;
-        printf("%s [%s] [size=%llu]\n", fno.fname, pcAttrib, fno.fsize);
-
-        fr = f_findnext(&dj, &fno);
+        printf("[ERRO] Log contínuo em andamento: o ls usa a reserva dele. Use \"log stop\" antes.\n");
+        return;
+    }
+    printf("Directory Listing: %s%s%s\n\n", caminho, padrao ? " " : "", padrao ? padrao : "");
+    rgb_set_color("azul");
+    ls_resumo_t r;
+    fr = ls_listar(caminho, padrao, &op, &r, (ls_trabalho_t *)aq_reserva);
+    if (FR_OK != fr)
+    {
+        printf("f_readdir_batch error: %s (%d)\n", FRESULT_str(fr), fr);
+        blinking_rgb(25, 50, "magenta");
+        rgb_set_color("amarelo");
+        return;
     }
 
-    f_closedir(&dj);
-
+    printf("\n%lu itens (%lu pastas, %llu bytes em arquivos) em %lu ms\n", r.itens, r.pastas,
+           r.bytes, r.us / 1000);
+    if (op.pagina)
+        printf("Página %lu de %lu\n", op.pagina, (r.itens + op.por_pagina - 1) / op.por_pagina);
+    if (r.truncado)
+        printf("Só os primeiros %u itens foram ordenados; use um padrão ou -f para ver todos.\n",
+               LS_MAX_ITENS);
     blinking_rgb(25, 50, "azul");
     rgb_set_color("verde");
 }
@@ -403,19 +653,143 @@ static void run_cat()
     char buf[256];
     while (f_gets(buf, sizeof buf, &fil))
     {
-        printf("%s", buf);
+        fputs(buf, stdout);
     }
     fr = f_close(&fil);
     if (FR_OK != fr)
         printf("f_open error: %s (%d)\n", FRESULT_str(fr), fr);
 }
 
+// Trecho de um segmento do log sem lê-lo desde o início: a busca binária no índice
+// do segmento (ring_log.h) dá o registro de onde partir, e o f_lseek chega nele pela
+// tabela de clusters do arquivo (fast seek), sem percorrer a FAT. Segmentos sem
+// índice (de versões anteriores) são lidos desde o início.
+#define RANGE_CLMT 32 // Entradas da tabela de clusters: até 15 fragmentos
+
+static amostra_t range_carga[RING_LOG_MAX_RECORD / sizeof(amostra_t)];
+static amostra_t range_amostras[255]; // Um registro comprimido expandido
+
+static void run_range()
+{
+    char *arq = strtok(NULL, " ");
+    char *arg_t0 = strtok(NULL, " ");
+    char *arg_t1 = strtok(NULL, " ");
+    if (!arq || !arg_t0 || !arg_t1)
+    {
+        printf("Uso: range <segmento> <t0> <t1>, em segundos desde o início do segmento\n");
+        return;
+    }
+    int64_t t0 = (int64_t)(atof(arg_t0) * 1e6), t1 = (int64_t)(atof(arg_t1) * 1e6);
+    if (t0 < 0 || t1 < t0)
+    {
+        printf("Intervalo inválido\n");
+        return;
+    }
+    uint32_t inicio = time_us_32();
+    FIL fil;
+    FRESULT fr = f_open(&fil, arq, FA_READ);
+    if (FR_OK != fr)
+    {
+        printf("f_open error: %s (%d)\n", FRESULT_str(fr), fr);
+        return;
+    }
+    DWORD clmt[RANGE_CLMT];
+    clmt[0] = RANGE_CLMT;
+    fil.cltbl = clmt;
+    fr = f_lseek(&fil, CREATE_LINKMAP);
+    if (FR_NOT_ENOUGH_CORE == fr)
+    {
+        fil.cltbl = NULL; // Fragmentado demais: f_lseek normal
+        fr = FR_OK;
+    }
+    // Estático só para não ocupar 512 bytes da pilha; nada dele passa de uma consulta
+    // para a seguinte, senão o segno de um segmento valeria para o outro
+    static ring_log_index_t idx;
+    memset(&idx, 0, sizeof idx);
+    if (FR_OK == fr)
+        fr = ring_log_read_index(&fil, &idx);
+    // Sem índice, os tempos contam da primeira amostra do segmento
+    uint64_t base = idx.count ? idx.entry[0].t_us : 0, t = base;
+    bool tem_base = idx.count;
+    int k = idx.count ? ring_log_index_find(&idx, base + t0) : -1;
+    if (FR_OK == fr && k >= 0)
+    {
+        t = idx.entry[k].t_us;
+        fr = f_lseek(&fil, idx.entry[k].offset);
+    }
+    FSIZE_t partida = f_tell(&fil);
+
+    uint32_t registros = 0, amostras = 0;
+    bool fim = false;
+    printf("t_us,accel_x,accel_y,accel_z,giro_x,giro_y,giro_z\n");
+    while (FR_OK == fr && !fim)
+    {
+        ring_log_rec_t h;
+        bool valido;
+        fr = ring_log_read(&fil, &h, range_carga, sizeof range_carga, &valido);
+        if (FR_OK != fr || !valido || (idx.magic && h.segno != idx.segno))
+            break;
+        registros++;
+        uint32_t tipo = h.len >> RING_LOG_TYPE_SHIFT, n;
+        const amostra_t *a = range_carga;
+        if (0 == tipo)
+            n = (h.len & RING_LOG_LEN_MASK) / sizeof(amostra_t);
+        else if (COMP_TIPO_REGISTRO == tipo)
+        {
+            n = comp_expandir((const uint8_t *)range_carga, h.len & RING_LOG_LEN_MASK, range_amostras);
+            a = range_amostras;
+        }
+        else
+            continue; // Registros sem amostras
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (!tem_base) // Primeira amostra de um segmento sem índice
+            {
+                base = t = a[i].t_us;
+                tem_base = true;
+            }
+            t += (int64_t)(int32_t)(a[i].t_us - (uint32_t)t); // Desdobra a volta de t_us
+            int64_t rel = (int64_t)(t - base);
+            if (rel < t0)
+                continue;
+            if (rel > t1)
+            {
+                fim = true;
+                break;
+            }
+            printf("%lu,%d,%d,%d,%d,%d,%d\n", (unsigned long)a[i].t_us, a[i].accel[0], a[i].accel[1],
+                   a[i].accel[2], a[i].gyro[0], a[i].gyro[1], a[i].gyro[2]);
+            amostras++;
+        }
+    }
+    FRESULT fr2 = f_close(&fil);
+    if (FR_OK == fr)
+        fr = fr2;
+    if (FR_OK != fr)
+        printf("Erro de leitura: %s (%d)\n", FRESULT_str(fr), fr);
+    if (k >= 0)
+        printf("\n%lu amostras; busca pela entrada %d de %u do índice", amostras, k + 1, idx.count);
+    else
+        printf("\n%lu amostras; %s", amostras, idx.count ? "t0 antes do índice" : "segmento sem índice");
+    printf(", %lu registros lidos a partir do byte %llu em %lu ms\n", registros,
+           (unsigned long long)partida, (time_us_32() - inicio) / 1000);
+}
+
 // Função para capturar dados e salvar no arquivo *.txt
 void capture_data()
 {
     rgb_set_color("vermelho");
     buzzer_beep(6000, 150, 1);
 
+    if (aq_ativo)
+    {
+        // Com o log gravando, a captura vira um evento com as amostras de antes do disparo
+        gat_disparar();
+        printf("\n[INFO] Evento marcado: %lu ms antes e %lu ms depois vão para %s/.\n",
+               gat.pre_us / 1000, gat.pos_us / 1000, GAT_DIR);
+        return;
+    }
+
     printf("\nCapturando dados do MPU6050. Aguarde finalização...\n");
     FIL file;
     FRESULT res = f_open(&file, filename, FA_WRITE | FA_CREATE_ALWAYS);
@@ -428,9 +802,10 @@ void capture_data()
         return;
     }
 
-    const char *header = "numero_amostra,accel_x,accel_y,accel_z,giro_x,giro_y,giro_z\n";
-    UINT bw;
-    f_write(&file, header, strlen(header), &bw);
+    // As linhas se acumulam em um setor (FFMT) e são convertidas sem sprintf (csv.h)
+    static FFMT csv;
+    f_fmt_init(&csv, &file);
+    f_fmt_puts(&csv, "numero_amostra,accel_x,accel_y,accel_z,giro_x,giro_y,giro_z\n");
 
     for (int i = 0; i < 128; i++)
     {
@@ -461,22 +836,33 @@ void capture_data()
         if (yaw < -180.0f)
             yaw += 360.0f;
 
-        char buffer[80];
-        sprintf(buffer, "%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", i + 1, ax, ay, az, roll, pitch, yaw);
-
-        UINT bw;
-        res = f_write(&file, buffer, strlen(buffer), &bw);
-        if (res != FR_OK)
+        // Mesmo texto de "%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n"
+        f_fmt_int(&csv, i + 1);
+        for (int c = 0; c < 3; c++)
+            csv_bruto(&csv, aceleracao[c], 14); // aceleracao / 16384.0f
+        csv_float2(&csv, roll);
+        csv_float2(&csv, pitch);
+        csv_float2(&csv, yaw);
+        f_fmt_putc(&csv, '\n');
+
+        if ((i + 1) % 32 == 0 && FR_OK == f_fmt_flush(&csv))
+            f_sync(&file); // Confirma o que já foi capturado, caso falte energia
+        if (csv.res != FR_OK)
         {
             printf("[ERRO] Não foi possível escrever no arquivo. Monte o Cartao.\n");
             blinking_rgb(25, 50, "magenta");
             rgb_set_color("amarelo");
             f_close(&file);
+            npClear();
+            npWrite();
             return;
         }
+        printLevelBar((i + 1) * 100 / 128); // Progresso da captura na matriz de LEDs
         sleep_ms(50);
     }
 
+    npClear();
+    npWrite();
     rgb_set_color("verde");
     buzzer_beep(6000, 150, 2);
 
@@ -517,44 +903,1024 @@ void read_file(const char *filename)
     printf("\nLeitura do arquivo %s concluída.\n\n", filename);
 }
 
-static void run_help()
+static void run_read()
 {
-    printf("\nComandos disponíveis:\n\n");
-    printf("Digite 'a' para montar o cartão SD\n");
-    printf("Digite 'b' para desmontar o cartão SD\n");
-    printf("Digite 'c' para listar arquivos\n");
-    printf("Digite 'd' para mostrar conteúdo do arquivo\n");
-    printf("Digite 'e' para obter espaço livre no cartão SD\n");
-    printf("Digite 'f' para capturar dados do MPU6050 e salvar no arquivo\n");
-    printf("Digite 'g' para formatar o cartão SD\n");
-    printf("Digite 'h' para exibir os comandos disponíveis\n");
-    printf("\nEscolha o comando:  ");
+    const char *arg1 = strtok(NULL, " ");
+    if (!arg1)
+        arg1 = filename;
+    read_file(arg1);
+}
+
+static void run_capture()
+{
+    capture_data();
+}
+
+// Estado do cartão para o log: removido (ou falhando) e recolocado sem perder amostras.
+#define CARTAO_PROCURA_MS 1000 // Intervalo entre tentativas de montar o cartão de novo
+
+static bool log_suspenso = false;    // Log ativo, amostras indo para a reserva em RAM
+static bool reserva_cheia = false;   // Já avisou que a reserva encheu
+static bool cartao_remontar = false; // Cartão estava montado quando se perdeu
+static repeating_timer_t cartao_timer;
+static bool cartao_timer_ativo = false;
+
+// Bloco a gravar no log: comprimido pelo núcleo 1 (compressao.h) ou bruto.
+typedef struct
+{
+    const amostra_t *amostras;
+    uint32_t n;
+    bool da_reserva;
+    uint32_t tam; // Bytes comprimidos em dados; 0: gravar as amostras brutas
+    uint8_t dados[AQ_BLOCO * sizeof(amostra_t)];
+} log_bloco_t;
+
+static log_bloco_t log_blocos[2];
+static bool log_bruto = true;         // false com "log start ... -e": só os logs resumidos
+static bool log_comprimir = true;     // false com "log start ... -r"
+static bool estat_nova = false;       // Janela de estatísticas fechada, ainda não mostrada no display
+static const char *const esp_janelas[] = {"retangular", "Hann", "Hamming"};
+static uint64_t log_bytes_amostras;   // Amostras gravadas, em bytes brutos
+static uint64_t log_bytes_gravados;   // Bytes de registro efetivamente gravados
+static uint64_t log_comp_us;          // Tempo gasto comprimindo
+
+// Tempo de uma amostra em us desde o boot, para o índice dos segmentos: t_us dá a
+// volta a cada 71 min, mas uma amostra chega ao log bem antes disso. As janelas de
+// estatísticas e os espectros, que podem ser longos, entram pela última amostra.
+static uint64_t amostra_us64(uint32_t t_us)
+{
+    uint64_t agora = time_us_64();
+    return agora - (uint32_t)((uint32_t)agora - t_us);
+}
+
+static void log_comprimir_bloco(void *arg)
+{
+    log_bloco_t *b = arg;
+    uint32_t t0 = time_us_32();
+    b->tam = comp_bloco(b->amostras, b->n, b->dados);
+    log_comp_us += time_us_32() - t0;
 }
 
+// Grava nos logs resumidos as saídas acumuladas de cada estágio de decimação, a cada
+// AQ_BLOCO saídas, a janela de estatísticas que fechou e o espectro médio completo.
+// Com "tudo", também o que houver de saídas, a janela e a média incompletas.
+static FRESULT resumos_gravar(bool tudo)
+{
+    FRESULT fr = FR_OK;
+    if (tudo)
+        nucleo1_aguardar(); // Termina o quadro do espectro em cálculo
+    while (FR_OK == fr && esp_fechar(tudo))
+    {
+        fr = ring_log_write_at(&esp_log, ESP_TIPO_REGISTRO, &esp.registro, esp_tamanho_registro(),
+                               amostra_us64(esp.registro.t1_us));
+        if (FR_OK == fr)
+            esp.pronto = false;
+    }
+    if (tudo && estat.n && !estat.tem_pronto)
+        estat_fechar();
+    if (estat.tem_pronto)
+    {
+        fr = ring_log_write_at(&estat_log, ESTAT_TIPO_REGISTRO, &estat.pronto, sizeof estat.pronto,
+                               amostra_us64(estat.pronto.t1_us));
+        if (FR_OK == fr)
+        {
+            estat.tem_pronto = false;
+            estat_nova = true;
+        }
+    }
+    for (int e = 0; e < DEC_ESTAGIOS && FR_OK == fr; e++)
+    {
+        dec_estagio_t *d = &dec_estagios[e];
+        if (d->n_saida >= AQ_BLOCO || (tudo && d->n_saida))
+        {
+            fr = ring_log_write_at(&dec_logs[e], 0, d->saida, d->n_saida * sizeof(amostra_t),
+                                   amostra_us64(d->saida[0].t_us));
+            if (FR_OK == fr)
+                d->n_saida = 0;
+        }
+    }
+    return fr;
+}
+
+static FRESULT log_gravar_bloco(const log_bloco_t *b)
+{
+    uint32_t bruto = b->n * sizeof(amostra_t);
+    if (log_bruto)
+    {
+        uint64_t t = amostra_us64(b->amostras[0].t_us);
+        FRESULT fr = b->tam ? ring_log_write_at(&ring_log, COMP_TIPO_REGISTRO, b->dados, b->tam, t)
+                            : ring_log_write_at(&ring_log, 0, b->amostras, bruto, t);
+        if (FR_OK != fr)
+            return fr;
+        log_bytes_amostras += bruto;
+        log_bytes_gravados += sizeof(ring_log_rec_t) + (b->tam ? b->tam : bruto);
+    }
+    // Cada amostra passa pelos filtros e pelas estatísticas uma única vez, depois de
+    // estar no log bruto
+    dec_bloco(b->amostras, b->n);
+    estat_bloco(b->amostras, b->n);
+    esp_bloco(b->amostras, b->n);
+    FRESULT fr = gat_bloco(b->amostras, b->n);
+    if (b->da_reserva)
+        aq_reserva_liberar();
+    else
+        aq_liberar(b->n);
+    return FR_OK == fr ? resumos_gravar(false) : fr;
+}
+
+// Grava no log os blocos da reserva e os blocos completos da fila; com "tudo", também
+// o bloco incompleto. Um bloco só deixa a memória depois de gravado. O núcleo 1
+// comprime o bloco seguinte enquanto o núcleo 0 grava o anterior.
+static FRESULT log_drenar(bool tudo)
+{
+    FRESULT fr = FR_OK;
+    log_bloco_t *pronto = NULL; // Já comprimido, esperando a gravação
+    for (uint32_t k = 0; FR_OK == fr; k ^= 1)
+    {
+        log_bloco_t *b = &log_blocos[k];
+        b->amostras = aq_bloco_seguinte(pronto ? 1 : 0, &b->da_reserva);
+        if (!b->amostras)
+            break;
+        b->n = AQ_BLOCO;
+        b->tam = 0;
+        bool paralelo = log_comprimir && nucleo1_executar(log_comprimir_bloco, b);
+        if (pronto)
+            fr = log_gravar_bloco(pronto);
+        if (paralelo)
+            nucleo1_aguardar();
+        else if (log_comprimir)
+            log_comprimir_bloco(b); // Núcleo 1 ocupado com outra tarefa
+        pronto = b;
+    }
+    if (FR_OK == fr && pronto)
+        fr = log_gravar_bloco(pronto);
+    uint32_t resto = aq_pendentes();
+    if (FR_OK == fr && tudo && resto)
+    {
+        log_bloco_t *b = &log_blocos[0];
+        *b = (log_bloco_t){.amostras = aq_inicio(), .n = resto};
+        if (log_comprimir)
+            log_comprimir_bloco(b);
+        fr = log_gravar_bloco(b);
+    }
+    if (FR_OK == fr && tudo)
+        fr = resumos_gravar(true);
+    if (FR_OK == fr)
+        fr = ring_log_service(&ring_log); // Prepara o próximo segmento e aplica a cota
+    for (int e = 0; e < DEC_ESTAGIOS && FR_OK == fr; e++)
+        fr = ring_log_service(&dec_logs[e]);
+    if (FR_OK == fr)
+        fr = ring_log_service(&estat_log);
+    if (FR_OK == fr)
+        fr = ring_log_service(&esp_log);
+    // Com a compressão em dia, o núcleo 1 calcula o próximo quadro do espectro
+    esp_quadro_t *q = tudo ? NULL : esp_pendente();
+    if (q)
+    {
+        q->estado = ESP_CALCULANDO;
+        if (!nucleo1_executar(esp_calcular, q))
+            q->estado = ESP_CHEIO;
+    }
+    return fr;
+}
+
+static void log_parar()
+{
+    aq_parar();
+    if (log_suspenso)
+    {
+        printf("[AVISO] Cartão ausente: %lu blocos guardados na RAM descartados.\n", aq_reserva_blocos());
+        log_suspenso = false;
+        return;
+    }
+    FRESULT fr = log_drenar(true);
+    FRESULT fr2 = gat_fechar(); // Evento incompleto: fica o que foi gravado
+    if (FR_OK == fr)
+        fr = fr2;
+    fr2 = ring_log_close(&ring_log);
+    if (FR_OK == fr)
+        fr = fr2;
+    for (int e = 0; e < DEC_ESTAGIOS; e++)
+    {
+        fr2 = ring_log_close(&dec_logs[e]);
+        if (FR_OK == fr)
+            fr = fr2;
+    }
+    fr2 = ring_log_close(&estat_log);
+    if (FR_OK == fr)
+        fr = fr2;
+    fr2 = ring_log_close(&esp_log);
+    if (FR_OK == fr)
+        fr = fr2;
+    if (FR_OK != fr)
+        printf("[ERRO] Log contínuo: %s (%d)\n", FRESULT_str(fr), fr);
+    rgb_set_color(FR_OK == fr ? "verde" : "amarelo");
+}
+
+// A cota é uma fração da capacidade do cartão montado. Abre o log bruto (que cria
+// LOGS/) e os resumidos, recuperando os segmentos deixados por uma queda de energia
+// ou pela remoção do cartão.
+static FRESULT log_abrir()
+{
+    // Basta a geometria do volume montado: f_getfree varreria a FAT inteira
+    // quando o FSInfo não tem a contagem de livres.
+    const FATFS *fs = &sd_get_by_num(0)->fatfs;
+    if (!fs->fs_type)
+        return FR_NOT_READY;
+    uint64_t total = (uint64_t)(fs->n_fatent - 2) * fs->csize * FF_MAX_SS;
+    ring_log.max_segments = total / 100 * LOG_QUOTA_PCT / ring_log.segment_size;
+    FRESULT fr = ring_log_open(&ring_log);
+    for (int e = 0; e < DEC_ESTAGIOS && FR_OK == fr; e++)
+    {
+        dec_logs[e].max_segments = total / 100 * RESUMO_QUOTA_PCT / dec_logs[e].segment_size;
+        fr = ring_log_open(&dec_logs[e]);
+    }
+    estat_log.max_segments = total / 100 * RESUMO_QUOTA_PCT / estat_log.segment_size;
+    if (FR_OK == fr)
+        fr = ring_log_open(&estat_log);
+    esp_log.max_segments = total / 100 * RESUMO_QUOTA_PCT / esp_log.segment_size;
+    if (FR_OK == fr)
+        fr = ring_log_open(&esp_log);
+    if (FR_OK != fr)
+    {
+        ring_log_close(&ring_log);
+        for (int e = 0; e < DEC_ESTAGIOS; e++)
+            ring_log_close(&dec_logs[e]);
+        ring_log_close(&estat_log);
+        ring_log_close(&esp_log);
+    }
+    return fr;
+}
+
+static void log_status()
+{
+    char nome[FF_LFN_BUF];
+    printf("Log contínuo: %s\n", log_suspenso ? "suspenso (sem cartão)" : ring_log.is_open ? "gravando" : "parado");
+    if (log_suspenso)
+        printf("Reserva em RAM: %lu de %u blocos, amostras perdidas: %lu\n",
+               aq_reserva_blocos(), AQ_RESERVA_BLOCOS, aq_perdidas);
+    if (!ring_log.is_open)
+        return;
+    ring_log_segment_name(&ring_log, ring_log.newest, nome, sizeof nome);
+    printf("Segmento atual: %s (%llu bytes)\n", nome, (unsigned long long)ring_log.pos);
+    printf("Segmentos no cartão: %lu (máx. %lu)\n", ring_log.count, ring_log.max_segments);
+    printf("Trocas: %lu, apagados: %lu, atrasos: %lu, amostras perdidas: %lu, falhas de I2C: %lu\n",
+           ring_log.rotations, ring_log.deleted, ring_log.stalls, aq_perdidas, aq_falhas_i2c);
+    uint64_t decorrido = time_us_64() - ring_log.started_us;
+    printf("Registros: %lu (recuperados após queda: %lu)\n", ring_log.seq, ring_log.recovered);
+    printf("Confirmações (f_sync): %lu, %llu ms (%.2f%% do tempo)\n", ring_log.syncs,
+           ring_log.sync_us / 1000, decorrido ? 100.0 * ring_log.sync_us / decorrido : 0.0);
+    if (log_bytes_gravados)
+        printf("Amostras: %llu bytes, gravados %llu bytes (%.1f:1, %s), compressão: %.2f%% do tempo\n",
+               log_bytes_amostras, log_bytes_gravados, (double)log_bytes_amostras / log_bytes_gravados,
+               log_comprimir ? "comprimido" : "bruto", decorrido ? 100.0 * log_comp_us / decorrido : 0.0);
+    uint32_t fator = 1;
+    for (int e = 0; e < DEC_ESTAGIOS; e++)
+    {
+        fator *= DEC_FATOR;
+        ring_log_segment_name(&dec_logs[e], dec_logs[e].newest, nome, sizeof nome);
+        printf("Resumo 1/%lu: %s (%llu bytes), %lu registros, %lu segmentos\n", fator, nome,
+               (unsigned long long)dec_logs[e].pos, dec_logs[e].seq, dec_logs[e].count);
+    }
+    if (esp.n)
+        printf("Espectro: %lu pontos, janela %s, média de %lu quadros em %s/, %lu registros, amostras perdidas: %lu\n",
+               esp.n, esp_janelas[esp.janela], esp.medias, esp_log.dir, esp_log.seq, esp.perdidas);
+    else
+        printf("Espectro: desligado\n");
+    printf("Estatísticas: janelas de %lu amostras em %s/, %lu registros\n",
+           estat.janela, estat_log.dir, estat_log.seq);
+    if (!estat.pronto.n)
+        return; // Nenhuma janela fechada ainda
+    static const char *const eixos[ESTAT_CANAIS] = {"accel x", "accel y", "accel z", "giro x", "giro y", "giro z"};
+    printf("Última janela (%lu amostras):\n", estat.pronto.n);
+    for (int c = 0; c < ESTAT_CANAIS; c++)
+    {
+        const estat_canal_t *k = &estat.pronto.canal[c];
+        printf("  %-7s mín %6d máx %6d média %9.2f RMS %9.2f desvio %8.2f\n",
+               eixos[c], k->min, k->max, k->media, k->rms, k->desvio);
+    }
+}
+
+static void run_log()
+{
+    static const char *const uso = "Uso: log start [<Hz>] [-r] [-e] [-j <ms>] [-f <N>] [-m <quadros>] [-w ret|hann|hamming]"
+                                   " | stop | status\n";
+    const char *arg1 = strtok(NULL, " ");
+    if (!arg1 || 0 == strcmp(arg1, "status"))
+    {
+        log_status();
+    }
+    else if (0 == strcmp(arg1, "start"))
+    {
+        if (aq_ativo)
+        {
+            printf("Log contínuo já está gravando.\n");
+            return;
+        }
+        int hz = LOG_HZ_PADRAO;
+        int janela_ms = ESTAT_JANELA_MS_PADRAO;
+        int esp_n = ESP_N_PADRAO, esp_medias = ESP_MEDIAS_PADRAO;
+        esp_janela_t esp_janela = ESP_JANELA_HANN;
+        bool comprimir = true, bruto = true;
+        const char *arg;
+        while ((arg = strtok(NULL, " ")))
+        {
+            if (0 == strcmp(arg, "-r"))
+                comprimir = false;
+            else if (0 == strcmp(arg, "-e"))
+                bruto = false;
+            else if (0 == strcmp(arg, "-j") && (arg = strtok(NULL, " ")))
+                janela_ms = atoi(arg);
+            else if (0 == strcmp(arg, "-f") && (arg = strtok(NULL, " ")))
+                esp_n = atoi(arg);
+            else if (0 == strcmp(arg, "-m") && (arg = strtok(NULL, " ")))
+                esp_medias = atoi(arg);
+            else if (0 == strcmp(arg, "-w") && (arg = strtok(NULL, " ")))
+            {
+                if (0 == strcmp(arg, "ret"))
+                    esp_janela = ESP_JANELA_RET;
+                else if (0 == strcmp(arg, "hann"))
+                    esp_janela = ESP_JANELA_HANN;
+                else if (0 == strcmp(arg, "hamming"))
+                    esp_janela = ESP_JANELA_HAMMING;
+                else
+                {
+                    printf("%s", uso);
+                    return;
+                }
+            }
+            else
+                hz = atoi(arg);
+        }
+        if (hz < 1 || hz > LOG_HZ_MAX)
+        {
+            printf("Taxa inválida: use 1 a %d Hz.\n", LOG_HZ_MAX);
+            return;
+        }
+        if (janela_ms < 1)
+        {
+            printf("Janela inválida: use -j <ms>.\n");
+            return;
+        }
+        if (esp_n && (esp_n < ESP_N_MIN || esp_n > ESP_N_MAX || (esp_n & (esp_n - 1))))
+        {
+            printf("FFT inválida: use -f 256, 512 ou 1024 (0 desliga).\n");
+            return;
+        }
+        if (esp_medias < 1 || esp_medias > ESP_MEDIAS_MAX)
+        {
+            printf("Média inválida: use -m 1 a %d quadros.\n", ESP_MEDIAS_MAX);
+            return;
+        }
+        // Pelo menos um bloco por janela: cada bloco fecha no máximo uma
+        uint32_t janela = (uint64_t)janela_ms * hz / 1000;
+        if (janela < AQ_BLOCO)
+            janela = AQ_BLOCO;
+        FRESULT fr = log_abrir();
+        if (FR_OK != fr)
+        {
+            printf("[ERRO] Não foi possível iniciar o log: %s (%d). Monte o Cartao.\n", FRESULT_str(fr), fr);
+            blinking_rgb(25, 50, "magenta");
+            rgb_set_color("amarelo");
+            return;
+        }
+        log_bruto = bruto;
+        log_comprimir = comprimir && bruto;
+        log_bytes_amostras = log_bytes_gravados = log_comp_us = 0;
+        estat_nova = false;
+        dec_iniciar();
+        estat_iniciar(janela);
+        esp_iniciar(esp_n, esp_medias, esp_janela, hz);
+        gat_iniciar();
+        aq_iniciar(hz, I2C_PORT, addr, 0x3B); // Acelerômetro, temperatura e giroscópio
+        rgb_set_color("vermelho");
+        if (bruto)
+            printf("Log contínuo iniciado a %d Hz em %s/ (até %lu segmentos, %s).\n",
+                   hz, ring_log.dir, ring_log.max_segments, comprimir ? "comprimido" : "bruto");
+        else
+            printf("Log contínuo iniciado a %d Hz, só resumos e estatísticas em %s/.\n", hz, ring_log.dir);
+        printf("Estatísticas a cada %lu amostras em %s/.\n", janela, estat_log.dir);
+        if (esp_n)
+            printf("Espectro de %d pontos, janela %s, média de %d quadros em %s/.\n",
+                   esp_n, esp_janelas[esp_janela], esp_medias, esp_log.dir);
+    }
+    else if (0 == strcmp(arg1, "stop"))
+    {
+        if (!aq_ativo)
+        {
+            printf("Log contínuo não está gravando.\n");
+            return;
+        }
+        log_parar();
+        log_status();
+        printf("Log contínuo encerrado.\n");
+    }
+    else
+    {
+        printf("%s", uso);
+    }
+}
+
+// Erros de gravação que indicam cartão removido ou falhando (e não, por exemplo, cartão cheio)
+static bool erro_de_cartao(FRESULT fr)
+{
+    return FR_DISK_ERR == fr || FR_NOT_READY == fr || FR_INVALID_OBJECT == fr;
+}
+
+static bool cartao_timer_callback(repeating_timer_t *rt)
+{
+    evt_post(EVT_CARTAO);
+    return true;
+}
+
+// Chamada pelo driver (em interrupção) quando o detector do soquete muda de estado
+static void cartao_detectado(sd_card_t *pSD, bool presente)
+{
+    evt_post(EVT_CARTAO);
+}
+
+// Cartão removido ou falhando: solta o sistema de arquivos sem acessar o cartão.
+// O log continua amostrando para a reserva em RAM.
+static void cartao_perdido(sd_card_t *pSD)
+{
+    if (ring_log.is_open)
+    {
+        ring_log_abandon(&ring_log);
+        for (int e = 0; e < DEC_ESTAGIOS; e++)
+            ring_log_abandon(&dec_logs[e]);
+        ring_log_abandon(&estat_log);
+        ring_log_abandon(&esp_log);
+        gat_abandonar();
+        log_suspenso = true;
+        reserva_cheia = false;
+    }
+    if (pSD->mounted)
+    {
+        f_unmount(pSD->pcName);
+        pSD->mounted = false;
+        cartao_remontar = true;
+    }
+    pSD->m_Status |= STA_NOINIT;
+    // Também procura o cartão periodicamente: sem detector, ou se ele falhou ainda no soquete
+    if (cartao_remontar && !cartao_timer_ativo)
+        cartao_timer_ativo = add_repeating_timer_ms(CARTAO_PROCURA_MS, cartao_timer_callback, NULL, &cartao_timer);
+    rgb_set_color("amarelo");
+    printf("\n[AVISO] Cartão %s removido ou com falha.%s\n", pSD->pcName,
+           log_suspenso ? " Amostras guardadas na RAM até ele voltar." : "");
+}
+
+// Cartão de volta: inicializa, monta e retoma o log, gravando primeiro a reserva
+static void cartao_retomar(sd_card_t *pSD)
+{
+    if (!sd_card_detect(pSD))
+        return; // Soquete vazio: espera o detector
+    if (!pSD->use_card_detect && !pSD->sd_test_com(pSD))
+        return; // Ainda não responde
+    pSD->m_Status |= STA_NOINIT;
+    FRESULT fr = f_mount(&pSD->fatfs, pSD->pcName, 1); // Chama sd_init()
+    if (FR_OK != fr)
+        return; // Tenta de novo na próxima procura
+    pSD->mounted = true;
+    cartao_remontar = false;
+    if (cartao_timer_ativo)
+        cancel_repeating_timer(&cartao_timer);
+    cartao_timer_ativo = false;
+    printf("\n[INFO] Cartão %s montado de novo.\n", pSD->pcName);
+    if (!log_suspenso)
+    {
+        log_recuperar(); // Suspenso, log_abrir() faz isso
+        rgb_set_color("verde");
+        return;
+    }
+    fr = log_abrir();
+    if (FR_OK != fr)
+    {
+        printf("[ERRO] Não foi possível retomar o log: %s (%d)\n", FRESULT_str(fr), fr);
+        log_parar(); // Ainda suspenso: descarta a reserva
+        return;
+    }
+    log_suspenso = false;
+    rgb_set_color("vermelho");
+    printf("[INFO] Log retomado: gravando %lu blocos guardados na RAM.\n", aq_reserva_blocos());
+    evt_post(EVT_AMOSTRA);
+}
+
+// Marcos da partida, em microssegundos desde o reset (comando "boot").
+static struct
+{
+    uint32_t main;        // Entrada em main()
+    uint32_t perifericos; // GPIO, USB, I2C e início do reset do MPU6050
+    uint32_t montado;     // f_mount concluído
+    uint32_t recuperado;  // Segmentos do log interrompido cortados
+    uint32_t registros;   // Registros mantidos neles
+    uint32_t pronto;      // MPU6050 pronto: o log pode começar
+    FRESULT fr;           // Resultado da montagem
+    uint32_t sd_init_us, acmd41_us, acmd41_polls; // Copiados de io_stats
+    bool geometria, dica; // CSD e localização do volume vieram do cache
+} partida;
+
+// Monta o cartão já na partida, para o log poder começar sem o comando mount.
+static void partida_montar()
+{
+    sd_card_t *pSD = sd_get_by_num(0);
+    partida.fr = f_mount(&pSD->fatfs, pSD->pcName, 1);
+    pSD->mounted = (FR_OK == partida.fr);
+    partida.montado = time_us_32();
+    partida.sd_init_us = io_stats.sd_init_us;
+    partida.acmd41_us = io_stats.sd_acmd41_us;
+    partida.acmd41_polls = io_stats.sd_acmd41_polls;
+    partida.geometria = io_stats.sd_geometry_hits > 0;
+    partida.dica = io_stats.f_mount_hint_hits > 0;
+    if (pSD->mounted)
+        partida.registros = log_recuperar();
+    partida.recuperado = time_us_32();
+}
+
+static void run_boot()
+{
+    printf("Partida (ms desde o reset):\n");
+    printf("  main()             %7.1f\n", partida.main / 1000.0);
+    printf("  periféricos        %7.1f\n", partida.perifericos / 1000.0);
+    printf("  cartão montado     %7.1f", partida.montado / 1000.0);
+    if (FR_OK == partida.fr)
+        printf("  (sd_init %.1f ms, ACMD41 %.1f ms em %lu consultas; CSD %s, volume %s)\n",
+               partida.sd_init_us / 1000.0, partida.acmd41_us / 1000.0, partida.acmd41_polls,
+               partida.geometria ? "do cache" : "lido", partida.dica ? "do cache" : "procurado");
+    else
+        printf("  (falhou: %s (%d))\n", FRESULT_str(partida.fr), partida.fr);
+    printf("  log recuperado     %7.1f  (%lu registros)\n", partida.recuperado / 1000.0, partida.registros);
+    printf("  pronto para o log  %7.1f\n", partida.pronto / 1000.0);
+}
+
+/*
+Teste de estresse do FatFs reentrante: por alguns segundos os dois núcleos
+gravam cada um o seu arquivo, em pedaços de tamanho aleatório, e leem trechos
+aleatórios de um arquivo de referência comum, tudo no mesmo volume. No fim o
+núcleo 0 confere byte a byte o que cada um gravou.
+*/
+#define STRESS_REF "STRESS.REF"
+#define STRESS_REF_TAM (64 * 1024)
+#define STRESS_REF_SEMENTE 0x5A
+#define STRESS_SEG_PADRAO 5
+
+typedef struct
+{
+    const char *nome; // Arquivo gravado por este núcleo
+    uint8_t semente;  // Padrão dos dados desse arquivo
+    uint32_t fim_us;  // Hora de parar (time_us_32)
+    FIL arq, ref;     // Estáticos: a pilha do núcleo 1 é pequena
+    uint8_t buf[512];
+    uint32_t escritas, leituras, erros_lidos, erros_gravados;
+    uint64_t gravados, lidos;
+    FRESULT fr; // Primeiro erro do FatFs
+} stress_t;
+
+static stress_t stress[2];
+
+// Byte da posição pos de um arquivo do teste
+static inline uint8_t stress_byte(uint8_t semente, uint32_t pos)
+{
+    return (uint8_t)(pos * 31 + (pos >> 8) + semente);
+}
+
+static void stress_trabalho(void *arg)
+{
+    stress_t *st = arg;
+    uint32_t rnd = st->semente * 2654435761u;
+    FRESULT fr = f_open(&st->arq, st->nome, FA_CREATE_ALWAYS | FA_WRITE);
+    if (FR_OK == fr)
+        fr = f_open(&st->ref, STRESS_REF, FA_READ);
+    while (FR_OK == fr && (int32_t)(time_us_32() - st->fim_us) < 0)
+    {
+        rnd = rnd * 1664525u + 1013904223u;
+        UINT n = 1 + (rnd >> 8) % sizeof st->buf, bw, br;
+        uint32_t pos = f_tell(&st->arq);
+        for (UINT i = 0; i < n; ++i)
+            st->buf[i] = stress_byte(st->semente, pos + i);
+        fr = f_write(&st->arq, st->buf, n, &bw);
+        if (FR_OK == fr && bw < n)
+            fr = FR_DENIED; // Cartão cheio
+        if (FR_OK == fr && ++st->escritas % 16 == 0)
+            fr = f_sync(&st->arq); // Atualiza FAT e diretório também
+        st->gravados += bw;
+        if (FR_OK != fr)
+            break;
+
+        rnd = rnd * 1664525u + 1013904223u;
+        pos = (rnd >> 8) % (STRESS_REF_TAM - n);
+        fr = f_lseek(&st->ref, pos);
+        if (FR_OK == fr)
+            fr = f_read(&st->ref, st->buf, n, &br);
+        if (FR_OK != fr)
+            break;
+        st->leituras++;
+        st->lidos += br;
+        for (UINT i = 0; i < br; ++i)
+            if (st->buf[i] != stress_byte(STRESS_REF_SEMENTE, pos + i))
+            {
+                st->erros_lidos++;
+                break;
+            }
+    }
+    f_close(&st->ref);
+    FRESULT fr2 = f_close(&st->arq);
+    st->fr = FR_OK == fr ? fr2 : fr;
+}
+
+static FRESULT stress_criar_ref(uint8_t *buf)
+{
+    FIL f;
+    UINT bw;
+    FRESULT fr = f_open(&f, STRESS_REF, FA_CREATE_ALWAYS | FA_WRITE);
+    for (uint32_t pos = 0; FR_OK == fr && pos < STRESS_REF_TAM; pos += 512)
+    {
+        for (uint32_t i = 0; i < 512; ++i)
+            buf[i] = stress_byte(STRESS_REF_SEMENTE, pos + i);
+        fr = f_write(&f, buf, 512, &bw);
+    }
+    FRESULT fr2 = f_close(&f);
+    return FR_OK == fr ? fr2 : fr;
+}
+
+// Relê o arquivo gravado por st e conta os blocos de 512 bytes com erro.
+static FRESULT stress_conferir(stress_t *st)
+{
+    FIL f;
+    UINT br;
+    FRESULT fr = f_open(&f, st->nome, FA_READ);
+    if (FR_OK != fr)
+        return fr;
+    if (f_size(&f) != st->gravados)
+        st->erros_gravados++;
+    for (uint32_t pos = 0; FR_OK == fr && pos < f_size(&f); pos += br)
+    {
+        fr = f_read(&f, st->buf, sizeof st->buf, &br);
+        for (UINT i = 0; FR_OK == fr && i < br; ++i)
+            if (st->buf[i] != stress_byte(st->semente, pos + i))
+            {
+                st->erros_gravados++;
+                break;
+            }
+    }
+    f_close(&f);
+    return fr;
+}
+
+static void run_stress()
+{
+    if (aq_ativo)
+    {
+        printf("Pare o log contínuo antes (log stop).\n");
+        return;
+    }
+    const char *arg1 = strtok(NULL, " ");
+    int seg = arg1 ? atoi(arg1) : STRESS_SEG_PADRAO;
+    if (seg < 1 || seg > 600)
+    {
+        printf("Duração inválida: use 1 a 600 s.\n");
+        return;
+    }
+    memset(stress, 0, sizeof stress);
+    FRESULT fr = stress_criar_ref(stress[0].buf);
+    if (FR_OK != fr)
+    {
+        printf("[ERRO] Criando %s: %s (%d). Monte o cartão.\n", STRESS_REF, FRESULT_str(fr), fr);
+        return;
+    }
+    for (int i = 0; i < 2; ++i)
+    {
+        stress[i].nome = i ? "STRESS1.BIN" : "STRESS0.BIN";
+        stress[i].semente = i + 1;
+        stress[i].fim_us = time_us_32() + seg * 1000000u;
+    }
+    uint32_t travas = io_stats.ff_lock_takes;
+    uint32_t disputas = io_stats.ff_lock_wait.count;
+    uint64_t espera_us = io_stats.ff_lock_wait.total_us;
+    uint32_t esgotadas = io_stats.ff_lock_timeouts;
+    printf("Núcleos 0 e 1 gravando e lendo por %d s...\n", seg);
+    stdio_flush();
+
+    if (!nucleo1_executar(stress_trabalho, &stress[1]))
+    {
+        printf("O núcleo 1 está ocupado.\n");
+        return;
+    }
+    stress_trabalho(&stress[0]);
+    nucleo1_aguardar();
+
+    travas = io_stats.ff_lock_takes - travas;
+    disputas = io_stats.ff_lock_wait.count - disputas;
+    espera_us = io_stats.ff_lock_wait.total_us - espera_us;
+    esgotadas = io_stats.ff_lock_timeouts - esgotadas;
+    bool ok = true;
+    for (int i = 0; i < 2; ++i)
+    {
+        stress_t *st = &stress[i];
+        if (FR_OK == st->fr)
+            st->fr = stress_conferir(st);
+        printf("Núcleo %d: %lu escritas (%llu bytes), %lu leituras (%llu bytes)\n", i,
+               st->escritas, st->gravados, st->leituras, st->lidos);
+        printf("          erros no lido: %lu, no gravado: %lu, FatFs: %s\n",
+               st->erros_lidos, st->erros_gravados, FRESULT_str(st->fr));
+        ok = ok && FR_OK == st->fr && !st->erros_lidos && !st->erros_gravados;
+        f_unlink(st->nome);
+    }
+    f_unlink(STRESS_REF);
+    printf("Travas do FatFs: %lu, disputadas: %lu (%.1f%%), espera total %.1f ms "
+           "(%.2f%% do teste), esgotadas: %lu\n",
+           travas, disputas, travas ? 100.0 * disputas / travas : 0.0, espera_us / 1000.0,
+           espera_us / (seg * 10000.0), esgotadas);
+    printf("Resultado: %s\n", ok ? "OK" : "FALHOU");
+}
+
+// Limiar em unidades físicas para o quadrado do módulo em contagens (máximo 65535 contagens)
+static uint32_t gatilho_limiar2(const char *valor, float contagens)
+{
+    float c = strtof(valor, NULL) * contagens;
+    if (c <= 0.0f)
+        return 0;
+    uint32_t v = c < 65535.0f ? (uint32_t)(c + 0.5f) : 65535;
+    return v * v;
+}
+
+static void run_gatilho()
+{
+    const char *arg, *valor;
+    while ((arg = strtok(NULL, " ")))
+    {
+        if (0 == strcmp(arg, "off"))
+        {
+            gat.acel_lim2 = gat.giro_lim2 = 0;
+            continue;
+        }
+        valor = strtok(NULL, " ");
+        if (!valor)
+            arg = "";
+        if (0 == strcmp(arg, "-a"))
+            gat.acel_lim2 = gatilho_limiar2(valor, 16384.0f); // ±2 g
+        else if (0 == strcmp(arg, "-g"))
+            gat.giro_lim2 = gatilho_limiar2(valor, 131.0f); // ±250 °/s
+        else if (0 == strcmp(arg, "-p"))
+            gat.pre_us = (uint32_t)atoi(valor) * 1000;
+        else if (0 == strcmp(arg, "-d"))
+            gat.pos_us = (uint32_t)atoi(valor) * 1000;
+        else
+        {
+            printf("Uso: gatilho [-a <g>] [-g <°/s>] [-p <ms antes>] [-d <ms depois>] | off\n");
+            return;
+        }
+    }
+    printf("Gatilho: aceleração ");
+    if (gat.acel_lim2)
+        printf(">= %.2f g", sqrtf(gat.acel_lim2) / 16384.0f);
+    else
+        printf("desligada");
+    printf(", rotação ");
+    if (gat.giro_lim2)
+        printf(">= %.1f °/s", sqrtf(gat.giro_lim2) / 131.0f);
+    else
+        printf("desligada");
+    printf("; botão A e \"capture\" durante o log também disparam.\n");
+    printf("Grava %lu ms antes (anel de %u amostras) e %lu ms depois em %s/.\n",
+           gat.pre_us / 1000, GAT_ANEL, gat.pos_us / 1000, GAT_DIR);
+    printf("Eventos: %lu, disparos manuais ignorados: %lu%s\n", gat.eventos, gat.ignorados,
+           gat.gravando ? ", gravando um evento" : "");
+    if (!aq_ativo)
+        printf("Os disparos valem enquanto o log grava (log start; -e para não gravar o log bruto).\n");
+}
+
+static void run_stats()
+{
+    const char *arg1 = strtok(NULL, " ");
+    if (!arg1)
+    {
+        io_stats_print();
+        ff_pool_print_all();
+        for (size_t i = 0; i < sd_get_num(); ++i)
+            sd_volume_print(sd_get_by_num(i));
+    }
+    else if (0 == strcmp(arg1, "json"))
+        io_stats_print_json();
+    else if (0 == strcmp(arg1, "reset"))
+    {
+        io_stats_reset();
+        printf("Contadores zerados.\n");
+    }
+    else
+        printf("Uso: stats [json | reset]\n");
+}
+
+static void run_trace()
+{
+    const char *arg1 = strtok(NULL, " ");
+    if (!arg1 || 0 == strcmp(arg1, "dump"))
+        sd_trace_dump();
+    else if (0 == strcmp(arg1, "on"))
+        sd_trace_enable(true);
+    else if (0 == strcmp(arg1, "off"))
+        sd_trace_enable(false);
+    else if (0 == strcmp(arg1, "clear"))
+        sd_trace_clear();
+    else
+        printf("Uso: trace [dump | on | off | clear]\n");
+}
+
+static void run_help();
+
 typedef void (*p_fn_t)();
 typedef struct
 {
     char const *const command;
+    char const key; // Atalho de uma tecla (0 = sem atalho)
     p_fn_t const function;
     char const *const help;
+    char const *const oled[2];     // Display durante o comando (NULL = não altera)
+    char const *const oled_fim[2]; // Display ao final do comando
+    char const *const msg;         // Mensagem no terminal antes do comando
+    char const *const msg_fim;     // Mensagem no terminal ao final do comando
 } cmd_def_t;
 
-static cmd_def_t cmds[] = {
-    {"setrtc", run_setrtc, "setrtc <DD> <MM> <YY> <hh> <mm> <ss>: Set Real Time Clock"},
-    {"format", run_format, "format [<drive#:>]: Formata o cartão SD"},
-    {"mount", run_mount, "mount [<drive#:>]: Monta o cartão SD"},
-    {"unmount", run_unmount, "unmount <drive#:>: Desmonta o cartão SD"},
-    {"getfree", run_getfree, "getfree [<drive#:>]: Espaço livre"},
-    {"ls", run_ls, "ls: Lista arquivos"},
-    {"cat", run_cat, "cat <filename>: Mostra conteúdo do arquivo"},
-    {"help", run_help, "help: Mostra comandos disponíveis"},
+// Registro único de comandos: nome longo, atalho, função, ajuda e textos do display.
+static const cmd_def_t cmds[] = {
+    {"mount", 'a', run_mount, "mount [<drive#:>]: Monta o cartão SD",
+     {"Montando", "SD..."}, {"SD Montado", NULL}, "\nMontando o SD...\n", NULL},
+    {"unmount", 'b', run_unmount, "unmount <drive#:>: Desmonta o cartão SD",
+     {"Desmontando", "SD..."}, {"SD Desmontado", NULL}, "\nDesmontando o SD. Aguarde...\n", NULL},
+    {"ls", 'c', run_ls, "ls [-l] [-s | -t | -f] [-r] [-p <página>] [<pasta>] [<padrão>]: Lista arquivos",
+     {"Listando", "Arquivos..."}, {"Lista Concluida", NULL}, "\nListagem de arquivos no cartão SD.\n", "\nListagem concluída.\n"},
+    {"read", 'd', run_read, "read [<arquivo>]: Mostra o arquivo de dados capturados",
+     {"Lendo", "Arquivo..."}, {"Arquivo Lido", NULL}, NULL, NULL},
+    {"getfree", 'e', run_getfree, "getfree [<drive#:>]: Espaço livre",
+     {"Obtendo Espaco", "Livre..."}, {"Espaco Obtido", NULL}, "\nObtendo espaço livre no SD.\n\n", "\nEspaço livre obtido.\n"},
+    {"capture", 'f', run_capture, "capture: Captura dados do MPU6050 e salva no arquivo",
+     {"Capturando", "Dados..."}, {"Dados Obtidos", NULL}, NULL, NULL},
+    {"format", 0, run_format, "format [<drive#:>] [-t fat|fat32|exfat] [-c <bytes>] [-a <setores>] [-e]: Formata o cartão SD (pede confirmação)",
+     {"Formatar", "o SD?"}, {NULL, NULL}, NULL, NULL},
+    {"resync", 0, run_resync, "resync [<drive#:>]: Copia o cartão em dia do espelho sobre o que perdeu gravações",
+     {"Copiando", "Espelho..."}, {NULL, NULL}, NULL, NULL},
+    {"help", 'h', run_help, "help: Mostra comandos disponíveis",
+     {"Ajuda", "Solicitada"}, {NULL, NULL}, NULL, NULL},
+    {"setrtc", 0, run_setrtc, "setrtc <DD> <MM> <YY> <hh> <mm> <ss>: Set Real Time Clock",
+     {NULL, NULL}, {NULL, NULL}, NULL, NULL},
+    {"cat", 0, run_cat, "cat <filename>: Mostra conteúdo do arquivo",
+     {NULL, NULL}, {NULL, NULL}, NULL, NULL},
+    {"range", 0, run_range, "range <segmento> <t0> <t1>: Amostras de um segmento do log entre t0 e t1 s do seu início",
+     {NULL, NULL}, {NULL, NULL}, NULL, NULL},
+    {"log", 0, run_log, "log start [<Hz>] [<opções>] | stop | status: Log contínuo em LOGS/",
+     {NULL, NULL}, {NULL, NULL}, NULL, NULL},
+    {"gatilho", 0, run_gatilho, "gatilho [-a <g>] [-g <°/s>] [-p <ms>] [-d <ms>] | off: Eventos com pré-disparo no log",
+     {NULL, NULL}, {NULL, NULL}, NULL, NULL},
+    {"stats", 0, run_stats, "stats [json | reset]: Contadores e latências de E/S",
+     {NULL, NULL}, {NULL, NULL}, NULL, NULL},
+    {"trace", 0, run_trace, "trace [dump | on | off | clear]: Eventos do driver SD com tempo",
+     {NULL, NULL}, {NULL, NULL}, NULL, NULL},
+    {"boot", 0, run_boot, "boot: Tempos da partida até o log ficar pronto",
+     {NULL, NULL}, {NULL, NULL}, NULL, NULL},
+    {"stress", 0, run_stress, "stress [<s>]: Os dois núcleos usam o cartão ao mesmo tempo",
+     {"Teste de", "Estresse..."}, {"Estresse", "Concluido"}, NULL, NULL},
 };
 
+/*
+Busca de comandos por hash perfeito: CMD_HASH_SEED é uma semente para a qual os
+nomes de cmds[] caem em posições distintas de cmd_hash[], gerada fora do Pico por
+ArquivosDados/gera_hash_comandos.py. Assim cada busca custa um hash e uma única
+comparação. Ao acrescentar ou renomear um comando, rode o script de novo: o build
+confere a semente e para se ela não separa mais os nomes. A tabela tem pelo menos
+4 posições por comando, então a semente sai em poucas tentativas.
+*/
+#define CMD_HASH_BITS 7
+#define CMD_HASH_SLOTS (1u << CMD_HASH_BITS)
+#define CMD_HASH_SEED 0x811C9DC8u
+
+static uint8_t cmd_hash[CMD_HASH_SLOTS];  // Índice em cmds[] + 1 (0 = vazio)
+static uint8_t cmd_por_tecla[128];        // Índice em cmds[] + 1 por tecla de atalho
+static bool cmd_tecla_direta[128];        // Atalho que roda sem Enter: nenhum comando começa com a tecla
+
+static uint32_t cmd_hash_slot(const char *s)
+{
+    uint32_t h = CMD_HASH_SEED;
+    while (*s)
+        h = (h ^ (uint8_t)*s++) * 16777619u; // FNV-1a
+    return h >> (32 - CMD_HASH_BITS);
+}
+
+static void cmd_registry_init()
+{
+    _Static_assert(count_of(cmds) * 4 <= CMD_HASH_SLOTS, "CMD_HASH_BITS too small");
+    for (size_t i = 0; i < count_of(cmds); ++i)
+    {
+        uint32_t slot = cmd_hash_slot(cmds[i].command);
+        // Só com a semente desatualizada, que o build já recusa
+        if (cmd_hash[slot])
+            panic("CMD_HASH_SEED: \"%s\" colide com \"%s\"; rode ArquivosDados/gera_hash_comandos.py",
+                  cmds[i].command, cmds[cmd_hash[slot] - 1].command);
+        cmd_hash[slot] = i + 1;
+    }
+    for (size_t i = 0; i < count_of(cmds); ++i)
+    {
+        uint8_t k = (uint8_t)cmds[i].key;
+        if (!k)
+            continue;
+        cmd_por_tecla[k] = i + 1;
+        cmd_tecla_direta[k] = true;
+        for (size_t j = 0; j < count_of(cmds); ++j)
+            if ((uint8_t)cmds[j].command[0] == k)
+                cmd_tecla_direta[k] = false; // "c" de "cat", "b" de "boot": só tecla e Enter
+    }
+}
+
+static const cmd_def_t *cmd_find(const char *name)
+{
+    uint8_t ix = cmd_hash[cmd_hash_slot(name)];
+    if (ix && 0 == strcmp(cmds[ix - 1].command, name))
+        return &cmds[ix - 1];
+    return NULL;
+}
+
+static ssd1306_t ssd; // Display OLED
+static bool cor = true;
+
+static void oled_show(char const *const linhas[2])
+{
+    if (!linhas[0])
+        return;
+    ssd1306_fill(&ssd, !cor); // Limpa o display
+    ssd1306_draw_string(&ssd, linhas[0], 2, 28);
+    if (linhas[1])
+        ssd1306_draw_string(&ssd, linhas[1], 2, 37);
+    ssd1306_send_data(&ssd);
+}
+
+// Última janela de estatísticas do log: o maior desvio padrão entre os eixos do
+// acelerômetro (em g) e do giroscópio (em °/s), a medida de vibração.
+static void oled_estatisticas()
+{
+    char linhas[2][20];
+    float acel = 0.0f, giro = 0.0f;
+    for (int c = 0; c < 3; c++)
+    {
+        acel = fmaxf(acel, estat.pronto.canal[c].desvio);
+        giro = fmaxf(giro, estat.pronto.canal[c + 3].desvio);
+    }
+    snprintf(linhas[0], sizeof linhas[0], "Acel DP %.3fg", acel / 16384.0f);
+    snprintf(linhas[1], sizeof linhas[1], "Giro DP %.1f/s", giro / 131.0f);
+    oled_show((char const *const[2]){linhas[0], linhas[1]});
+}
+
+// Executa um comando do registro, atualizando display e terminal conforme a tabela.
+static void run_cmd(const cmd_def_t *c)
+{
+    if (c->msg)
+        printf("%s", c->msg);
+    oled_show(c->oled);
+    c->function();
+    oled_show(c->oled_fim);
+    if (c->msg_fim)
+        printf("%s", c->msg_fim);
+}
+
+static void run_help()
+{
+    printf("\nComandos disponíveis:\n\n");
+    for (size_t i = 0; i < count_of(cmds); ++i)
+    {
+        if (cmds[i].key)
+            printf("  '%c'  %s\n", cmds[i].key, cmds[i].help);
+        else
+            printf("       %s\n", cmds[i].help);
+    }
+    printf("\nUm atalho é a tecla sozinha na linha, seguida de Enter. As teclas com que nenhum\n");
+    printf("comando começa (");
+    const char *sep = "";
+    for (size_t i = 0; i < count_of(cmds); ++i)
+        if (cmds[i].key && cmd_tecla_direta[(uint8_t)cmds[i].key])
+        {
+            printf("%s'%c'", sep, cmds[i].key);
+            sep = ", ";
+        }
+    printf(") executam o comando já ao serem pressionadas, com a linha vazia.\n");
+    printf("\nEscolha o comando:  ");
+}
+
 static void process_stdio(int cRxedChar)
 {
     static char cmd[256];
     static size_t ix;
 
+    // Atalho imediato: só com a linha vazia e só para teclas com que nenhum comando
+    // começa, senão as letras de um comando digitado virariam atalhos
+    if (0 == ix && cRxedChar > 0 && cRxedChar < (int)sizeof cmd_por_tecla && cmd_tecla_direta[cRxedChar])
+    {
+        const cmd_def_t *c = &cmds[cmd_por_tecla[cRxedChar] - 1];
+        char vazio[] = "";
+        strtok(vazio, " "); // Atalhos não têm argumentos
+        run_cmd(c);
+        if (c->function != run_help)
+            printf("\nEscolha o comando (h = help):  ");
+        stdio_flush();
+        return;
+    }
+
     if (!isprint(cRxedChar) && !isspace(cRxedChar) && '\r' != cRxedChar &&
         '\b' != cRxedChar && cRxedChar != (char)127)
         return;
@@ -571,19 +1937,16 @@ static void process_stdio(int cRxedChar)
             stdio_flush();
             return;
         }
+        // A tecla de atalho sozinha na linha
+        uint8_t tecla = (uint8_t)cmd[0];
+        bool atalho = tecla < sizeof cmd_por_tecla && cmd_por_tecla[tecla] && !cmd[1];
         char *cmdn = strtok(cmd, " ");
         if (cmdn)
         {
-            size_t i;
-            for (i = 0; i < count_of(cmds); ++i)
-            {
-                if (0 == strcmp(cmds[i].command, cmdn))
-                {
-                    (*cmds[i].function)();
-                    break;
-                }
-            }
-            if (count_of(cmds) == i)
+            const cmd_def_t *c = atalho ? &cmds[cmd_por_tecla[tecla] - 1] : cmd_find(cmdn);
+            if (c)
+                run_cmd(c);
+            else
                 printf("Command \"%s\" not found\n", cmdn);
         }
         ix = 0;
@@ -619,16 +1982,22 @@ void gpio_callback_botaoA(uint gpio, uint32_t events)
     {
         botaoA_pressionado = true;
         ultimo_tempo_botaoA = agora;
+        evt_post(EVT_BOTAO_A);
     }
 }
 
 int main()
 {
+    partida.main = time_us_32();
+    // Sem espera pela USB: o que for impresso antes de o terminal conectar se
+    // perde, mas o comando boot repete os tempos da partida.
     stdio_init_all();
-    sleep_ms(5000);
 
     time_init();
     rgb_init();
+    buzzer_init();
+    npInit(LED_PIN_MATRIZ);
+    npWrite();
 
     // Inicialização dos botões
     gpio_init(botaoA);
@@ -652,7 +2021,20 @@ int main()
     gpio_pull_up(I2C_SCL);
 
     bi_decl(bi_2pins_with_func(I2C_SDA, I2C_SCL, GPIO_FUNC_I2C));
-    mpu6050_reset();
+    absolute_time_t mpu_pronto = mpu6050_reset_iniciar();
+
+    evt_init();
+    // Arma a detecção do cartão (interrupção no pino de detecção do soquete)
+    sd_init_driver();
+    sd_set_card_detect_callback(cartao_detectado);
+    partida.perifericos = time_us_32();
+
+    // O cartão é montado enquanto o MPU6050 termina o reset
+    partida_montar();
+    mpu6050_reset_concluir(mpu_pronto);
+    partida.pronto = time_us_32();
+    rgb_set_color(FR_OK == partida.fr ? "verde" : "amarelo");
+    nucleo1_iniciar();
 
     i2c_init(I2C_PORT_DISPLAY, 400 * 1000); // I2C Initialisation. Using it at 400Khz.
 
@@ -660,7 +2042,6 @@ int main()
     gpio_set_function(I2C_SCL_DISPLAY, GPIO_FUNC_I2C);                            // Set the GPIO pin function to I2C
     gpio_pull_up(I2C_SDA_DISPLAY);                                                // Pull up the data line
     gpio_pull_up(I2C_SCL_DISPLAY);                                                // Pull up the clock line
-    ssd1306_t ssd;                                                                // Inicializa a estrutura do display
     ssd1306_init(&ssd, WIDTH, HEIGHT, false, endereco_DISPLAY, I2C_PORT_DISPLAY); // Inicializa o display
     ssd1306_config(&ssd);                                                         // Configura o display
     ssd1306_send_data(&ssd);                                                      // Envia os dados para o display
@@ -668,8 +2049,6 @@ int main()
     ssd1306_fill(&ssd, false); // Limpa o display. O display inicia com todos os pixels apagados.
     ssd1306_send_data(&ssd);   // Envia os dados para o display
 
-    bool cor = true;
-
     ssd1306_fill(&ssd, !cor);                     // Limpa o display
     ssd1306_draw_string(&ssd, "Sistema", 2, 28);  // Desenha uma string
     ssd1306_draw_string(&ssd, "Iniciado", 2, 37); // Desenha uma string
@@ -680,146 +2059,54 @@ int main()
     printf("\n> ");
     stdio_flush();
 
+    cmd_registry_init();
+    run_boot();
     run_help();
     while (true)
     {
-        int cRxedChar = getchar_timeout_us(0);
-        if (PICO_ERROR_TIMEOUT != cRxedChar)
-            process_stdio(cRxedChar);
-
-        if (cRxedChar == 'a') // Monta o SD card se pressionar 'a'
-        {
-            printf("\nMontando o SD...\n");
-
-            ssd1306_fill(&ssd, !cor);                     // Limpa o display
-            ssd1306_draw_string(&ssd, "Montando", 2, 28); // Desenha uma string
-            ssd1306_draw_string(&ssd, "SD...", 2, 37);    // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            run_mount();
-
-            ssd1306_fill(&ssd, !cor);                       // Limpa o display
-            ssd1306_draw_string(&ssd, "SD Montado", 2, 28); // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            printf("\nEscolha o comando (h = help):  ");
-        }
-        if (cRxedChar == 'b') // Desmonta o SD card se pressionar 'b'
-        {
-            printf("\nDesmontando o SD. Aguarde...\n");
-
-            ssd1306_fill(&ssd, !cor);                        // Limpa o display
-            ssd1306_draw_string(&ssd, "Desmontando", 2, 28); // Desenha uma string
-            ssd1306_draw_string(&ssd, "SD...", 2, 37);       // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            run_unmount();
-
-            ssd1306_fill(&ssd, !cor);                          // Limpa o display
-            ssd1306_draw_string(&ssd, "SD Desmontado", 2, 28); // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            printf("\nEscolha o comando (h = help):  ");
-        }
-        if (cRxedChar == 'c') // Lista diretórios e os arquivos se pressionar 'c'
-        {
-            printf("\nListagem de arquivos no cartão SD.\n");
-
-            ssd1306_fill(&ssd, !cor);                        // Limpa o display
-            ssd1306_draw_string(&ssd, "Listando", 2, 28);    // Desenha uma string
-            ssd1306_draw_string(&ssd, "Arquivos...", 2, 37); // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            run_ls();
-
-            ssd1306_fill(&ssd, !cor);                            // Limpa o display
-            ssd1306_draw_string(&ssd, "Lista Concluida", 2, 28); // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            printf("\nListagem concluída.\n");
-
-            printf("\nEscolha o comando (h = help):  ");
-        }
-        if (cRxedChar == 'd') // Exibe o conteúdo do arquivo se pressionar 'd'
-        {
-            ssd1306_fill(&ssd, !cor);                       // Limpa o display
-            ssd1306_draw_string(&ssd, "Lendo", 2, 28);      // Desenha uma string
-            ssd1306_draw_string(&ssd, "Arquivo...", 2, 37); // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            read_file(filename);
+        // Dorme até chegar caractere pela USB, botão, bloco de amostras ou aviso do cartão
+        uint32_t eventos = evt_wait();
 
-            ssd1306_fill(&ssd, !cor);                         // Limpa o display
-            ssd1306_draw_string(&ssd, "Arquivo Lido", 2, 28); // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            printf("Escolha o comando (h = help):  ");
-        }
-        if (cRxedChar == 'e') // Obtém o espaço livre no SD card se pressionar 'e'
+        // Esvazia tudo o que chegou pela USB desde o último evento
+        int cRxedChar;
+        while ((eventos & EVT_USB_RX) && PICO_ERROR_TIMEOUT != (cRxedChar = getchar_timeout_us(0)))
         {
-            ssd1306_fill(&ssd, !cor); // Limpa o display
-            ssd1306_send_data(&ssd);
-
-            printf("\nObtendo espaço livre no SD.\n\n");
-
-            ssd1306_fill(&ssd, !cor);                           // Limpa o display
-            ssd1306_draw_string(&ssd, "Obtendo Espaco", 2, 28); // Desenha uma string
-            ssd1306_draw_string(&ssd, "Livre...", 2, 37);       // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            run_getfree();
-
-            ssd1306_fill(&ssd, !cor);                          // Limpa o display
-            ssd1306_draw_string(&ssd, "Espaco Obtido", 2, 28); // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            printf("\nEspaço livre obtido.\n");
-
-            printf("\nEscolha o comando (h = help):  ");
+            process_stdio(cRxedChar);
         }
-        if (cRxedChar == 'f') // Captura dados do MPU6050 e salva no arquivo se pressionar 'f'
+        if ((eventos & EVT_AMOSTRA) && ring_log.is_open)
         {
-            ssd1306_fill(&ssd, !cor);                       // Limpa o display
-            ssd1306_draw_string(&ssd, "Capturando", 2, 28); // Desenha uma string
-            ssd1306_draw_string(&ssd, "Dados...", 2, 37);   // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            capture_data();
-
-            ssd1306_fill(&ssd, !cor);                          // Limpa o display
-            ssd1306_draw_string(&ssd, "Dados Obtidos", 2, 28); // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            printf("\nEscolha o comando (h = help):  ");
+            FRESULT fr = log_drenar(false);
+            if (erro_de_cartao(fr))
+            {
+                cartao_perdido(sd_get_by_num(0));
+            }
+            else if (FR_OK != fr)
+            {
+                // Outro erro de gravação (cartão cheio, por exemplo): encerra o log
+                blinking_rgb(25, 50, "magenta");
+                log_parar();
+            }
+            if (estat_nova)
+            {
+                estat_nova = false;
+                oled_estatisticas();
+            }
         }
-        if (cRxedChar == 'g') // Formata o SD card se pressionar 'g'
+        else if ((eventos & EVT_AMOSTRA) && log_suspenso)
         {
-            printf("\nProcesso de formatação do SD iniciado. Aguarde...\n");
-
-            ssd1306_fill(&ssd, !cor);                        // Limpa o display
-            ssd1306_draw_string(&ssd, "Formatacao", 2, 28);  // Desenha uma string
-            ssd1306_draw_string(&ssd, "Iniciada...", 2, 37); // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            run_format();
-
-            ssd1306_fill(&ssd, !cor);                       // Limpa o display
-            ssd1306_draw_string(&ssd, "Formatacao", 2, 28); // Desenha uma string
-            ssd1306_draw_string(&ssd, "Concluida", 2, 37);  // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            printf("\nFormatação concluída.\n\n");
-
-            printf("\nEscolha o comando (h = help):  ");
+            if (!aq_reservar() && !reserva_cheia)
+            {
+                reserva_cheia = true;
+                printf("\n[AVISO] Reserva em RAM cheia: novas amostras serão perdidas até o cartão voltar.\n");
+            }
         }
-        if (cRxedChar == 'h') // Exibe os comandos disponíveis se pressionar 'h'
+        if (eventos & EVT_CARTAO)
         {
-            ssd1306_fill(&ssd, !cor);                       // Limpa o display
-            ssd1306_draw_string(&ssd, "Ajuda", 2, 28);      // Desenha uma string
-            ssd1306_draw_string(&ssd, "Solicitada", 2, 37); // Desenha uma string
-            ssd1306_send_data(&ssd);
-
-            run_help();
+            sd_card_t *pSD = sd_get_by_num(0);
+            if (pSD->mounted && !sd_card_detect(pSD))
+                cartao_perdido(pSD);
+            else if (cartao_remontar)
+                cartao_retomar(pSD);
         }
         if (botaoA_pressionado)
         {
@@ -845,7 +2132,6 @@ int main()
             botaoB_pressionado = false;
             reset_usb_boot(0, 0);
         }
-        sleep_ms(500);
     }
     return 0;
 }
\ No newline at end of file
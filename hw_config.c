@@ -9,6 +9,8 @@
 #include "ff.h" /* Obtains integer types */
 //
 #include "diskio.h" /* Declarations of disk functions */
+//
+#include "sd_volume.h"
 
 /* 
 This example assumes the following hardware configuration:
@@ -19,12 +21,35 @@ This example assumes the following hardware configuration:
 | MOSI  | TX    | 19    | 25    | DI        | DI        | Master Out, Slave In   |
 | SCK   | SCK   | 18    | 24    | SCLK      | CLK       | SPI clock              |
 | CS0   | CSn   | 17    | 22    | SS or CS  | CS        | Slave (or Chip) Select |
-| DET   |       | 22    | 29    |           | CD        | Card Detect            |
+| DET   |       | 22    | 29    |           | CD        | Card Detect (optional) |
 | GND   |       |       | 18,23 |           | GND       | Ground                 |
 | 3v3   |       |       | 36    |           | 3v3       | 3.3 volt power         |
 
+With SD_VOLUME_MODE set, a second card goes on SPI1 and both cards make up
+drive "0:" (1 = striped, 2 = mirrored; see sd_volume.h):
+
+|       | SPI1  | GPIO  | Pin   | SPI       | MicroSD   | Description            |
+| ----- | ----  | ----- | ---   | --------  | --------- | ---------------------- |
+| MISO  | RX    | 28    | 34    | DO        | DO        | Master In, Slave Out   |
+| MOSI  | TX    | 27    | 32    | DI        | DI        | Master Out, Slave In   |
+| SCK   | SCK   | 26    | 31    | SCLK      | CLK       | SPI clock              |
+| CS1   |       | 20    | 26    | SS or CS  | CS        | Slave (or Chip) Select |
+
 */
 
+#ifndef SD_VOLUME_MODE
+#define SD_VOLUME_MODE 0  // 0: one card; 1: stripe over two cards; 2: mirror
+#endif
+#define SD_VOLUME_STRIPE_SECTORS 8  // 4 KiB chunks
+
+// GPIO of the socket's card detect pin, or -1 without one (the default). On the
+// BitDogLab GPIO 22 is the joystick button, and pressing it would read as the
+// card being removed. With a socket that has CD wired, build with e.g.
+// add_compile_definitions(SD_CARD_DETECT_GPIO=22).
+#ifndef SD_CARD_DETECT_GPIO
+#define SD_CARD_DETECT_GPIO -1
+#endif
+
 // Hardware Configuration of SPI "objects"
 // Note: multiple SD cards can be driven by one SPI if they use different slave
 // selects.
@@ -38,19 +63,65 @@ static spi_t spis[] = {  // One for each SPI.
         // .baud_rate = 1000 * 1000
         .baud_rate = 1000 * 1000
         // .baud_rate = 25 * 1000 * 1000 // Actual frequency: 20833333.
+    }
+#if SD_VOLUME_MODE
+    , {
+        .hw_inst = spi1,  // Second card of the volume, on its own DMA
+        .miso_gpio = 28,
+        .mosi_gpio = 27,
+        .sck_gpio = 26,
+        .baud_rate = 1000 * 1000
+    }
+#endif
+};
+
+#if SD_VOLUME_MODE
+// Cards reached only through the volume below; not mounted on their own
+static sd_card_t volume_cards[] = {
+    {
+        .pcName = "0a",
+        .spi = &spis[0],
+        .ss_gpio = 17,
+        .use_card_detect = false,
+        .card_detect_gpio = 22,
+        .card_detected_true = -1
+    },
+    {
+        .pcName = "0b",
+        .spi = &spis[1],
+        .ss_gpio = 20,
+        .use_card_detect = false
     }};
 
+static sd_volume_t volume = {
+    .mode = SD_VOLUME_MODE == 1 ? SD_VOLUME_STRIPE : SD_VOLUME_MIRROR,
+    .stripe_sectors = SD_VOLUME_STRIPE_SECTORS,
+    .n_members = count_of(volume_cards),
+    .members = {&volume_cards[0], &volume_cards[1]}
+};
+#endif
+
 // Hardware Configuration of the SD Card "objects"
 static sd_card_t sd_cards[] = {  // One for each SD card
+#if SD_VOLUME_MODE
+    {
+        .pcName = "0:",      // Name used to mount device
+        .volume = &volume    // Both cards, as one drive
+    }
+#else
     {
         .pcName = "0:",   // Name used to mount device
         .spi = &spis[0],  // Pointer to the SPI driving this card
         .ss_gpio = 17,    // The SPI slave select GPIO for this SD card
-        .use_card_detect = false,
-        .card_detect_gpio = 22,  // Card detect
-        .card_detected_true = -1  // What the GPIO read returns when a card is
+        // Card detect switch to GND when the socket is empty (pulled up when
+        // a card is in). Without it, removal is noticed when I/O fails.
+        .use_card_detect = SD_CARD_DETECT_GPIO >= 0,
+        .card_detect_gpio = SD_CARD_DETECT_GPIO >= 0 ? SD_CARD_DETECT_GPIO : 0,
+        .card_detected_true = 1  // What the GPIO read returns when a card is
                                  // present.
-    }};
+    }
+#endif
+};
 
 /* ********************************************************************** */
 size_t sd_get_num() { return count_of(sd_cards); }
@@ -0,0 +1,264 @@
+#ifndef AQUISICAO_H
+#define AQUISICAO_H
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "lib/FatFs_SPI/eventos.h"
+
+// Amostra binária gravada no log contínuo (16 bytes, 32 por setor de 512 bytes).
+typedef struct
+{
+  uint32_t t_us;    // time_us_32() no momento da leitura
+  int16_t accel[3]; // Valores brutos do MPU6050
+  int16_t gyro[3];
+} amostra_t;
+
+#define AQ_FILA_TAM 1024                      // Amostras na fila (potência de 2)
+#define AQ_BLOCO (512 / sizeof(amostra_t))    // Amostras por bloco gravado no cartão
+
+_Static_assert(AQ_FILA_TAM % AQ_BLOCO == 0, "AQ_FILA_TAM deve ser múltiplo de AQ_BLOCO");
+
+// Leitura do sensor sem bloquear nenhuma interrupção: a cada período o temporizador
+// só dispara uma transação I2C por DMA (um canal escreve os comandos no DATA_CMD do
+// I2C, outro lê os bytes que chegam), e a interrupção de fim do DMA de leitura põe a
+// amostra na fila. Um NACK ou um sensor travado não prendem o processador: a
+// transação que não terminou até o período seguinte é abortada e contada em
+// aq_falhas_i2c.
+#define AQ_I2C_BYTES 14 // MPU6050 a partir de 0x3B: accel[3], temperatura, gyro[3] (big-endian)
+
+// Fila circular de amostras. Produtor: fim do DMA; consumidor: laço principal.
+// Os índices crescem livremente; a posição na fila é índice & (AQ_FILA_TAM - 1).
+static amostra_t aq_fila[AQ_FILA_TAM];
+static volatile uint32_t aq_ini = 0;
+static volatile uint32_t aq_fim = 0;
+static volatile uint32_t aq_perdidas = 0;   // Amostras descartadas com a fila cheia
+static volatile uint32_t aq_falhas_i2c = 0; // Leituras abortadas por não terminarem a tempo
+
+// Reserva em RAM para os blocos que chegam enquanto o cartão está fora (sem PSRAM no Pico W).
+// Quando ela enche, a fila acima enche em seguida e as novas amostras são perdidas.
+// Com o log parado ela é a área de trabalho de format, resync e ls.
+#define AQ_RESERVA_BLOCOS 128 // 64 KiB: ~41 s a 100 Hz (potência de 2)
+static amostra_t aq_reserva[AQ_RESERVA_BLOCOS][AQ_BLOCO] __attribute__((aligned(8)));
+static uint32_t aq_reserva_ini = 0; // Índices de blocos, crescem livremente
+static uint32_t aq_reserva_fim = 0;
+
+static repeating_timer_t aq_timer;
+static bool aq_ativo = false;
+
+static i2c_inst_t *aq_i2c;
+static int aq_dma_tx = -1, aq_dma_rx = -1;
+static uint32_t aq_cmd[1 + AQ_I2C_BYTES]; // Palavras para o DATA_CMD: o registro inicial e as leituras
+static uint8_t aq_rx[AQ_I2C_BYTES];
+static volatile bool aq_lendo = false;    // Transação em andamento
+static volatile uint32_t aq_t_leitura;    // Início dela, o t_us da amostra
+
+// Aborta a transação em andamento, se houver, e libera o I2C para a próxima.
+static void aq_i2c_abortar()
+{
+  aq_lendo = false; // A interrupção de um canal abortado é ignorada
+  dma_channel_abort(aq_dma_tx);
+  dma_channel_abort(aq_dma_rx);
+  dma_hw->ints1 = 1u << aq_dma_rx;
+  // Um NACK deixa a FIFO de transmissão descartando tudo até o abort ser lido
+  (void)i2c_get_hw(aq_i2c)->clr_tx_abrt;
+  while (i2c_get_read_available(aq_i2c))
+    (void)i2c_get_hw(aq_i2c)->data_cmd;
+}
+
+static bool aq_timer_callback(repeating_timer_t *rt)
+{
+  if (aq_lendo)
+  {
+    if (!dma_channel_is_busy(aq_dma_rx))
+      return true; // Terminou e a interrupção ainda não rodou: fica com essa amostra
+    aq_i2c_abortar();
+    aq_falhas_i2c++;
+  }
+  if (aq_fim - aq_ini >= AQ_FILA_TAM)
+  {
+    aq_perdidas++; // O cartão não acompanhou: descarta em vez de sobrescrever
+    return true;
+  }
+  aq_t_leitura = time_us_32();
+  aq_lendo = true;
+  dma_channel_set_trans_count(aq_dma_rx, AQ_I2C_BYTES, false);
+  dma_channel_set_write_addr(aq_dma_rx, aq_rx, true);
+  dma_channel_set_trans_count(aq_dma_tx, count_of(aq_cmd), false);
+  dma_channel_set_read_addr(aq_dma_tx, aq_cmd, true);
+  return true;
+}
+
+// Fim do DMA de leitura: os bytes viram a amostra seguinte da fila.
+static void aq_dma_irq_handler()
+{
+  if (aq_dma_rx < 0 || !(dma_hw->ints1 & (1u << aq_dma_rx)))
+    return;
+  dma_hw->ints1 = 1u << aq_dma_rx;
+  if (!aq_lendo)
+    return;
+  aq_lendo = false;
+  uint32_t fim = aq_fim; // O temporizador já viu lugar na fila
+  amostra_t *a = &aq_fila[fim & (AQ_FILA_TAM - 1)];
+  a->t_us = aq_t_leitura;
+  for (int i = 0; i < 3; i++)
+  {
+    a->accel[i] = (int16_t)(aq_rx[i * 2] << 8 | aq_rx[i * 2 + 1]);
+    a->gyro[i] = (int16_t)(aq_rx[8 + i * 2] << 8 | aq_rx[8 + i * 2 + 1]);
+  }
+  aq_fim = fim + 1;
+  if ((fim + 1) % AQ_BLOCO == 0)
+    evt_post(EVT_AMOSTRA);
+}
+
+// Canais de DMA do I2C, uma vez: o de escrita no ritmo da FIFO de transmissão, o de
+// leitura no da recepção, com a interrupção DMA_IRQ_1 (a 0 é do cartão e da matriz).
+static void aq_dma_iniciar(i2c_inst_t *i2c)
+{
+  if (aq_dma_tx >= 0)
+    return;
+  aq_dma_tx = dma_claim_unused_channel(true);
+  aq_dma_rx = dma_claim_unused_channel(true);
+  dma_channel_config c = dma_channel_get_default_config(aq_dma_tx);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, i2c_get_dreq(i2c, true));
+  dma_channel_configure(aq_dma_tx, &c, &i2c_get_hw(i2c)->data_cmd, aq_cmd, count_of(aq_cmd), false);
+  c = dma_channel_get_default_config(aq_dma_rx);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, true);
+  channel_config_set_dreq(&c, i2c_get_dreq(i2c, false));
+  dma_channel_configure(aq_dma_rx, &c, aq_rx, &i2c_get_hw(i2c)->data_cmd, AQ_I2C_BYTES, false);
+  dma_channel_set_irq1_enabled(aq_dma_rx, true);
+  irq_add_shared_handler(DMA_IRQ_1, aq_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  irq_set_enabled(DMA_IRQ_1, true);
+}
+
+/**
+ * Inicia a amostragem periódica em "hz" amostras por segundo, lendo AQ_I2C_BYTES
+ * bytes a partir do registro "reg" do dispositivo "endereco" no barramento i2c.
+ */
+bool aq_iniciar(uint hz, i2c_inst_t *i2c, uint8_t endereco, uint8_t reg)
+{
+  if (aq_ativo || !hz)
+    return false;
+  aq_ini = aq_fim = 0;
+  aq_perdidas = 0;
+  aq_falhas_i2c = 0;
+  aq_reserva_ini = aq_reserva_fim = 0;
+  aq_i2c = i2c;
+  aq_dma_iniciar(i2c);
+  // Escreve o registro inicial e lê os bytes com um RESTART; STOP depois do último
+  aq_cmd[0] = reg;
+  for (int i = 0; i < AQ_I2C_BYTES; i++)
+    aq_cmd[1 + i] = I2C_IC_DATA_CMD_CMD_BITS;
+  aq_cmd[1] |= I2C_IC_DATA_CMD_RESTART_BITS;
+  aq_cmd[AQ_I2C_BYTES] |= I2C_IC_DATA_CMD_STOP_BITS;
+  // Endereço do dispositivo, como fazem as funções bloqueantes do SDK
+  i2c_get_hw(i2c)->enable = 0;
+  i2c_get_hw(i2c)->tar = endereco;
+  i2c_get_hw(i2c)->enable = 1;
+  // Período negativo: intervalo medido entre inícios de chamadas, sem acumular atraso
+  aq_ativo = add_repeating_timer_us(-(int64_t)(1000000 / hz), aq_timer_callback, NULL, &aq_timer);
+  return aq_ativo;
+}
+
+void aq_parar()
+{
+  if (aq_ativo)
+    cancel_repeating_timer(&aq_timer);
+  aq_ativo = false;
+  // A última transação termina em menos de 1 ms a 400 kHz; depois disso, é abortada
+  absolute_time_t limite = make_timeout_time_ms(2);
+  while (aq_lendo && !time_reached(limite))
+    tight_loop_contents();
+  if (aq_lendo)
+    aq_i2c_abortar();
+}
+
+/**
+ * Próximo bloco completo de AQ_BLOCO amostras, ou NULL se ainda não há.
+ * Os blocos nunca dão a volta na fila, então o ponteiro é contíguo.
+ */
+const amostra_t *aq_bloco()
+{
+  if (aq_fim - aq_ini < AQ_BLOCO)
+    return NULL;
+  return &aq_fila[aq_ini & (AQ_FILA_TAM - 1)];
+}
+
+/**
+ * Bloco k, contando do mais antigo ainda não liberado, sem liberá-lo: primeiro os
+ * da reserva, depois os completos da fila. NULL se não há; *da_reserva diz de onde é.
+ */
+const amostra_t *aq_bloco_seguinte(uint32_t k, bool *da_reserva)
+{
+  uint32_t na_reserva = aq_reserva_fim - aq_reserva_ini;
+  *da_reserva = k < na_reserva;
+  if (*da_reserva)
+    return aq_reserva[(aq_reserva_ini + k) & (AQ_RESERVA_BLOCOS - 1)];
+  k -= na_reserva;
+  if (aq_fim - aq_ini < (k + 1) * AQ_BLOCO)
+    return NULL;
+  return &aq_fila[(aq_ini + k * AQ_BLOCO) & (AQ_FILA_TAM - 1)];
+}
+
+// Amostras ainda não consumidas (após aq_parar(), o resto de um bloco incompleto).
+uint32_t aq_pendentes()
+{
+  return aq_fim - aq_ini;
+}
+
+const amostra_t *aq_inicio()
+{
+  return &aq_fila[aq_ini & (AQ_FILA_TAM - 1)];
+}
+
+// Libera amostras já gravadas para o temporizador.
+void aq_liberar(uint32_t n)
+{
+  aq_ini += n;
+}
+
+/**
+ * Sem cartão: copia os blocos completos da fila para a reserva, liberando a fila.
+ * Retorna false se a reserva está cheia.
+ */
+bool aq_reservar()
+{
+  const amostra_t *bloco;
+  while ((bloco = aq_bloco()))
+  {
+    if (aq_reserva_fim - aq_reserva_ini >= AQ_RESERVA_BLOCOS)
+      return false;
+    memcpy(aq_reserva[aq_reserva_fim & (AQ_RESERVA_BLOCOS - 1)], bloco, sizeof aq_reserva[0]);
+    aq_reserva_fim++;
+    aq_liberar(AQ_BLOCO);
+  }
+  return true;
+}
+
+// Bloco mais antigo da reserva (AQ_BLOCO amostras), ou NULL se ela está vazia.
+const amostra_t *aq_reserva_bloco()
+{
+  if (aq_reserva_ini == aq_reserva_fim)
+    return NULL;
+  return aq_reserva[aq_reserva_ini & (AQ_RESERVA_BLOCOS - 1)];
+}
+
+void aq_reserva_liberar()
+{
+  aq_reserva_ini++;
+}
+
+uint32_t aq_reserva_blocos()
+{
+  return aq_reserva_fim - aq_reserva_ini;
+}
+
+#endif
@@ -3,47 +3,160 @@
 
 #include "pico/stdlib.h"
 #include "hardware/pwm.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
 
-void buzzer_on(uint gpio, uint freq_hz) // Inicializa um buzzer com frequência em Hz
+#define BUZZER_PIN_A 10 // Buzzer A
+#define BUZZER_PIN_B 21 // Buzzer B
+
+#define BUZZER_FILA_TAM 8 // Número máximo de padrões aguardando na fila (potência de 2)
+
+// Padrão de som: "repeat" vezes (tom ligado por duration_ms, desligado por duration_ms)
+typedef struct
+{
+  uint16_t freq_hz;     // Frequência do tom (0 = pausa)
+  uint16_t duration_ms; // Duração de cada fase ligada/desligada
+  uint8_t repeat;       // Quantas vezes o padrão se repete
+} buzzer_tone_t;
+
+// Fila circular de padrões. Produtor: buzzer_play(); consumidor: alarme.
+static buzzer_tone_t buzzer_fila[BUZZER_FILA_TAM];
+static volatile uint8_t buzzer_fila_ini = 0;
+static volatile uint8_t buzzer_fila_fim = 0;
+
+// Estado do tocador (alterado apenas dentro do alarme ou com IRQs desabilitadas)
+static volatile bool buzzer_tocando = false;
+static buzzer_tone_t buzzer_atual;
+static bool buzzer_fase_ligada;
+
+void buzzer_on(uint gpio, uint freq_hz) // Liga o tom no buzzer (PWM já configurado em buzzer_init)
 {
-  gpio_set_function(gpio, GPIO_FUNC_PWM);
   uint slice = pwm_gpio_to_slice_num(gpio);
 
-  uint32_t clock = 125000000; // Clock da PWM da Pico
-  uint32_t wrap = clock / freq_hz;
+  // O contador da PWM tem 16 bits: escolhe o menor divisor inteiro que faça
+  // o wrap caber, a partir do clock real do sistema.
+  uint32_t clock = clock_get_hz(clk_sys);
+  uint32_t div = clock / (freq_hz * 65536u) + 1;
+  if (div > 255)
+    div = 255;
+  uint32_t wrap = clock / (div * freq_hz) - 1;
+  if (wrap > 0xFFFF)
+    wrap = 0xFFFF;
 
-  pwm_set_wrap(slice, wrap);
-  pwm_set_chan_level(slice, PWM_CHAN_A, wrap / 6); 
-  pwm_set_enabled(slice, true);
+  pwm_set_clkdiv_int_frac(slice, (uint8_t)div, 0);
+  pwm_set_wrap(slice, (uint16_t)wrap);
+  pwm_set_gpio_level(gpio, (uint16_t)(wrap / 6));
 }
 
-void buzzer_off(uint gpio) // Desliga o buzzer (desativa PWM e limpa o pino)
+void buzzer_off(uint gpio) // Silencia o buzzer (PWM continua configurada, nível zero)
 {
-  uint slice = pwm_gpio_to_slice_num(gpio);
-  pwm_set_enabled(slice, false);
-  gpio_set_function(gpio, GPIO_FUNC_SIO);
-  gpio_set_dir(gpio, GPIO_OUT);
-  gpio_put(gpio, 0);
+  pwm_set_gpio_level(gpio, 0);
+}
+
+static void buzzer_set(uint freq_hz)
+{
+  if (freq_hz)
+  {
+    buzzer_on(BUZZER_PIN_A, freq_hz);
+    buzzer_on(BUZZER_PIN_B, freq_hz);
+  }
+  else
+  {
+    buzzer_off(BUZZER_PIN_A);
+    buzzer_off(BUZZER_PIN_B);
+  }
+}
+
+// Retira o próximo padrão da fila. Chamar com IRQs desabilitadas ou no alarme.
+static bool buzzer_proximo()
+{
+  while (buzzer_fila_ini != buzzer_fila_fim)
+  {
+    buzzer_atual = buzzer_fila[buzzer_fila_ini];
+    buzzer_fila_ini = (buzzer_fila_ini + 1) & (BUZZER_FILA_TAM - 1);
+    if (buzzer_atual.repeat && buzzer_atual.duration_ms)
+      return true;
+  }
+  return false;
+}
+
+int64_t buzzer_alarm_callback(alarm_id_t id, void *user_data) // Avança o padrão atual a cada fase
+{
+  if (buzzer_fase_ligada)
+  {
+    // Fim da fase ligada: silencia pelo mesmo tempo
+    buzzer_set(0);
+    buzzer_fase_ligada = false;
+    return -(int64_t)buzzer_atual.duration_ms * 1000;
+  }
+
+  // Fim da fase desligada: repete o padrão ou passa para o próximo da fila
+  if (--buzzer_atual.repeat == 0 && !buzzer_proximo())
+  {
+    buzzer_tocando = false;
+    return 0;
+  }
+  buzzer_set(buzzer_atual.freq_hz);
+  buzzer_fase_ligada = true;
+  return -(int64_t)buzzer_atual.duration_ms * 1000;
 }
 
-void buzzer_beep(uint freq_hz, uint duration_ms, uint times) // Beep do buzzer com duração em ms
+void buzzer_init() // Configura a PWM dos dois buzzers uma única vez
 {
-  for (uint i = 0; i < times; i++)
+  uint pinos[] = {BUZZER_PIN_A, BUZZER_PIN_B};
+  for (uint i = 0; i < 2; i++)
   {
-    buzzer_on(10, freq_hz);
-    buzzer_on(21, freq_hz);
-    sleep_ms(duration_ms);
-    buzzer_off(10);
-    buzzer_off(21);
-    sleep_ms(duration_ms);
+    gpio_set_function(pinos[i], GPIO_FUNC_PWM);
+    uint slice = pwm_gpio_to_slice_num(pinos[i]);
+    pwm_set_gpio_level(pinos[i], 0);
+    pwm_set_enabled(slice, true);
   }
 }
 
-int64_t desligar_buzzer_callback(alarm_id_t id, void *user_data) // Callback para desligar o buzzer após um tempo
+bool buzzer_play(buzzer_tone_t tom) // Enfileira um padrão; retorna imediatamente
+{
+  bool ok = true;
+  uint32_t irq = save_and_disable_interrupts();
+
+  uint8_t prox = (buzzer_fila_fim + 1) & (BUZZER_FILA_TAM - 1);
+  if (prox == buzzer_fila_ini)
+    ok = false; // Fila cheia: descarta o padrão
+  else
+  {
+    buzzer_fila[buzzer_fila_fim] = tom;
+    buzzer_fila_fim = prox;
+  }
+
+  bool iniciar = ok && !buzzer_tocando && buzzer_proximo();
+  if (iniciar)
+  {
+    buzzer_tocando = true;
+    buzzer_fase_ligada = true;
+    buzzer_set(buzzer_atual.freq_hz);
+  }
+  restore_interrupts(irq);
+
+  if (iniciar && add_alarm_in_ms(buzzer_atual.duration_ms, buzzer_alarm_callback, NULL, true) < 0)
+  {
+    buzzer_set(0); // Sem alarmes disponíveis: não deixa o buzzer ligado
+    buzzer_tocando = false;
+    ok = false;
+  }
+  return ok;
+}
+
+void buzzer_beep(uint freq_hz, uint duration_ms, uint times) // Beep do buzzer com duração em ms (não bloqueante)
+{
+  buzzer_tone_t tom = {
+      .freq_hz = (uint16_t)freq_hz,
+      .duration_ms = (uint16_t)duration_ms,
+      .repeat = (uint8_t)times};
+  buzzer_play(tom);
+}
+
+bool buzzer_ocupado() // Indica se ainda há som tocando ou na fila
 {
-  uint gpio_buzzer = (uint)(uintptr_t)user_data;
-  buzzer_off(gpio_buzzer);
-  return 0;
+  return buzzer_tocando;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,149 @@
+#ifndef COMPRESSAO_H
+#define COMPRESSAO_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "lib/FatFs_SPI/aquisicao.h"
+
+// Compressão sem perdas de um bloco de amostras (delta + zigzag + bit-packing).
+// As amostras vizinhas mudam poucas unidades, então cada canal guarda a primeira
+// amostra inteira e depois só as diferenças, com o número de bits da maior
+// delas no bloco. Formato (little-endian), lido por ArquivosDados/decodifica_log.py:
+//
+//   uint8  n            Amostras no bloco
+//   uint8  bits[7]      Bits por resíduo: tempo, accel[3], gyro[3]
+//   uint32 t0           t_us da primeira amostra
+//   uint32 periodo      t_us[1] - t_us[0] (0 se n = 1)
+//   int16  v0[6]        accel[3] e gyro[3] da primeira amostra
+//   resíduos            Canal por canal, bits[c] bits cada, a partir do bit menos
+//                       significativo de cada byte:
+//                       tempo: zigzag((t[i] - t[i-1]) - periodo), i = 2..n-1
+//                       valores: zigzag(v[i] - v[i-1]), i = 1..n-1
+#define COMP_TIPO_REGISTRO 1 // Tipo do registro no ring_log (0: amostras brutas)
+#define COMP_CABECALHO 28
+#define COMP_CANAIS 7
+
+static inline uint32_t comp_zigzag(int32_t v)
+{
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline uint32_t comp_bits(uint32_t v)
+{
+  return v ? 32 - __builtin_clz(v) : 0;
+}
+
+static inline int32_t comp_residuo(const amostra_t *a, uint32_t c, uint32_t i, uint32_t periodo)
+{
+  if (!c)
+    return (int32_t)(a[i].t_us - a[i - 1].t_us - periodo);
+  const int16_t *v = c <= 3 ? a[i].accel : a[i].gyro;
+  const int16_t *u = c <= 3 ? a[i - 1].accel : a[i - 1].gyro;
+  uint32_t k = (c - 1) % 3;
+  return (int32_t)v[k] - u[k];
+}
+
+/**
+ * Comprime n amostras (1 a 255) em saida, que precisa de espaço para n amostras
+ * brutas. Retorna o tamanho comprimido, ou 0 se ele não ficaria menor que o bruto.
+ */
+static uint32_t comp_bloco(const amostra_t *a, uint32_t n, uint8_t *saida)
+{
+  uint32_t periodo = n > 1 ? a[1].t_us - a[0].t_us : 0;
+  uint32_t bits[COMP_CANAIS], total = 0;
+  for (uint32_t c = 0; c < COMP_CANAIS; c++)
+  {
+    uint32_t ou = 0; // OU dos resíduos: o maior deles define a largura
+    for (uint32_t i = c ? 1 : 2; i < n; i++)
+      ou |= comp_zigzag(comp_residuo(a, c, i, periodo));
+    bits[c] = comp_bits(ou);
+    total += bits[c] * (n - (c ? 1 : (n > 1 ? 2 : 1)));
+  }
+  uint32_t tam = COMP_CABECALHO + (total + 7) / 8;
+  if (tam >= n * sizeof(amostra_t))
+    return 0;
+
+  uint8_t *p = saida;
+  *p++ = (uint8_t)n;
+  for (uint32_t c = 0; c < COMP_CANAIS; c++)
+    *p++ = (uint8_t)bits[c];
+  memcpy(p, &a[0].t_us, 4);
+  memcpy(p + 4, &periodo, 4);
+  memcpy(p + 8, a[0].accel, 6);
+  memcpy(p + 14, a[0].gyro, 6);
+  p += 20;
+
+  uint64_t acc = 0; // Bits ainda não escritos, a partir do menos significativo
+  uint32_t nacc = 0;
+  for (uint32_t c = 0; c < COMP_CANAIS; c++)
+  {
+    if (!bits[c])
+      continue;
+    for (uint32_t i = c ? 1 : 2; i < n; i++)
+    {
+      acc |= (uint64_t)comp_zigzag(comp_residuo(a, c, i, periodo)) << nacc;
+      nacc += bits[c];
+      while (nacc >= 8)
+      {
+        *p++ = (uint8_t)acc;
+        acc >>= 8;
+        nacc -= 8;
+      }
+    }
+  }
+  if (nacc)
+    *p++ = (uint8_t)acc;
+  return (uint32_t)(p - saida);
+}
+
+/**
+ * Inverso de comp_bloco: expande um registro de tam bytes em a, que precisa de
+ * espaço para 255 amostras. Retorna o número de amostras, ou 0 se o registro é
+ * inválido.
+ */
+static uint32_t comp_expandir(const uint8_t *dados, uint32_t tam, amostra_t *a)
+{
+  if (tam < COMP_CABECALHO || !dados[0])
+    return 0;
+  uint32_t n = dados[0], periodo;
+  const uint8_t *bits = dados + 1;
+  memcpy(&a[0].t_us, dados + 8, 4);
+  memcpy(&periodo, dados + 12, 4);
+  memcpy(a[0].accel, dados + 16, 6);
+  memcpy(a[0].gyro, dados + 22, 6);
+  if (n > 1)
+    a[1].t_us = a[0].t_us + periodo;
+  const uint8_t *p = dados + COMP_CABECALHO, *fim = dados + tam;
+
+  uint64_t acc = 0;
+  uint32_t nacc = 0;
+  for (uint32_t c = 0; c < COMP_CANAIS; c++)
+  {
+    if (bits[c] > 32)
+      return 0;
+    for (uint32_t i = c ? 1 : 2; i < n; i++)
+    {
+      while (nacc < bits[c])
+      {
+        if (p == fim)
+          return 0;
+        acc |= (uint64_t)*p++ << nacc;
+        nacc += 8;
+      }
+      uint32_t z = bits[c] ? (uint32_t)(acc & (~0ull >> (64 - bits[c]))) : 0;
+      acc >>= bits[c];
+      nacc -= bits[c];
+      int32_t r = (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+      if (!c)
+        a[i].t_us = a[i - 1].t_us + periodo + (uint32_t)r;
+      else if (c <= 3)
+        a[i].accel[c - 1] = (int16_t)(a[i - 1].accel[c - 1] + r);
+      else
+        a[i].gyro[c - 4] = (int16_t)(a[i - 1].gyro[c - 4] + r);
+    }
+  }
+  return n;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "ff.h"
+
+// Linhas CSV com duas casas decimais sem printf. Cada valor vira um inteiro de
+// centésimos com o mesmo arredondamento do "%.2f" (o mais próximo, empate para
+// o par, sobre o valor binário exato), e os dígitos vão para o FFMT do FatFs.
+// Assim a saída é idêntica byte a byte à do sprintf, sem o printf de ponto
+// flutuante por software.
+
+/**
+ * Centésimos de m * 2^-s, em módulo. m * 100 precisa caber em 32 bits.
+ */
+static inline uint32_t csv_centesimos(uint32_t m, int s)
+{
+  uint32_t q = m * 100;
+  if (s <= 0)
+    return q << -s;
+  if (s >= 32)
+    return 0; // q < 2^31: menos de meio centésimo
+  uint32_t r = q >> s;
+  uint32_t resto = q - (r << s);
+  uint32_t meio = 1u << (s - 1);
+  return r + (resto > meio || (resto == meio && (r & 1)));
+}
+
+/**
+ * Centésimos de um float qualquer até ~2e7, em módulo; *neg recebe o sinal
+ * (também de -0.0 e de valores que arredondam para zero, como faz o printf).
+ */
+static inline uint32_t csv_float(float x, bool *neg)
+{
+  uint32_t u;
+  memcpy(&u, &x, sizeof u);
+  *neg = u >> 31;
+  int e = (int)(u >> 23 & 0xFF);
+  uint32_t m = u & 0x7FFFFF;
+  if (e)
+    m |= 0x800000;
+  else
+    e = 1; // Subnormal
+  return csv_centesimos(m, 150 - e); // x = m * 2^(e - 150)
+}
+
+// Escreve ",<valor>" com duas casas.
+static inline void csv_valor(FFMT *fb, uint32_t centesimos, bool neg)
+{
+  f_fmt_putc(fb, ',');
+  if (neg)
+    f_fmt_putc(fb, '-');
+  f_fmt_fix(fb, (long)centesimos, 2);
+}
+
+/**
+ * Contagem bruta do sensor dividida por 2^s (16384 = 2^14 no acelerômetro a ±2 g),
+ * igual a sprintf("%.2f", bruto / (float)(1 << s)).
+ */
+static inline void csv_bruto(FFMT *fb, int16_t bruto, int s)
+{
+  csv_valor(fb, csv_centesimos(bruto < 0 ? -(int32_t)bruto : bruto, s), bruto < 0);
+}
+
+static inline void csv_float2(FFMT *fb, float x)
+{
+  bool neg;
+  uint32_t c = csv_float(x, &neg);
+  csv_valor(fb, c, neg);
+}
+
+#endif
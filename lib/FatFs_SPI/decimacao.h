@@ -0,0 +1,91 @@
+#ifndef DECIMACAO_H
+#define DECIMACAO_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "lib/FatFs_SPI/aquisicao.h"
+
+// Banco de decimação: estágios CIC de ordem 3 em cascata, cada um reduzindo a taxa
+// por 10 (1 kHz -> 100 Hz -> 10 Hz -> 1 Hz). Só somas e subtrações em 32 bits por
+// amostra; a divisão pelo ganho (10^3) é feita uma vez por saída. Uma passada
+// sobre o bloco alimenta todos os estágios. As saídas têm o formato de amostra_t
+// (valores brutos filtrados; t_us é o da última amostra de entrada da janela) e
+// se acumulam para os logs resumidos, que as gravam a cada AQ_BLOCO saídas.
+#define DEC_FATOR 10
+#define DEC_ORDEM 3
+#define DEC_GANHO (DEC_FATOR * DEC_FATOR * DEC_FATOR) // DEC_FATOR ^ DEC_ORDEM
+#define DEC_ESTAGIOS 3
+#define DEC_CANAIS 6
+#define DEC_SAIDA_MAX (AQ_BLOCO + AQ_BLOCO / DEC_FATOR + 1) // Folga para as saídas de mais um bloco
+
+typedef struct
+{
+  uint32_t integ[DEC_ORDEM][DEC_CANAIS]; // Aritmética módulo 2^32: o estouro se cancela nos pentes
+  uint32_t pente[DEC_ORDEM][DEC_CANAIS]; // Entrada anterior de cada pente
+  uint32_t fase;                         // Entradas desde a última saída
+  uint32_t aquecendo;                    // Saídas ainda no transitório inicial, descartadas
+  amostra_t saida[DEC_SAIDA_MAX];        // Saídas ainda não gravadas
+  uint32_t n_saida;
+} dec_estagio_t;
+
+static dec_estagio_t dec_estagios[DEC_ESTAGIOS];
+
+static void dec_iniciar()
+{
+  memset(dec_estagios, 0, sizeof dec_estagios);
+  for (int e = 0; e < DEC_ESTAGIOS; e++)
+    dec_estagios[e].aquecendo = DEC_ORDEM - 1;
+}
+
+// Passa uma amostra pelo primeiro estágio; cada estágio alimenta o seguinte a cada
+// DEC_FATOR entradas.
+static void dec_amostra(const amostra_t *a)
+{
+  amostra_t x = *a;
+  for (int e = 0; e < DEC_ESTAGIOS; e++)
+  {
+    dec_estagio_t *d = &dec_estagios[e];
+    for (int c = 0; c < DEC_CANAIS; c++)
+    {
+      uint32_t v = (uint32_t)(int32_t)(c < 3 ? x.accel[c] : x.gyro[c - 3]);
+      d->integ[0][c] += v;
+      d->integ[1][c] += d->integ[0][c];
+      d->integ[2][c] += d->integ[1][c];
+    }
+    if (++d->fase < DEC_FATOR)
+      return;
+    d->fase = 0;
+    for (int c = 0; c < DEC_CANAIS; c++)
+    {
+      uint32_t y = d->integ[2][c];
+      for (int k = 0; k < DEC_ORDEM; k++)
+      {
+        uint32_t anterior = d->pente[k][c];
+        d->pente[k][c] = y;
+        y -= anterior;
+      }
+      int32_t s = (int32_t)y; // |s| <= 32768 * DEC_GANHO: cabe em 32 bits
+      int16_t m = (int16_t)((s + (s < 0 ? -DEC_GANHO / 2 : DEC_GANHO / 2)) / DEC_GANHO);
+      if (c < 3)
+        x.accel[c] = m;
+      else
+        x.gyro[c - 3] = m;
+    }
+    if (d->aquecendo)
+    {
+      d->aquecendo--;
+      return; // Nem este estágio nem os seguintes recebem o transitório
+    }
+    if (d->n_saida < DEC_SAIDA_MAX) // Cheio só se a gravação falhou
+      d->saida[d->n_saida++] = x;
+  }
+}
+
+static inline void dec_bloco(const amostra_t *a, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++)
+    dec_amostra(&a[i]);
+}
+
+#endif
@@ -0,0 +1,348 @@
+#ifndef ESPECTRO_H
+#define ESPECTRO_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/FatFs_SPI/aquisicao.h"
+
+// Espectro de vibração do acelerômetro: FFT radix-2 em Q15, in-place, com ponto
+// flutuante em bloco (cada estágio só divide por 2 quando a soma poderia estourar),
+// sobre quadros de 256 a 1024 amostras de cada eixo. A média do quadro é removida
+// antes da janela, senão a gravidade vazaria para as primeiras raias. As magnitudes
+// de esp.medias quadros seguidos são somadas e viram um registro de tipo
+// ESP_TIPO_REGISTRO no ring_log, lido por ArquivosDados/decodifica_espectro.py.
+//
+// O núcleo 0 copia as amostras (esp_bloco) para um de dois quadros; cada quadro
+// cheio é calculado por esp_calcular, normalmente no núcleo 1, que só escreve no
+// quadro e nas somas. O núcleo 0 só fecha a média (esp_fechar) quando nenhum
+// quadro está em cálculo.
+#define ESP_TIPO_REGISTRO 3 // Tipo do registro no ring_log (2: estatísticas)
+#define ESP_N_MIN 256
+#define ESP_N_MAX 1024
+#define ESP_MEDIAS_MAX 64
+#define ESP_EIXOS 3
+#define ESP_RAIAS_MAX (ESP_N_MAX / 2 + 1) // Raias 0 a N/2
+#define ESP_LIMITE 13572                  // Maior |re|, |im| sem estouro numa borboleta: 32767 / (1 + sqrt(2))
+
+typedef enum
+{
+  ESP_JANELA_RET,
+  ESP_JANELA_HANN,
+  ESP_JANELA_HAMMING,
+} esp_janela_t;
+
+// Registro de um espectro médio (little-endian). Só as raias 0 a n/2 de cada eixo
+// são gravadas, eixo após eixo: 18 + 3 * (n / 2 + 1) * 2 bytes. A magnitude média
+// |X[k]| do eixo e é raias[e * (n / 2 + 1) + k] * 2^expoente[e], com
+// X[k] = soma de w[i] * (x[i] - média) * e^(-2πjik/n), w em [0, 1] e x em contagens
+// brutas do sensor.
+typedef struct
+{
+  uint32_t t0_us;              // t_us da primeira amostra do primeiro quadro
+  uint32_t t1_us;              // t_us da última amostra do último quadro
+  uint16_t n;                  // Pontos da FFT
+  uint16_t hz;                 // Taxa de amostragem do log
+  uint8_t quadros;             // Quadros na média (menos que esp.medias só no último)
+  uint8_t janela;              // esp_janela_t
+  int8_t expoente[ESP_EIXOS];
+  uint8_t reservado;
+  uint16_t raias[ESP_EIXOS * ESP_RAIAS_MAX];
+} esp_registro_t;
+
+#define ESP_CABECALHO 18 // offsetof(esp_registro_t, raias)
+
+typedef enum
+{
+  ESP_LIVRE,
+  ESP_CHEIO,      // Esperando o cálculo
+  ESP_CALCULANDO, // Entregue ao núcleo 1
+} esp_estado_t;
+
+typedef struct
+{
+  volatile uint8_t estado; // esp_estado_t
+  uint32_t n;
+  uint32_t t0_us, t1_us;
+  int16_t x[ESP_EIXOS][ESP_N_MAX];
+} esp_quadro_t;
+
+typedef struct
+{
+  uint32_t n;        // Pontos da FFT; 0: desligado
+  uint32_t log2n;
+  uint32_t medias;   // Quadros por registro
+  esp_janela_t janela;
+  uint16_t hz;
+  uint32_t enchendo; // Quadro que recebe as amostras
+  uint32_t proximo;  // Quadro cheio mais antigo
+  uint32_t quadros;  // Quadros já somados
+  uint32_t perdidas; // Amostras descartadas com os dois quadros ocupados
+  uint32_t t0_us, t1_us;
+  uint64_t soma[ESP_EIXOS][ESP_RAIAS_MAX]; // Magnitudes em unidades de 2^-16
+  esp_registro_t registro;
+  bool pronto; // registro ainda não foi gravado
+} esp_t;
+
+static esp_t esp;
+static esp_quadro_t esp_quadros[2];
+static int16_t esp_cos[ESP_N_MAX / 2 + 1]; // cos e sen de 2πk/ESP_N_MAX em Q15, 0 <= k <= N/2
+static int16_t esp_sen[ESP_N_MAX / 2 + 1];
+static int16_t esp_re[ESP_N_MAX]; // Área de trabalho da FFT (só no núcleo que calcula)
+static int16_t esp_im[ESP_N_MAX];
+
+/**
+ * Prepara o motor para quadros de n pontos (potência de 2 entre ESP_N_MIN e
+ * ESP_N_MAX, ou 0 para desligar), com a média de "medias" quadros por registro.
+ */
+static void esp_iniciar(uint32_t n, uint32_t medias, esp_janela_t janela, uint16_t hz)
+{
+  if (!esp_cos[0])
+    for (int k = 0; k <= ESP_N_MAX / 2; k++)
+    {
+      esp_cos[k] = (int16_t)lround(32767 * cos(2 * M_PI * k / ESP_N_MAX));
+      esp_sen[k] = (int16_t)lround(32767 * sin(2 * M_PI * k / ESP_N_MAX));
+    }
+  memset(&esp, 0, sizeof esp);
+  memset(esp_quadros, 0, sizeof esp_quadros);
+  esp.n = n;
+  while ((1u << esp.log2n) < n)
+    esp.log2n++;
+  esp.medias = medias;
+  esp.janela = janela;
+  esp.hz = hz;
+}
+
+// Peso da janela na amostra i, em Q15.
+static inline int32_t esp_peso(uint32_t i)
+{
+  if (i > esp.n / 2)
+    i = esp.n - i; // Janelas simétricas: só metade da tabela de cossenos
+  int32_t c = esp_cos[i * (ESP_N_MAX / esp.n)];
+  switch (esp.janela)
+  {
+  case ESP_JANELA_HANN:
+    return (32768 - c) >> 1;
+  case ESP_JANELA_HAMMING:
+    return 17695 - ((15073 * c) >> 15); // 0,54 - 0,46 cos
+  default:
+    return 32767;
+  }
+}
+
+static inline uint32_t esp_raiz(uint32_t v)
+{
+  uint32_t r = 0;
+  for (uint32_t b = 1u << 30; b; b >>= 2)
+  {
+    if (v >= r + b)
+    {
+      v -= r + b;
+      r = (r >> 1) + b;
+    }
+    else
+      r >>= 1;
+  }
+  return r;
+}
+
+/**
+ * FFT em esp_re/esp_im, já em ordem de bits invertidos. Retorna quantas vezes os
+ * dados foram divididos por 2.
+ */
+static int esp_fft()
+{
+  uint32_t n = esp.n;
+  int escalas = 0;
+  int32_t pico = 0;
+  for (uint32_t i = 0; i < n; i++)
+  {
+    int32_t m = abs(esp_re[i]) > abs(esp_im[i]) ? abs(esp_re[i]) : abs(esp_im[i]);
+    if (m > pico)
+      pico = m;
+  }
+  for (uint32_t tam = 2; tam <= n; tam <<= 1)
+  {
+    int d = 0; // Divisões por 2 neste estágio, feitas nas somas ainda em 32 bits
+    while ((pico >> d) > ESP_LIMITE)
+      d++;
+    int32_t meia = d ? 1 << (d - 1) : 0;
+    escalas += d;
+    pico = 0;
+    uint32_t meio = tam / 2, passo = ESP_N_MAX / tam;
+    for (uint32_t j = 0; j < meio; j++)
+    {
+      int32_t wr = esp_cos[j * passo], wi = -esp_sen[j * passo]; // e^(-2πjk/tam)
+      for (uint32_t a = j; a < n; a += tam)
+      {
+        uint32_t b = a + meio;
+        int32_t tr = (esp_re[b] * wr - esp_im[b] * wi + (1 << 14)) >> 15;
+        int32_t ti = (esp_re[b] * wi + esp_im[b] * wr + (1 << 14)) >> 15;
+        int32_t ar = esp_re[a], ai = esp_im[a];
+        int32_t v[4] = {(ar + tr + meia) >> d, (ai + ti + meia) >> d, (ar - tr + meia) >> d, (ai - ti + meia) >> d};
+        esp_re[a] = v[0];
+        esp_im[a] = v[1];
+        esp_re[b] = v[2];
+        esp_im[b] = v[3];
+        for (int k = 0; k < 4; k++)
+          if (abs(v[k]) > pico)
+            pico = abs(v[k]);
+      }
+    }
+  }
+  return escalas;
+}
+
+/**
+ * Calcula um quadro cheio e soma suas magnitudes (tarefa do núcleo 1; o argumento
+ * é o esp_quadro_t). Libera o quadro ao terminar.
+ */
+static void esp_calcular(void *arg)
+{
+  esp_quadro_t *q = arg;
+  uint32_t n = esp.n;
+  for (int e = 0; e < ESP_EIXOS; e++)
+  {
+    const int16_t *x = q->x[e];
+    int32_t soma = 0;
+    for (uint32_t i = 0; i < n; i++)
+      soma += x[i];
+    int32_t media = (soma + (soma < 0 ? -(int32_t)n : (int32_t)n) / 2) / (int32_t)n; // Arredondada
+    // Janela sobre x - média (Q15) e o maior valor, para aproveitar os 16 bits
+    int32_t pico = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+      int32_t v = (x[i] - media) * esp_peso(i);
+      if (abs(v) > pico)
+        pico = abs(v);
+    }
+    int q15 = 0; // Deslocamento que traz o pico para até ESP_LIMITE
+    while ((pico >> q15) >= ESP_LIMITE) // >=: o arredondamento pode somar 1
+      q15++;
+    // Entrada em ordem de bits invertidos: a FFT sai em ordem natural
+    for (uint32_t i = 0, r = 0; i < n; i++)
+    {
+      int32_t v = (x[i] - media) * esp_peso(i);
+      esp_re[r] = (int16_t)(q15 ? (v + (1 << (q15 - 1))) >> q15 : v);
+      esp_im[r] = 0;
+      // r = i + 1 com os log2n bits invertidos
+      uint32_t bit = n >> 1;
+      while (r & bit)
+      {
+        r ^= bit;
+        bit >>= 1;
+      }
+      r |= bit;
+    }
+    int expoente = q15 - 15 + esp_fft() + 16; // Magnitude em unidades de 2^-16
+    for (uint32_t k = 0; k <= n / 2; k++)
+    {
+      uint32_t m = esp_raiz((uint32_t)(esp_re[k] * esp_re[k]) + (uint32_t)(esp_im[k] * esp_im[k]));
+      esp.soma[e][k] += expoente >= 0 ? (uint64_t)m << expoente : m >> -expoente;
+    }
+  }
+  if (!esp.quadros++)
+    esp.t0_us = q->t0_us;
+  esp.t1_us = q->t1_us;
+  esp.proximo ^= 1;
+  q->n = 0;
+  q->estado = ESP_LIVRE;
+}
+
+// Copia n amostras do acelerômetro para os quadros.
+static void esp_bloco(const amostra_t *a, uint32_t n)
+{
+  if (!esp.n)
+    return;
+  for (uint32_t i = 0; i < n; i++)
+  {
+    esp_quadro_t *q = &esp_quadros[esp.enchendo];
+    if (ESP_LIVRE != q->estado)
+    {
+      esp.perdidas++; // Os dois quadros esperam o cálculo
+      continue;
+    }
+    if (!q->n)
+      q->t0_us = a[i].t_us;
+    q->t1_us = a[i].t_us;
+    for (int e = 0; e < ESP_EIXOS; e++)
+      q->x[e][q->n] = a[i].accel[e];
+    if (++q->n == esp.n)
+    {
+      q->estado = ESP_CHEIO;
+      esp.enchendo ^= 1;
+    }
+  }
+}
+
+/**
+ * Quadro cheio esperando o cálculo, na ordem em que foram enchidos, ou NULL. Só
+ * enquanto a média não está completa: o quadro seguinte espera o registro ser gravado.
+ */
+static esp_quadro_t *esp_pendente()
+{
+  esp_quadro_t *q = &esp_quadros[esp.proximo];
+  if (!esp.n || esp.quadros >= esp.medias || ESP_CHEIO != q->estado)
+    return NULL;
+  return q;
+}
+
+/**
+ * Fecha a média em esp.registro quando ela tem esp.medias quadros. Com "tudo",
+ * calcula antes, no próprio núcleo, os quadros cheios que faltam e fecha também uma
+ * média incompleta. Retorna true se há um registro a gravar (a aplicação zera
+ * esp.pronto depois de gravá-lo e chama de novo até retornar false); nunca fecha
+ * com um quadro em cálculo no núcleo 1.
+ */
+static bool esp_fechar(bool tudo)
+{
+  if (esp.pronto)
+    return true;
+  if (ESP_CALCULANDO == esp_quadros[0].estado || ESP_CALCULANDO == esp_quadros[1].estado)
+    return false;
+  esp_quadro_t *q;
+  while (tudo && (q = esp_pendente()))
+    esp_calcular(q);
+  if (!esp.quadros || (esp.quadros < esp.medias && !tudo))
+    return false;
+
+  esp_registro_t *r = &esp.registro;
+  r->t0_us = esp.t0_us;
+  r->t1_us = esp.t1_us;
+  r->n = (uint16_t)esp.n;
+  r->hz = esp.hz;
+  r->quadros = (uint8_t)esp.quadros;
+  r->janela = (uint8_t)esp.janela;
+  r->reservado = 0;
+  for (int e = 0; e < ESP_EIXOS; e++)
+  {
+    uint64_t maior = 0;
+    for (uint32_t k = 0; k <= esp.n / 2; k++)
+    {
+      esp.soma[e][k] /= esp.quadros;
+      if (esp.soma[e][k] > maior)
+        maior = esp.soma[e][k];
+    }
+    int d = 0; // Divisão que faz a maior raia, arredondada, caber em 16 bits
+    while (((maior + (d ? 1ull << (d - 1) : 0)) >> d) > UINT16_MAX)
+      d++;
+    uint16_t *raias = &r->raias[e * (esp.n / 2 + 1)];
+    for (uint32_t k = 0; k <= esp.n / 2; k++)
+      raias[k] = (uint16_t)((esp.soma[e][k] + (d ? 1ull << (d - 1) : 0)) >> d);
+    r->expoente[e] = (int8_t)(d - 16);
+  }
+  memset(esp.soma, 0, sizeof esp.soma);
+  esp.quadros = 0;
+  esp.pronto = true;
+  return true;
+}
+
+static inline uint32_t esp_tamanho_registro()
+{
+  return ESP_CABECALHO + ESP_EIXOS * (esp.n / 2 + 1) * sizeof(uint16_t);
+}
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef ESTATISTICAS_H
+#define ESTATISTICAS_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lib/FatFs_SPI/aquisicao.h"
+
+// Estatísticas por janela de amostras (mínimo, máximo, média, RMS e desvio padrão)
+// de cada eixo do acelerômetro e do giroscópio, calculadas amostra a amostra.
+// Em vez da atualização de Welford em ponto flutuante (uma divisão por amostra e
+// canal, por software no RP2040), acumula somas inteiras exatas de x e x²: não há
+// erro acumulado ao longo da janela, e o ponto flutuante fica só no fechamento. Com int64, a janela pode ter milhões de
+// amostras. Cada janela vira um registro de tipo ESTAT_TIPO_REGISTRO no ring_log,
+// lido por ArquivosDados/decodifica_estatisticas.py.
+#define ESTAT_TIPO_REGISTRO 2 // Tipo do registro no ring_log (0: bruto, 1: comprimido)
+#define ESTAT_CANAIS 6
+
+// Registro de uma janela (little-endian, 108 bytes). Valores nas unidades brutas do sensor.
+typedef struct
+{
+  int16_t min;
+  int16_t max;
+  float media;
+  float rms;
+  float desvio; // Desvio padrão populacional: o RMS sem a componente contínua
+} estat_canal_t;
+
+typedef struct
+{
+  uint32_t t0_us;                     // t_us da primeira amostra da janela
+  uint32_t t1_us;                     // t_us da última
+  uint32_t n;                         // Amostras na janela (menos que a janela só na última, em "log stop")
+  estat_canal_t canal[ESTAT_CANAIS];  // accel[3], gyro[3]
+} estat_registro_t;
+
+_Static_assert(sizeof(estat_registro_t) == 108, "estat_registro_t deve ter 108 bytes");
+
+typedef struct
+{
+  uint32_t janela; // Amostras por janela; 0: desligado
+  uint32_t n;
+  uint32_t t0_us, t1_us;
+  int16_t min[ESTAT_CANAIS];
+  int16_t max[ESTAT_CANAIS];
+  int64_t soma[ESTAT_CANAIS];
+  uint64_t quad[ESTAT_CANAIS];
+  estat_registro_t pronto; // Última janela fechada
+  bool tem_pronto;         // pronto ainda não foi gravado
+} estat_t;
+
+static estat_t estat;
+
+static void estat_iniciar(uint32_t janela)
+{
+  memset(&estat, 0, sizeof estat);
+  estat.janela = janela;
+}
+
+// Fecha a janela atual em estat.pronto.
+static void estat_fechar()
+{
+  estat_registro_t *r = &estat.pronto;
+  r->t0_us = estat.t0_us;
+  r->t1_us = estat.t1_us;
+  r->n = estat.n;
+  for (int c = 0; c < ESTAT_CANAIS; c++)
+  {
+    double media = (double)estat.soma[c] / estat.n;
+    double quad = (double)estat.quad[c] / estat.n;
+    double var = quad - media * media;
+    r->canal[c].min = estat.min[c];
+    r->canal[c].max = estat.max[c];
+    r->canal[c].media = (float)media;
+    r->canal[c].rms = (float)sqrt(quad);
+    r->canal[c].desvio = var > 0 ? (float)sqrt(var) : 0.0f;
+  }
+  estat.tem_pronto = true;
+  estat.n = 0;
+}
+
+static inline void estat_amostra(const amostra_t *a)
+{
+  for (int c = 0; c < ESTAT_CANAIS; c++)
+  {
+    int16_t v = c < 3 ? a->accel[c] : a->gyro[c - 3];
+    if (!estat.n)
+    {
+      estat.min[c] = estat.max[c] = v;
+      estat.soma[c] = 0;
+      estat.quad[c] = 0;
+    }
+    else if (v < estat.min[c])
+      estat.min[c] = v;
+    else if (v > estat.max[c])
+      estat.max[c] = v;
+    estat.soma[c] += v;
+    estat.quad[c] += (uint32_t)((int32_t)v * v);
+  }
+  if (!estat.n)
+    estat.t0_us = a->t_us;
+  estat.t1_us = a->t_us;
+  if (++estat.n == estat.janela)
+    estat_fechar();
+}
+
+/**
+ * Acumula n amostras. Com a janela de pelo menos AQ_BLOCO amostras, um bloco
+ * fecha no máximo uma janela: a aplicação grava estat.pronto depois de cada bloco.
+ */
+static void estat_bloco(const amostra_t *a, uint32_t n)
+{
+  if (!estat.janela)
+    return;
+  for (uint32_t i = 0; i < n; i++)
+    estat_amostra(&a[i]);
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef EVENTOS_H
+#define EVENTOS_H
+
+#include "pico/stdlib.h"
+#include "pico/critical_section.h"
+#include "hardware/sync.h"
+
+// Eventos que acordam o laço principal (um bit por fonte).
+#define EVT_USB_RX (1u << 0)  // Chegaram caracteres pela USB CDC
+#define EVT_BOTAO_A (1u << 1) // Botão A pressionado (GPIO 5)
+#define EVT_BOTAO_B (1u << 2) // Botão B pressionado (GPIO 6)
+#define EVT_AMOSTRA (1u << 3) // Bloco de amostras pronto para gravação
+#define EVT_CARTAO (1u << 4)  // Cartão inserido/removido ou hora de procurá-lo de novo
+
+static volatile uint32_t eventos_pendentes = 0;
+static critical_section_t eventos_cs; // Protege eventos_pendentes entre IRQs e os dois núcleos
+
+/**
+ * Sinaliza um ou mais eventos. Pode ser chamada de interrupções ou do outro núcleo.
+ */
+static inline void evt_post(uint32_t eventos)
+{
+  critical_section_enter_blocking(&eventos_cs);
+  eventos_pendentes |= eventos;
+  critical_section_exit(&eventos_cs);
+  __sev(); // Acorda o núcleo que estiver em __wfe()
+}
+
+/**
+ * Dorme (WFE) até que algum evento seja sinalizado e devolve todos os pendentes.
+ */
+static inline uint32_t evt_wait()
+{
+  while (true)
+  {
+    critical_section_enter_blocking(&eventos_cs);
+    uint32_t eventos = eventos_pendentes;
+    eventos_pendentes = 0;
+    critical_section_exit(&eventos_cs);
+
+    if (eventos)
+      return eventos;
+
+    // Um evento sinalizado entre a leitura acima e o WFE deixa o registrador
+    // de eventos ligado pelo __sev(), então o WFE retorna imediatamente.
+    __wfe();
+  }
+}
+
+// Chamada pelo stdio USB quando há caracteres disponíveis para leitura.
+static void evt_usb_rx_callback(void *param)
+{
+  evt_post(EVT_USB_RX);
+}
+
+void evt_init()
+{
+  critical_section_init(&eventos_cs);
+  stdio_set_chars_available_callback(evt_usb_rx_callback, NULL);
+  evt_post(EVT_USB_RX); // Processa o que já estiver no buffer da USB
+}
+
+#endif
@@ -65,6 +65,18 @@ DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
 #define ISDIO_WRITE			56	/* Write data to SD iSDIO register */
 #define ISDIO_MRITE			57	/* Masked write data to SD iSDIO register */
 
+/* Volume location remembered by the driver (needed at FF_USE_MOUNT_HINT == 1) */
+#define GET_MOUNT_HINT		30	/* Get where the volume was found last time (MOUNT_HINT) */
+#define SET_MOUNT_HINT		31	/* Remember where the volume was found (MOUNT_HINT) */
+
+typedef struct {
+	LBA_t	sect;		/* Volume boot record */
+	DWORD	vsn;		/* Volume serial number found there */
+} MOUNT_HINT;
+
+/* Erase that leaves zeros (needed at FM_ERASE in f_mkfs) */
+#define CTRL_ERASE_ZEROS	32	/* Erase a block of sectors (LBA_t[2]: first, last) so that they read as zeros. RES_PARERR if the device cannot */
+
 /* ATA/CF specific ioctl command */
 #define ATA_GET_REV			20	/* Get F/W revision */
 #define ATA_GET_MODEL		21	/* Get model name */
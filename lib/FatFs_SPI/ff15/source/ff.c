@@ -22,6 +22,25 @@
 #include <string.h>
 #include "ff.h"			/* Declarations of FatFs API */
 #include "diskio.h"		/* Declarations of device I/O functions */
+#if FF_USE_IO_STATS
+#include "io_stats.h"	/* I/O counters */
+#define IO_STAT(field)			(++io_stats.field)
+#define IO_STAT_ADD(field, n)	(io_stats.field += (n))
+#else
+#define IO_STAT(field)			((void)0)
+#define IO_STAT_ADD(field, n)	((void)0)
+#endif
+#if FF_USE_TRACE
+#include "sd_trace.h"	/* Event tracer */
+/* Traced API functions shadow this with their own event code, which
+/  LEAVE_FF() then records as the end of the call. */
+static const uint8_t ff_trace_ev = SD_TR_COUNT;
+#define FF_TRACE_ENTER(ev)	const uint8_t ff_trace_ev = (ev); sd_trace_begin((ev), 0)
+#define FF_TRACE_LEAVE(res)	if (ff_trace_ev != SD_TR_COUNT) sd_trace_end(ff_trace_ev, (res))
+#else
+#define FF_TRACE_ENTER(ev)
+#define FF_TRACE_LEAVE(res)
+#endif
 
 
 /*--------------------------------------------------------------------------
@@ -239,9 +258,9 @@
 #if FF_USE_LFN == 1
 #error Static LFN work area cannot be used in thread-safe configuration
 #endif
-#define LEAVE_FF(fs, res)	{ unlock_volume(fs, res); return res; }
+#define LEAVE_FF(fs, res)	{ FF_TRACE_LEAVE(res); unlock_volume(fs, res); return res; }
 #else
-#define LEAVE_FF(fs, res)	return res
+#define LEAVE_FF(fs, res)	{ FF_TRACE_LEAVE(res); return res; }
 #endif
 
 
@@ -475,6 +494,38 @@ static BYTE SysLock;				/* System lock flag (0:no mutex, 1:unlocked, 2:locked) *
 #endif
 #endif
 
+#if FF_USE_MOUNT_HINT
+#if FF_FS_REENTRANT && FF_FS_LOCK == 0	/* mount_volume() holds only the volume lock: one buffer per volume */
+static BYTE HintBuf[FF_VOLUMES][2 * FF_MAX_SS];	/* VBR and FSInfo of a hinted mount */
+#define HINTBUF(vol)	HintBuf[vol]
+#else									/* Mounts are serialized by the system lock (or there is one task) */
+static BYTE HintBuf[2 * FF_MAX_SS];
+#define HINTBUF(vol)	HintBuf
+#endif
+#endif
+
+#if FF_USE_DIR_INDEX
+#if !FF_USE_LFN
+#error FF_USE_DIR_INDEX needs FF_USE_LFN
+#endif
+#if FF_DIR_INDEX_SLOTS < 64 || (FF_DIR_INDEX_SLOTS & (FF_DIR_INDEX_SLOTS - 1))
+#error Wrong FF_DIR_INDEX_SLOTS setting
+#endif
+#if FF_DIR_INDEX_VOLUMES < 1 || FF_DIR_INDEX_VOLUMES > FF_VOLUMES
+#error Wrong FF_DIR_INDEX_VOLUMES setting
+#endif
+typedef struct {
+	WORD	id;				/* Mount ID of the volume when the index was built (0:no index) */
+	BYTE	complete;		/* 1:every name of the directory is in the table, so a miss is final */
+	DWORD	clust;			/* Start cluster of the indexed directory */
+	UINT	used;			/* Slots taken, removed names included */
+	UINT	removed;		/* Slots of removed names */
+	WORD	tag[FF_DIR_INDEX_SLOTS];	/* Upper half of the name hash (0:empty, DIX_REMOVED:removed name) */
+	WORD	ent[FF_DIR_INDEX_SLOTS];	/* Index of the first directory entry of the object */
+} DIRIDX;
+static DIRIDX DirIdx[FF_DIR_INDEX_VOLUMES];	/* Name index of one large directory per indexed volume */
+#endif
+
 #if FF_STR_VOLUME_ID
 #ifdef FF_VOLUME_STRS
 static const char *const VolumeStr[FF_VOLUMES] = {FF_VOLUME_STRS};	/* Pre-defined volume ID */
@@ -2377,6 +2428,459 @@ static FRESULT dir_read (
 
 
 
+#if FF_FS_EXFAT
+static int xdir_cmp_name (	/* 1:the name in the entry block matches the one to find */
+	FATFS* fs				/* Filesystem with the entry block in dirbuf[] and the name in lfnbuf[] */
+)
+{
+	BYTE nc;
+	UINT di, ni;
+
+
+	for (nc = fs->dirbuf[XDIR_NumName], di = SZDIRE * 2, ni = 0; nc; nc--, di += 2, ni++) {	/* Compare the name */
+		if ((di % SZDIRE) == 0) di += 2;
+		if (ff_wtoupper(ld_word(fs->dirbuf + di)) != ff_wtoupper(fs->lfnbuf[ni])) break;
+	}
+	return nc == 0 && !fs->lfnbuf[ni];
+}
+#endif
+
+
+
+#if FF_USE_DIR_INDEX
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Name index of a large directory                  */
+/*-----------------------------------------------------------------------*/
+/* The table maps the hash of each name (LFN and SFN) to the first entry of
+/  the object's entry block. A hit is confirmed by reading that block, so a
+/  stale or colliding slot costs one more block, never a wrong answer. */
+
+#define DIX_MUL		0x01000193	/* Multiplier of the name hash */
+#define DIX_REMOVED	0xFFFF		/* Tag of a slot whose name was removed */
+#define DIX_MIN_ENT	64			/* Entries a lookup has to scan before its directory gets indexed */
+
+/* The hash of a name is the sum of (up-cased character + 1) * DIX_MUL^position,
+/  so the terms can be added in any order: LFN entries come last part first. */
+
+static DWORD dix_pow (		/* DIX_MUL to the power n */
+	UINT n
+)
+{
+	DWORD r = 1, b = DIX_MUL;
+
+
+	for ( ; n; n >>= 1, b *= b) {
+		if (n & 1) r *= b;
+	}
+	return r;
+}
+
+
+static DWORD dix_mix (		/* Key of a name from its hash and length */
+	DWORD h,
+	UINT len
+)
+{
+	h += len * 0x9E3779B9;
+	h ^= h >> 16; h *= 0x85EBCA6B;
+	h ^= h >> 13; h *= 0xC2B2AE35;
+	h ^= h >> 16;
+	return h;
+}
+
+
+static DWORD dix_name_key (	/* Key of a file name */
+	const WCHAR* name
+)
+{
+	DWORD h = 0, m = 1;
+	UINT i;
+
+
+	for (i = 0; name[i]; i++, m *= DIX_MUL) h += (ff_wtoupper(name[i]) + 1) * m;
+	return dix_mix(h, i);
+}
+
+
+static int dix_sfn_key (	/* 1:got the key of the SFN as get_fileinfo() shows it, 0:not ASCII */
+	const BYTE* sfn,		/* SFN in directory form */
+	DWORD* key
+)
+{
+	DWORD h = 0, m = 1;
+	UINT i, n = 0;
+	BYTE c;
+
+
+	for (i = 0; i < 11; i++) {
+		c = sfn[i];
+		if (c == ' ') continue;
+		if (c >= 0x80 || c == RDDEM) return 0;
+		if (i == 8) {				/* Extension follows */
+			h += ('.' + 1) * m; m *= DIX_MUL; n++;
+		}
+		h += (ff_wtoupper(c) + 1) * m; m *= DIX_MUL; n++;
+	}
+	*key = dix_mix(h, n);
+	return 1;
+}
+
+
+static UINT dix_lfn_len (	/* Length of the LFN from its last entry */
+	const BYTE* dir,
+	UINT ord				/* Order of the entry (1-) */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < 13 && ld_word(dir + LfnOfs[i]); i++) ;
+	return (ord - 1) * 13 + i;
+}
+
+
+static DWORD dix_lfn_part (	/* Hash terms of the characters in an LFN entry */
+	const BYTE* dir,
+	UINT ord,				/* Order of the entry (1-) */
+	UINT len				/* Length of the LFN */
+)
+{
+	DWORD h = 0, m;
+	UINT i, pos = (ord - 1) * 13;
+
+
+	for (m = dix_pow(pos), i = 0; i < 13 && pos < len; i++, pos++, m *= DIX_MUL) {
+		h += (ff_wtoupper(ld_word(dir + LfnOfs[i])) + 1) * m;
+	}
+	return h;
+}
+
+
+#if FF_FS_EXFAT
+static DWORD dix_xdir_key (	/* Key of the name in an exFAT entry block */
+	const BYTE* dirb
+)
+{
+	DWORD h = 0, m = 1;
+	UINT i, di, nc = dirb[XDIR_NumName];
+
+
+	for (i = 0, di = SZDIRE * 2; i < nc; i++, di += 2, m *= DIX_MUL) {
+		if ((di % SZDIRE) == 0) di += 2;
+		h += (ff_wtoupper(ld_word(dirb + di)) + 1) * m;
+	}
+	return dix_mix(h, nc);
+}
+#endif
+
+
+static DWORD dix_clust (	/* Start cluster that identifies the directory */
+	DIR* dp
+)
+{
+	FATFS *fs = dp->obj.fs;
+
+
+	return (dp->obj.sclust == 0 && fs->fs_type >= FS_FAT32) ? (DWORD)fs->dirbase : dp->obj.sclust;
+}
+
+
+static DIRIDX* dix_volume (	/* Index belonging to the volume (null:not an indexed volume) */
+	FATFS* fs
+)
+{
+	UINT vol;
+
+
+	for (vol = 0; vol < FF_DIR_INDEX_VOLUMES && FatFs[vol] != fs; vol++) ;
+	return vol < FF_DIR_INDEX_VOLUMES ? &DirIdx[vol] : 0;
+}
+
+
+static DIRIDX* dix_get (	/* Index of the directory (null:not indexed) */
+	DIR* dp
+)
+{
+	DIRIDX *ix = dix_volume(dp->obj.fs);
+
+
+	if (!ix || !ix->id || ix->id != dp->obj.fs->id || ix->clust != dix_clust(dp)) return 0;
+	return ix;
+}
+
+
+static WORD dix_tag (DWORD key)
+{
+	WORD tag = (WORD)(key >> 16);
+
+
+	return (tag == 0 || tag == DIX_REMOVED) ? 1 : tag;
+}
+
+
+static void dix_add (
+	DIRIDX* ix,
+	DWORD key,				/* Key of the name */
+	DWORD ofs				/* Offset of the entry block in the directory */
+)
+{
+	WORD tag = dix_tag(key);
+	UINT i;
+
+
+	if (ofs / SZDIRE > 0xFFFF) {		/* Beyond what a slot can point to */
+		ix->complete = 0; return;
+	}
+	if (ix->used >= FF_DIR_INDEX_SLOTS / 4 * 3) {	/* Table full? */
+		if (ix->removed) {
+			ix->id = 0;					/* Drop it: the next large scan builds it without the removed names */
+		} else {
+			ix->complete = 0;			/* Keep it for the names it has */
+		}
+		return;
+	}
+	for (i = key & (FF_DIR_INDEX_SLOTS - 1); ix->tag[i]; i = (i + 1) & (FF_DIR_INDEX_SLOTS - 1)) {
+		if (ix->tag[i] == tag && ix->ent[i] == ofs / SZDIRE) return;	/* Already there */
+	}
+	ix->tag[i] = tag; ix->ent[i] = (WORD)(ofs / SZDIRE);
+	ix->used++;
+}
+
+
+static FRESULT dix_build (	/* FR_OK:indexed, others:disk error (no index) */
+	DIR* dp,				/* Directory object, moved through the whole directory */
+	DIRIDX* ix
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	DWORD key = 0, blk = 0;
+	UINT len = 0;
+	BYTE c, a, ord = 0xFF, sum = 0xFF;
+
+
+	memset(ix->tag, 0, sizeof ix->tag);
+	ix->id = 0; ix->clust = dix_clust(dp);
+	ix->used = ix->removed = 0; ix->complete = 1;
+	res = dir_sdi(dp, 0);
+#if FF_FS_EXFAT
+	if (res == FR_OK && fs->fs_type == FS_EXFAT) {	/* On the exFAT volume */
+		while ((res = DIR_READ_FILE(dp)) == FR_OK) {
+#if FF_MAX_LFN < 255
+			if (fs->dirbuf[XDIR_NumName] > FF_MAX_LFN) continue;	/* Inaccessible by name */
+#endif
+			dix_add(ix, dix_xdir_key(fs->dirbuf), dp->blk_ofs);
+		}
+	} else
+#endif
+	while (res == FR_OK) {		/* On the FAT/FAT32 volume, the same walk as dir_find() */
+		res = move_window(fs, dp->sect);
+		if (res != FR_OK) break;
+		c = dp->dir[DIR_Name];
+		if (c == 0) { res = FR_NO_FILE; break; }	/* Reached to end of table */
+		a = dp->dir[DIR_Attr] & AM_MASK;
+		if (c == DDEM || ((a & AM_VOL) && a != AM_LFN)) {	/* An entry without valid data */
+			ord = 0xFF;
+		} else if (a == AM_LFN) {	/* An LFN entry is found */
+			if (c & LLEF) {			/* Start of LFN sequence */
+				sum = dp->dir[LDIR_Chksum];
+				c &= (BYTE)~LLEF; ord = c;
+				blk = dp->dptr; key = 0;
+				len = dix_lfn_len(dp->dir, c);
+			}
+			if (c == ord && c >= 1 && sum == dp->dir[LDIR_Chksum]) {
+				key += dix_lfn_part(dp->dir, c, len);
+				ord--;
+			} else {
+				ord = 0xFF;
+			}
+		} else {					/* An SFN entry is found */
+			if (ord == 0 && sum == sum_sfn(dp->dir)) {	/* With a valid LFN? */
+				dix_add(ix, dix_mix(key, len), blk);
+			} else {
+				blk = dp->dptr;
+			}
+			if (dix_sfn_key(dp->dir, &key)) {
+				dix_add(ix, key, blk);
+			} else {
+				ix->complete = 0;	/* An SFN with extended characters cannot be keyed */
+			}
+			ord = 0xFF;
+		}
+		res = dir_next(dp, 0);
+	}
+	if (res != FR_NO_FILE) return res;
+	ix->id = fs->id;
+	IO_STAT(f_dir_index_builds);
+	return FR_OK;
+}
+
+
+static FRESULT dir_match (	/* FR_OK:the entry block holds the name, FR_NO_FILE:it does not, others:error */
+	DIR* dp,				/* Directory object with the file name; left as dir_find() leaves it */
+	DWORD ofs				/* Offset of the entry block */
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	BYTE c, a, ord = 0xFF, sum = 0xFF;
+
+
+	res = dir_sdi(dp, ofs);
+	if (res != FR_OK) return res;
+	res = move_window(fs, dp->sect);
+	if (res != FR_OK) return res;
+#if FF_FS_EXFAT
+	if (fs->fs_type == FS_EXFAT) {	/* On the exFAT volume */
+		if (dp->dir[XDIR_Type] != ET_FILEDIR) return FR_NO_FILE;	/* Not the start of a block any more */
+		dp->blk_ofs = dp->dptr;
+		res = load_xdir(dp);
+		if (res != FR_OK) return res;
+		dp->obj.attr = fs->dirbuf[XDIR_Attr] & AM_MASK;
+#if FF_MAX_LFN < 255
+		if (fs->dirbuf[XDIR_NumName] > FF_MAX_LFN) return FR_NO_FILE;
+#endif
+		return xdir_cmp_name(fs) ? FR_OK : FR_NO_FILE;
+	}
+#endif
+	/* On the FAT/FAT32 volume */
+	dp->blk_ofs = 0xFFFFFFFF;
+	if ((dp->dir[DIR_Attr] & AM_MASK) == AM_LFN && !(dp->dir[LDIR_Ord] & LLEF)) return FR_NO_FILE;	/* Middle of an LFN */
+	for (;;) {
+		c = dp->dir[DIR_Name];
+		dp->obj.attr = a = dp->dir[DIR_Attr] & AM_MASK;
+		if (c == 0 || c == DDEM || ((a & AM_VOL) && a != AM_LFN)) return FR_NO_FILE;	/* Not an object (any more) */
+		if (a != AM_LFN) break;		/* The SFN entry ends the block */
+		if (!(dp->fn[NSFLAG] & NS_NOLFN)) {
+			if (c & LLEF) {			/* Start of LFN sequence */
+				sum = dp->dir[LDIR_Chksum];
+				c &= (BYTE)~LLEF; ord = c;
+				dp->blk_ofs = dp->dptr;
+			}
+			ord = (c == ord && sum == dp->dir[LDIR_Chksum] && cmp_lfn(fs->lfnbuf, dp->dir)) ? ord - 1 : 0xFF;
+		}
+		res = dir_next(dp, 0);
+		if (res == FR_OK) res = move_window(fs, dp->sect);
+		if (res != FR_OK) return res;
+	}
+	if (ord == 0 && sum == sum_sfn(dp->dir)) return FR_OK;	/* LFN matched? */
+	if (!(dp->fn[NSFLAG] & NS_LOSS) && !memcmp(dp->dir, dp->fn, 11)) return FR_OK;	/* SFN matched? */
+	return FR_NO_FILE;
+}
+
+
+static int dix_lookup (		/* 1:*res is the result of dir_find(), 0:the directory needs to be scanned */
+	DIR* dp,				/* Directory object with the file name */
+	DIRIDX* ix,
+	FRESULT* res
+)
+{
+	DWORD key;
+	WORD tag;
+	UINT i;
+
+
+	if (dp->fn[NSFLAG] & NS_NOLFN) {	/* SFN collision check of dir_register() */
+		if (!dix_sfn_key(dp->fn, &key)) return 0;
+	} else {
+		key = dix_name_key(dp->obj.fs->lfnbuf);
+	}
+	tag = dix_tag(key);
+
+	for (i = key & (FF_DIR_INDEX_SLOTS - 1); ix->tag[i]; i = (i + 1) & (FF_DIR_INDEX_SLOTS - 1)) {
+		if (ix->tag[i] != tag) continue;
+		*res = dir_match(dp, (DWORD)ix->ent[i] * SZDIRE);
+		if (*res == FR_OK) IO_STAT(f_dir_index_hits);
+		if (*res != FR_NO_FILE) return 1;
+	}
+	if (!ix->complete) {
+		IO_STAT(f_dir_index_scans);
+		return 0;
+	}
+	IO_STAT(f_dir_index_absent);
+	dp->sect = 0;				/* As at the end of a scan */
+	*res = FR_NO_FILE;
+	return 1;
+}
+
+
+static FRESULT dix_scanned (	/* Index the directory after a long scan by dir_find(); returns its result */
+	DIR* dp,				/* Directory object as the scan left it */
+	FRESULT res				/* Result of the scan */
+)
+{
+	DWORD blk = (dp->blk_ofs != 0xFFFFFFFF) ? dp->blk_ofs : dp->dptr;	/* Entry block found */
+	DIRIDX *ix = dix_volume(dp->obj.fs);
+	DIR dj = *dp;
+
+
+	if (!ix || (res != FR_OK && res != FR_NO_FILE)) return res;
+	dix_build(&dj, ix);			/* On a disk error the directory is left without index */
+	if (res == FR_OK) {
+		res = dir_match(dp, blk);	/* The build moved the window and dirbuf[]: load the object again */
+		if (res == FR_NO_FILE) res = FR_INT_ERR;	/* It cannot be */
+	}
+	return res;
+}
+
+
+#if !FF_FS_READONLY
+static void dix_register (	/* Add the object just registered to the index of its directory */
+	DIR* dp,
+	DWORD blk,				/* Offset of its entry block */
+	int lfn					/* 1:it has an LFN */
+)
+{
+	DIRIDX *ix = dix_get(dp);
+	DWORD key;
+
+
+	if (!ix) return;
+	if (lfn) dix_add(ix, dix_name_key(dp->obj.fs->lfnbuf), blk);
+	if (dp->obj.fs->fs_type != FS_EXFAT) {
+		if (dix_sfn_key(dp->fn, &key)) {
+			dix_add(ix, key, blk);
+		} else {
+			ix->complete = 0;
+		}
+	}
+}
+
+
+static void dix_remove (	/* Drop the names of an object from the index of its directory */
+	DIR* dp,
+	DWORD blk				/* Offset of its entry block */
+)
+{
+	DIRIDX *ix = dix_get(dp);
+	UINT i;
+
+
+	if (!ix || blk / SZDIRE > 0xFFFF) return;
+	for (i = 0; i < FF_DIR_INDEX_SLOTS; i++) {
+		if (ix->tag[i] && ix->tag[i] != DIX_REMOVED && ix->ent[i] == blk / SZDIRE) {
+			ix->tag[i] = DIX_REMOVED;	/* Keeps the probe chains through the slot intact */
+			ix->removed++;
+		}
+	}
+}
+
+
+static void dix_forget (	/* Drop the index of a directory whose cluster gets reused */
+	FATFS* fs,
+	DWORD clust
+)
+{
+	DIRIDX *ix = dix_volume(fs);
+
+
+	if (ix && ix->clust == clust) ix->id = 0;
+}
+#endif
+#endif	/* FF_USE_DIR_INDEX */
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Directory handling - Find an object in the directory                  */
 /*-----------------------------------------------------------------------*/
@@ -2391,26 +2895,36 @@ static FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 #if FF_USE_LFN
 	BYTE a, ord, sum;
 #endif
+#if FF_USE_DIR_INDEX
+	DIRIDX *ix = 0;
+	UINT n_ent = 0;
+	int use_ix = !(dp->fn[NSFLAG] & NS_DOT);	/* Dot names are not indexed */
+
+	if (use_ix) {
+		ix = dix_get(dp);
+		if (ix && dix_lookup(dp, ix, &res)) return res;	/* Answered by the index? */
+	}
+#endif
 
 	res = dir_sdi(dp, 0);			/* Rewind directory object */
 	if (res != FR_OK) return res;
 #if FF_FS_EXFAT
 	if (fs->fs_type == FS_EXFAT) {	/* On the exFAT volume */
-		BYTE nc;
-		UINT di, ni;
 		WORD hash = xname_sum(fs->lfnbuf);		/* Hash value of the name to find */
 
 		while ((res = DIR_READ_FILE(dp)) == FR_OK) {	/* Read an item */
+#if FF_USE_DIR_INDEX
+			n_ent++;
+#endif
 #if FF_MAX_LFN < 255
 			if (fs->dirbuf[XDIR_NumName] > FF_MAX_LFN) continue;		/* Skip comparison if inaccessible object name */
 #endif
 			if (ld_word(fs->dirbuf + XDIR_NameHash) != hash) continue;	/* Skip comparison if hash mismatched */
-			for (nc = fs->dirbuf[XDIR_NumName], di = SZDIRE * 2, ni = 0; nc; nc--, di += 2, ni++) {	/* Compare the name */
-				if ((di % SZDIRE) == 0) di += 2;
-				if (ff_wtoupper(ld_word(fs->dirbuf + di)) != ff_wtoupper(fs->lfnbuf[ni])) break;
-			}
-			if (nc == 0 && !fs->lfnbuf[ni]) break;	/* Name matched? */
+			if (xdir_cmp_name(fs)) break;	/* Name matched? */
 		}
+#if FF_USE_DIR_INDEX
+		if (use_ix && !ix && n_ent >= DIX_MIN_ENT) res = dix_scanned(dp, res);
+#endif
 		return res;
 	}
 #endif
@@ -2423,6 +2937,9 @@ static FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 		if (res != FR_OK) break;
 		c = dp->dir[DIR_Name];
 		if (c == 0) { res = FR_NO_FILE; break; }	/* Reached to end of table */
+#if FF_USE_DIR_INDEX
+		n_ent++;
+#endif
 #if FF_USE_LFN		/* LFN configuration */
 		dp->obj.attr = a = dp->dir[DIR_Attr] & AM_MASK;
 		if (c == DDEM || ((a & AM_VOL) && a != AM_LFN)) {	/* An entry without valid data */
@@ -2451,6 +2968,9 @@ static FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 		res = dir_next(dp, 0);	/* Next entry */
 	} while (res == FR_OK);
 
+#if FF_USE_DIR_INDEX
+	if (use_ix && !ix && n_ent >= DIX_MIN_ENT) res = dix_scanned(dp, res);
+#endif
 	return res;
 }
 
@@ -2504,6 +3024,9 @@ static FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too
 		}
 
 		create_xdir(fs->dirbuf, fs->lfnbuf);	/* Create on-memory directory block to be written later */
+#if FF_USE_DIR_INDEX
+		dix_register(dp, dp->blk_ofs, 1);
+#endif
 		return FR_OK;
 	}
 #endif
@@ -2553,6 +3076,10 @@ static FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too
 			dp->dir[DIR_NTres] = dp->fn[NSFLAG] & (NS_BODY | NS_EXT);	/* Put NT flag */
 #endif
 			fs->wflag = 1;
+#if FF_USE_DIR_INDEX
+			n_ent = (sn[NSFLAG] & NS_LFN) ? (len + 12) / 13 : 0;	/* LFN entries in front of the SFN */
+			dix_register(dp, dp->dptr - n_ent * SZDIRE, n_ent != 0);
+#endif
 		}
 	}
 
@@ -2577,6 +3104,9 @@ static FRESULT dir_remove (	/* FR_OK:Succeeded, FR_DISK_ERR:A disk error */
 #if FF_USE_LFN		/* LFN configuration */
 	DWORD last = dp->dptr;
 
+#if FF_USE_DIR_INDEX
+	dix_remove(dp, (dp->blk_ofs == 0xFFFFFFFF) ? dp->dptr : dp->blk_ofs);
+#endif
 	res = (dp->blk_ofs == 0xFFFFFFFF) ? FR_OK : dir_sdi(dp, dp->blk_ofs);	/* Goto top of the entry block if LFN is exist */
 	if (res == FR_OK) {
 		do {
@@ -3286,19 +3816,16 @@ static DWORD make_rand (
 /* Load a sector and check if it is an FAT VBR                           */
 /*-----------------------------------------------------------------------*/
 
-/* Check what the sector is */
+/* Check what the sector in the window is */
 
-static UINT check_fs (	/* 0:FAT/FAT32 VBR, 1:exFAT VBR, 2:Not FAT and valid BS, 3:Not FAT and invalid BS, 4:Disk error */
-	FATFS* fs,			/* Filesystem object */
-	LBA_t sect			/* Sector to load and check if it is an FAT-VBR or not */
+static UINT check_vbr (	/* 0:FAT/FAT32 VBR, 1:exFAT VBR, 2:Not FAT and valid BS, 3:Not FAT and invalid BS */
+	FATFS* fs			/* Filesystem object */
 )
 {
 	WORD w, sign;
 	BYTE b;
 
 
-	fs->wflag = 0; fs->winsect = (LBA_t)0 - 1;		/* Invaidate window */
-	if (move_window(fs, sect) != FR_OK) return 4;	/* Load the boot sector */
 	sign = ld_word(fs->win + BS_55AA);
 #if FF_FS_EXFAT
 	if (sign == 0xAA55 && !memcmp(fs->win + BS_JmpBoot, "\xEB\x76\x90" "EXFAT   ", 11)) return 1;	/* It is an exFAT VBR */
@@ -3325,6 +3852,60 @@ static UINT check_fs (	/* 0:FAT/FAT32 VBR, 1:exFAT VBR, 2:Not FAT and valid BS,
 }
 
 
+/* Check what the sector is */
+
+static UINT check_fs (	/* 0:FAT/FAT32 VBR, 1:exFAT VBR, 2:Not FAT and valid BS, 3:Not FAT and invalid BS, 4:Disk error */
+	FATFS* fs,			/* Filesystem object */
+	LBA_t sect			/* Sector to load and check if it is an FAT-VBR or not */
+)
+{
+	fs->wflag = 0; fs->winsect = (LBA_t)0 - 1;		/* Invaidate window */
+	if (move_window(fs, sect) != FR_OK) return 4;	/* Load the boot sector */
+	return check_vbr(fs);
+}
+
+
+#if FF_USE_MOUNT_HINT
+/* Volume serial number in the FAT VBR (or exFAT VBR if fmt == 1) in the window */
+
+static DWORD vbr_vsn (
+	FATFS* fs,			/* Filesystem object */
+	UINT fmt			/* Result of check_vbr() */
+)
+{
+	if (fmt == 1) return ld_dword(fs->win + BPB_VolIDEx);
+	return ld_dword(fs->win + (ld_word(fs->win + BPB_FATSz16) == 0 ? BS_VolID32 : BS_VolID));
+}
+
+
+/* Try the volume location remembered by the disk driver */
+
+static UINT check_hint (	/* 0:FAT/FAT32 VBR, 1:exFAT VBR, 3:No hint or a stale one */
+	FATFS* fs,			/* Filesystem object */
+	UINT part,			/* Partition to find (see find_volume) */
+	BYTE* buf			/* 2 sectors: VBR and the next one (FSInfo on FAT32) */
+)
+{
+	MOUNT_HINT hint;
+	UINT fmt;
+
+
+	if (part != 0) return 3;	/* Only for auto scan */
+	if (disk_ioctl(fs->pdrv, GET_MOUNT_HINT, &hint) != RES_OK) return 3;
+	if (disk_read(fs->pdrv, buf, hint.sect, 2) != RES_OK) return 3;
+	memcpy(fs->win, buf, SS(fs));
+	fs->wflag = 0; fs->winsect = hint.sect;
+	fmt = check_vbr(fs);
+	if (fmt <= 1 && vbr_vsn(fs, fmt) == hint.vsn) {
+		IO_STAT(f_mount_hint_hits);
+		return fmt;
+	}
+	IO_STAT(f_mount_hint_misses);	/* Reformatted or repartitioned since */
+	return 3;
+}
+#endif
+
+
 /* Find an FAT volume */
 /* (It supports only generic partitioning rules, MBR, GPT and SFD) */
 
@@ -3395,6 +3976,10 @@ static FRESULT mount_volume (	/* FR_OK(0): successful, !=0: an error occurred */
 	DWORD tsect, sysect, fasize, nclst, szbfat;
 	WORD nrsv;
 	UINT fmt;
+#if FF_USE_MOUNT_HINT
+	MOUNT_HINT hint;
+	UINT hinted;
+#endif
 
 
 	/* Get logical drive number */
@@ -3438,10 +4023,20 @@ static FRESULT mount_volume (	/* FR_OK(0): successful, !=0: an error occurred */
 #endif
 
 	/* Find an FAT volume on the hosting drive */
+#if FF_USE_MOUNT_HINT
+	fmt = check_hint(fs, LD2PT(vol), HINTBUF(vol));
+	hinted = (fmt <= 1);
+	if (!hinted) fmt = find_volume(fs, LD2PT(vol));
+#else
 	fmt = find_volume(fs, LD2PT(vol));
+#endif
 	if (fmt == 4) return FR_DISK_ERR;		/* An error occurred in the disk I/O layer */
 	if (fmt >= 2) return FR_NO_FILESYSTEM;	/* No FAT volume is found */
 	bsect = fs->winsect;					/* Volume offset in the hosting physical drive */
+#if FF_USE_MOUNT_HINT
+	hint.sect = bsect;
+	hint.vsn = vbr_vsn(fs, fmt);
+#endif
 
 	/* An FAT volume is found (bsect). Following code initializes the filesystem object */
 
@@ -3564,6 +4159,12 @@ static FRESULT mount_volume (	/* FR_OK(0): successful, !=0: an error occurred */
 		/* Get FSInfo if available */
 		fs->last_clst = fs->free_clst = 0xFFFFFFFF;		/* Initialize cluster allocation information */
 		fs->fsi_flag = 0x80;
+#if FF_USE_MOUNT_HINT
+		if (hinted) {	/* FSInfo came with the VBR: make it the window, so move_window() needs no read */
+			memcpy(fs->win, HINTBUF(vol) + SS(fs), SS(fs));
+			fs->winsect = bsect + 1;
+		}
+#endif
 #if (FF_FS_NOFSINFO & 3) != 3
 		if (fmt == FS_FAT32				/* Allow to update FSInfo only if BPB_FSInfo32 == 1 */
 			&& ld_word(fs->win + BPB_FSInfo32) == 1
@@ -3599,6 +4200,9 @@ static FRESULT mount_volume (	/* FR_OK(0): successful, !=0: an error occurred */
 #endif
 #if FF_FS_LOCK				/* Clear file lock semaphores */
 	clear_share(fs);
+#endif
+#if FF_USE_MOUNT_HINT
+	if (!hinted) disk_ioctl(fs->pdrv, SET_MOUNT_HINT, &hint);	/* Found the long way: remember it */
 #endif
 	return FR_OK;
 }
@@ -3732,6 +4336,7 @@ FRESULT f_open (
 
 
 	if (!fp) return FR_INVALID_OBJECT;
+	FF_TRACE_ENTER(SD_TR_FF_OPEN);
 
 	/* Get logical drive number */
 	mode &= FF_FS_READONLY ? FA_READ : FA_READ | FA_WRITE | FA_CREATE_ALWAYS | FA_CREATE_NEW | FA_OPEN_ALWAYS | FA_OPEN_APPEND;
@@ -3927,6 +4532,7 @@ FRESULT f_read (
 	BYTE *rbuff = (BYTE*)buff;
 
 
+	FF_TRACE_ENTER(SD_TR_FF_READ);
 	*br = 0;	/* Clear read byte counter */
 	res = validate(&fp->obj, &fs);				/* Check validity of the file object */
 	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
@@ -4026,7 +4632,9 @@ FRESULT f_write (
 	const BYTE *wbuff = (const BYTE*)buff;
 
 
+	FF_TRACE_ENTER(SD_TR_FF_WRITE);
 	*bw = 0;	/* Clear write byte counter */
+	IO_STAT(f_write_calls);
 	res = validate(&fp->obj, &fs);			/* Check validity of the file object */
 	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
 	if (!(fp->flag & FA_WRITE)) LEAVE_FF(fs, FR_DENIED);	/* Check access mode */
@@ -4040,6 +4648,7 @@ FRESULT f_write (
 		if (fp->fptr % SS(fs) == 0) {		/* On the sector boundary? */
 			csect = (UINT)(fp->fptr / SS(fs)) & (fs->csize - 1);	/* Sector offset in the cluster */
 			if (csect == 0) {				/* On the cluster boundary? */
+				IO_STAT(f_write_cluster);
 				if (fp->fptr == 0) {		/* On the top of the file? */
 					clst = fp->obj.sclust;	/* Follow from the origin */
 					if (clst == 0) {		/* If no cluster is allocated, */
@@ -4065,6 +4674,7 @@ FRESULT f_write (
 			if (fs->winsect == fp->sect && sync_window(fs) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Write-back sector cache */
 #else
 			if (fp->flag & FA_DIRTY) {		/* Write-back sector cache */
+				IO_STAT(f_write_flush);
 				if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
 				fp->flag &= (BYTE)~FA_DIRTY;
 			}
@@ -4077,6 +4687,8 @@ FRESULT f_write (
 				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
 					cc = fs->csize - csect;
 				}
+				IO_STAT(f_write_direct);
+				IO_STAT_ADD(f_write_direct_sect, cc);
 				if (disk_write(fs->pdrv, wbuff, sect, cc) != RES_OK) ABORT(fs, FR_DISK_ERR);
 #if FF_FS_MINIMIZE <= 2
 #if FF_FS_TINY
@@ -4102,7 +4714,7 @@ FRESULT f_write (
 #else
 			if (fp->sect != sect && 		/* Fill sector cache with file data */
 				fp->fptr < fp->obj.objsize &&
-				disk_read(fs->pdrv, fp->buf, sect, 1) != RES_OK) {
+				(IO_STAT(f_write_fill), disk_read(fs->pdrv, fp->buf, sect, 1)) != RES_OK) {
 					ABORT(fs, FR_DISK_ERR);
 			}
 #endif
@@ -4118,6 +4730,7 @@ FRESULT f_write (
 		memcpy(fp->buf + fp->fptr % SS(fs), wbuff, wcnt);	/* Fit data to the sector */
 		fp->flag |= FA_DIRTY;
 #endif
+		IO_STAT(f_write_partial);
 	}
 
 	fp->flag |= FA_MODIFIED;				/* Set file change flag */
@@ -4142,6 +4755,8 @@ FRESULT f_sync (
 	BYTE *dir;
 
 
+	FF_TRACE_ENTER(SD_TR_FF_SYNC);
+	IO_STAT(f_sync_calls);
 	res = validate(&fp->obj, &fs);	/* Check validity of the file object */
 	if (res == FR_OK) {
 		if (fp->flag & FA_MODIFIED) {	/* Is there any change to the file? */
@@ -4220,6 +4835,8 @@ FRESULT f_close (
 	FRESULT res;
 	FATFS *fs;
 
+	FF_TRACE_ENTER(SD_TR_FF_CLOSE);
+
 #if !FF_FS_READONLY
 	res = f_sync(fp);					/* Flush cached data */
 	if (res == FR_OK)
@@ -4238,6 +4855,7 @@ FRESULT f_close (
 #endif
 		}
 	}
+	FF_TRACE_LEAVE(res);
 	return res;
 }
 
@@ -4446,6 +5064,7 @@ FRESULT f_lseek (
 	LBA_t dsc;
 #endif
 
+	FF_TRACE_ENTER(SD_TR_FF_LSEEK);
 	res = validate(&fp->obj, &fs);		/* Check validity of the file object */
 	if (res == FR_OK) res = (FRESULT)fp->err;
 #if FF_FS_EXFAT && !FF_FS_READONLY
@@ -4773,6 +5392,69 @@ FRESULT f_findfirst (
 
 
 
+#if FF_USE_DIR_BATCH
+#if !FF_USE_FIND || FF_FS_MINIMIZE > 1
+#error FF_USE_DIR_BATCH needs FF_USE_FIND
+#endif
+/*-----------------------------------------------------------------------*/
+/* Read Directory Items in a Batch                                       */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_readdir_batch (
+	DIR* dp,				/* Pointer to the open directory object */
+	FILENT* ent,			/* Array of items to fill */
+	UINT n_ent,				/* Number of items ent[] can take */
+	TCHAR* names,			/* Buffer the item names are stored in */
+	UINT sz_names,			/* Size of the name buffer in TCHAR */
+	UINT* used,				/* In: name buffer already in use, out: in use after the call */
+	const TCHAR* pattern,	/* Pointer to the matching pattern (null:every item) */
+	UINT* nread				/* Number of items filled (0:end of directory) */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	FILINFO fno;
+	UINT n = 0, len;
+	DEF_NAMBUF
+
+
+	*nread = 0;
+	res = validate(&dp->obj, &fs);	/* Check validity of the directory object */
+	if (res == FR_OK) {
+		INIT_NAMBUF(fs);
+		while (n < n_ent && *used <= 0xFFFF && sz_names - *used >= FF_LFN_BUF + 1) {	/* Room for one more item of any name length? */
+			res = DIR_READ_FILE(dp);		/* Read an item */
+			if (res == FR_NO_FILE) { res = FR_OK; break; }	/* End of directory */
+			if (res != FR_OK) break;
+			get_fileinfo(dp, &fno);			/* Get the object information */
+			res = dir_next(dp, 0);			/* Increment index for next */
+			if (res == FR_NO_FILE) res = FR_OK;	/* Ignore end of directory now */
+			if (res != FR_OK) break;
+			if (pattern && !pattern_match(pattern, fno.fname, 0, FIND_RECURS)
+#if FF_USE_LFN && FF_USE_FIND == 2
+				&& !pattern_match(pattern, fno.altname, 0, FIND_RECURS)
+#endif
+			) continue;						/* Filtered out */
+			for (len = 0; fno.fname[len]; len++) ;
+			memcpy(names + *used, fno.fname, (len + 1) * sizeof (TCHAR));
+			ent[n].fsize = fno.fsize;
+			ent[n].fdate = fno.fdate;
+			ent[n].ftime = fno.ftime;
+			ent[n].name = (WORD)*used;
+			ent[n].fattrib = fno.fattrib;
+			*used += len + 1;
+			n++;
+		}
+		FREE_NAMBUF();
+	}
+	*nread = n;
+	LEAVE_FF(fs, res);
+}
+
+#endif	/* FF_USE_DIR_BATCH */
+
+
+
 #if FF_FS_MINIMIZE == 0
 /*-----------------------------------------------------------------------*/
 /* Get File Status                                                       */
@@ -4918,6 +5600,7 @@ FRESULT f_truncate (
 	DWORD ncl;
 
 
+	FF_TRACE_ENTER(SD_TR_FF_TRUNCATE);
 	res = validate(&fp->obj, &fs);	/* Check validity of the file object */
 	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);
 	if (!(fp->flag & FA_WRITE)) LEAVE_FF(fs, FR_DENIED);	/* Check access mode */
@@ -4973,6 +5656,7 @@ FRESULT f_unlink (
 	DEF_NAMBUF
 
 
+	FF_TRACE_ENTER(SD_TR_FF_UNLINK);
 	/* Get logical drive */
 	res = mount_volume(&path, &fs, FA_WRITE);
 	if (res == FR_OK) {
@@ -5081,6 +5765,9 @@ FRESULT f_mkdir (
 			if (dcl == 0) res = FR_DENIED;		/* No space to allocate a new cluster? */
 			if (dcl == 1) res = FR_INT_ERR;		/* Any insanity? */
 			if (dcl == 0xFFFFFFFF) res = FR_DISK_ERR;	/* Disk error? */
+#if FF_USE_DIR_INDEX
+			if (res == FR_OK) dix_forget(fs, dcl);	/* An index of a removed directory that had this cluster? */
+#endif
 			tm = GET_FATTIME();
 			if (res == FR_OK) {
 				res = dir_clear(fs, dcl);		/* Clean up the new table */
@@ -5573,6 +6260,7 @@ FRESULT f_expand (
 	DWORD n, clst, stcl, scl, ncl, tcl, lclst;
 
 
+	FF_TRACE_ENTER(SD_TR_FF_EXPAND);
 	res = validate(&fp->obj, &fs);		/* Check validity of the file object */
 	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);
 	if (fsz == 0 || fp->obj.objsize != 0 || !(fp->flag & FA_WRITE)) LEAVE_FF(fs, FR_DENIED);
@@ -5879,6 +6567,41 @@ static FRESULT create_partition (
 
 
 
+static int mkfs_erase (	/* 1:the sectors were erased to zeros, 0:they need to be written */
+	BYTE pdrv,			/* Physical drive */
+	LBA_t sect,			/* First sector */
+	LBA_t nsect			/* Number of sectors */
+)
+{
+	LBA_t lba[2];
+
+
+	lba[0] = sect; lba[1] = sect + nsect - 1;
+	return nsect && disk_ioctl(pdrv, CTRL_ERASE_ZEROS, lba) == RES_OK;
+}
+
+
+static DRESULT mkfs_write (	/* disk_write() that skips trailing zero sectors on erased sectors */
+	BYTE pdrv,
+	const BYTE* buf,
+	LBA_t sect,
+	UINT n,				/* Number of sectors */
+	UINT ss,			/* Sector size */
+	int erased			/* 1:the sectors already read as zeros */
+)
+{
+	UINT i;
+
+
+	if (erased) {	/* Write only up to the last sector with non-zero data */
+		for (i = n * ss; i > 0 && !buf[i - 1]; i--) ;
+		n = (i + ss - 1) / ss;
+		if (n == 0) return RES_OK;	/* Nothing to write */
+	}
+	return disk_write(pdrv, buf, sect, n);
+}
+
+
 FRESULT f_mkfs (
 	const TCHAR* path,		/* Logical drive number */
 	const MKFS_PARM* opt,	/* Format options */
@@ -5898,7 +6621,7 @@ FRESULT f_mkfs (
 	LBA_t sect, lba[2];
 	DWORD sz_rsv, sz_fat, sz_dir, sz_au;	/* Size of reserved, fat, dir, data, cluster */
 	UINT n_fat, n_root, i;					/* Index, Number of FATs and Number of roor dir entries */
-	int vol;
+	int vol, erased = 0;
 	DSTATUS ds;
 	FRESULT res;
 
@@ -6049,6 +6772,11 @@ FRESULT f_mkfs (
 		szb_bit = (n_clst + 7) / 8;								/* Size of allocation bitmap */
 		clen[0] = (szb_bit + sz_au * ss - 1) / (sz_au * ss);	/* Number of allocation bitmap clusters */
 
+		/* Erase the FAT and the allocation bitmap instead of writing zeros if requested */
+		if (opt->fmt & FM_ERASE) {
+			erased = mkfs_erase(pdrv, b_fat, sz_fat) && mkfs_erase(pdrv, b_data, sz_au * clen[0]);
+		}
+
 		/* Create a compressed up-case table */
 		sect = b_data + sz_au * clen[0];	/* Table start sector */
 		sum = 0;							/* Table checksum to be stored in the 82 entry */
@@ -6087,6 +6815,10 @@ FRESULT f_mkfs (
 		clen[1] = (szb_case + sz_au * ss - 1) / (sz_au * ss);	/* Number of up-case table clusters */
 		clen[2] = 1;	/* Number of root dir clusters */
 
+		if (erased) {	/* Erase the root directory too, it follows the up-case table */
+			erased = mkfs_erase(pdrv, b_data + sz_au * (clen[0] + clen[1]), sz_au * clen[2]);
+		}
+
 		/* Initialize the allocation bitmap */
 		sect = b_data; nsect = (szb_bit + ss - 1) / ss;	/* Start of bitmap and number of bitmap sectors */
 		nbit = clen[0] + clen[1] + clen[2];				/* Number of clusters in-use by system (bitmap, up-case and root-dir) */
@@ -6094,7 +6826,7 @@ FRESULT f_mkfs (
 			memset(buf, 0, sz_buf * ss);				/* Initialize bitmap buffer */
 			for (i = 0; nbit != 0 && i / 8 < sz_buf * ss; buf[i / 8] |= 1 << (i % 8), i++, nbit--) ;	/* Mark used clusters */
 			n = (nsect > sz_buf) ? sz_buf : nsect;		/* Write the buffered data */
-			if (disk_write(pdrv, buf, sect, n) != RES_OK) LEAVE_MKFS(FR_DISK_ERR);
+			if (mkfs_write(pdrv, buf, sect, n, ss, erased) != RES_OK) LEAVE_MKFS(FR_DISK_ERR);
 			sect += n; nsect -= n;
 		} while (nsect);
 
@@ -6115,7 +6847,7 @@ FRESULT f_mkfs (
 				if (nbit == 0 && j < 3) nbit = clen[j++];	/* Get next chain length */
 			} while (nbit != 0 && i < sz_buf * ss);
 			n = (nsect > sz_buf) ? sz_buf : nsect;	/* Write the buffered data */
-			if (disk_write(pdrv, buf, sect, n) != RES_OK) LEAVE_MKFS(FR_DISK_ERR);
+			if (mkfs_write(pdrv, buf, sect, n, ss, erased) != RES_OK) LEAVE_MKFS(FR_DISK_ERR);
 			sect += n; nsect -= n;
 		} while (nsect);
 
@@ -6132,7 +6864,7 @@ FRESULT f_mkfs (
 		sect = b_data + sz_au * (clen[0] + clen[1]); nsect = sz_au;	/* Start of the root directory and number of sectors */
 		do {	/* Fill root directory sectors */
 			n = (nsect > sz_buf) ? sz_buf : nsect;
-			if (disk_write(pdrv, buf, sect, n) != RES_OK) LEAVE_MKFS(FR_DISK_ERR);
+			if (mkfs_write(pdrv, buf, sect, n, ss, erased) != RES_OK) LEAVE_MKFS(FR_DISK_ERR);
 			memset(buf, 0, ss);	/* Rest of entries are filled with zero */
 			sect += n; nsect -= n;
 		} while (nsect);
@@ -6310,6 +7042,11 @@ FRESULT f_mkfs (
 			disk_write(pdrv, buf, b_vol + 1, 1);		/* Write original FSINFO (VBR + 1) */
 		}
 
+		/* Erase the FATs and the root directory instead of writing zeros if requested */
+		if (opt->fmt & FM_ERASE) {
+			erased = mkfs_erase(pdrv, b_fat, (LBA_t)sz_fat * n_fat + ((fsty == FS_FAT32) ? pau : sz_dir));
+		}
+
 		/* Initialize FAT area */
 		memset(buf, 0, sz_buf * ss);
 		sect = b_fat;		/* FAT start sector */
@@ -6324,7 +7061,7 @@ FRESULT f_mkfs (
 			nsect = sz_fat;		/* Number of FAT sectors */
 			do {	/* Fill FAT sectors */
 				n = (nsect > sz_buf) ? sz_buf : nsect;
-				if (disk_write(pdrv, buf, sect, (UINT)n) != RES_OK) LEAVE_MKFS(FR_DISK_ERR);
+				if (mkfs_write(pdrv, buf, sect, (UINT)n, ss, erased) != RES_OK) LEAVE_MKFS(FR_DISK_ERR);
 				memset(buf, 0, ss);	/* Rest of FAT all are cleared */
 				sect += n; nsect -= n;
 			} while (nsect);
@@ -6334,7 +7071,7 @@ FRESULT f_mkfs (
 		nsect = (fsty == FS_FAT32) ? pau : sz_dir;	/* Number of root directory sectors */
 		do {
 			n = (nsect > sz_buf) ? sz_buf : nsect;
-			if (disk_write(pdrv, buf, sect, (UINT)n) != RES_OK) LEAVE_MKFS(FR_DISK_ERR);
+			if (mkfs_write(pdrv, buf, sect, (UINT)n, ss, erased) != RES_OK) LEAVE_MKFS(FR_DISK_ERR);
 			sect += n; nsect -= n;
 		} while (nsect);
 	}
@@ -6423,6 +7160,83 @@ FRESULT f_fdisk (
 /* Get a String from the File                                            */
 /*-----------------------------------------------------------------------*/
 
+/* f_gets() takes its bytes from the sector already in the file buffer
+/  instead of calling f_read() per byte, which validates the object and
+/  recomputes the cluster and sector each time. f_read() is called only to
+/  bring in the next sector. */
+
+static UINT gets_avail (	/* Number of bytes at the file pointer that are in the file buffer */
+	FIL* fp
+)
+{
+#if !FF_FS_TINY
+	FATFS *fs = fp->obj.fs;
+	UINT ofs;
+	FSIZE_t rem;
+
+
+	if (!fs || fp->err || !(fp->flag & FA_READ)) return 0;	/* Invalid object? Let f_read() handle it */
+	ofs = (UINT)(fp->fptr % SS(fs));
+	if (ofs == 0) return 0;		/* At a sector boundary the buffer has not been loaded yet */
+	rem = fp->obj.objsize - fp->fptr;
+	return (rem < SS(fs) - ofs) ? (UINT)rem : SS(fs) - ofs;
+#else
+	(void)fp;
+	return 0;					/* The sector buffer is shared with the volume */
+#endif
+}
+
+
+static void gets_read (	/* f_read() of a few bytes, served from the file buffer when possible */
+	FIL* fp,
+	BYTE* s,
+	UINT n,
+	UINT* rc
+)
+{
+#if !FF_FS_TINY
+	if (gets_avail(fp) >= n) {
+		memcpy(s, fp->buf + fp->fptr % SS(fp->obj.fs), n);
+		fp->fptr += n;
+		*rc = n;
+		return;
+	}
+#endif
+	f_read(fp, s, n, rc);
+}
+
+
+#if FF_STRF_ENCODE == 0 || FF_STRF_ENCODE == 3 || !FF_USE_LFN || !FF_LFN_UNICODE
+static UINT gets_ascii (	/* Copy a run of ASCII chars up to and including '\n' from the file buffer */
+	FIL* fp,
+	TCHAR* p,
+	UINT len				/* Max number of chars */
+)
+{
+#if !FF_FS_TINY
+	const BYTE *b;
+	UINT n, i;
+
+
+	n = gets_avail(fp);
+	if (n > len) n = len;
+	if (n == 0) return 0;
+	b = fp->buf + fp->fptr % SS(fp->obj.fs);
+	for (i = 0; i < n && b[i] < 0x80; ) {	/* Bytes 0x00-0x7F are the same chars in ANSI/OEM and UTF-8 */
+		if (FF_USE_STRFUNC == 2 && b[i] == '\r') break;	/* Leave \r to the char-by-char path */
+		p[i] = (TCHAR)b[i];
+		if (b[i++] == '\n') break;
+	}
+	fp->fptr += i;
+	return i;
+#else
+	(void)fp; (void)p; (void)len;
+	return 0;
+#endif
+}
+#endif
+
+
 TCHAR* f_gets (
 	TCHAR* buff,	/* Pointer to the buffer to store read string */
 	int len,		/* Size of string buffer (items) */
@@ -6447,31 +7261,38 @@ TCHAR* f_gets (
 	if (FF_LFN_UNICODE == 2) len -= (FF_STRF_ENCODE == 0) ? 3 : 4;
 	if (FF_LFN_UNICODE == 3) len -= 1;
 	while (nc < len) {
+#if FF_STRF_ENCODE == 0 || FF_STRF_ENCODE == 3
+		if ((rc = gets_ascii(fp, p, (UINT)(len - nc))) != 0) {	/* Run of ASCII chars? */
+			p += rc; nc += (int)rc;
+			if (p[-1] == '\n') break;	/* End of line? */
+			continue;
+		}
+#endif
 #if FF_STRF_ENCODE == 0				/* Read a character in ANSI/OEM */
-		f_read(fp, s, 1, &rc);		/* Get a code unit */
+		gets_read(fp, s, 1, &rc);		/* Get a code unit */
 		if (rc != 1) break;			/* EOF? */
 		wc = s[0];
 		if (dbc_1st((BYTE)wc)) {	/* DBC 1st byte? */
-			f_read(fp, s, 1, &rc);	/* Get 2nd byte */
+			gets_read(fp, s, 1, &rc);	/* Get 2nd byte */
 			if (rc != 1 || !dbc_2nd(s[0])) continue;	/* Wrong code? */
 			wc = wc << 8 | s[0];
 		}
 		dc = ff_oem2uni(wc, CODEPAGE);	/* Convert ANSI/OEM into Unicode */
 		if (dc == 0) continue;		/* Conversion error? */
 #elif FF_STRF_ENCODE == 1 || FF_STRF_ENCODE == 2 	/* Read a character in UTF-16LE/BE */
-		f_read(fp, s, 2, &rc);		/* Get a code unit */
+		gets_read(fp, s, 2, &rc);		/* Get a code unit */
 		if (rc != 2) break;			/* EOF? */
 		dc = (FF_STRF_ENCODE == 1) ? ld_word(s) : s[0] << 8 | s[1];
 		if (IsSurrogateL(dc)) continue;	/* Broken surrogate pair? */
 		if (IsSurrogateH(dc)) {		/* High surrogate? */
-			f_read(fp, s, 2, &rc);	/* Get low surrogate */
+			gets_read(fp, s, 2, &rc);	/* Get low surrogate */
 			if (rc != 2) break;		/* EOF? */
 			wc = (FF_STRF_ENCODE == 1) ? ld_word(s) : s[0] << 8 | s[1];
 			if (!IsSurrogateL(wc)) continue;	/* Broken surrogate pair? */
 			dc = ((dc & 0x3FF) + 0x40) << 10 | (wc & 0x3FF);	/* Merge surrogate pair */
 		}
 #else	/* Read a character in UTF-8 */
-		f_read(fp, s, 1, &rc);		/* Get a code unit */
+		gets_read(fp, s, 1, &rc);		/* Get a code unit */
 		if (rc != 1) break;			/* EOF? */
 		dc = s[0];
 		if (dc >= 0x80) {			/* Multi-byte sequence? */
@@ -6486,7 +7307,7 @@ TCHAR* f_gets (
 				dc &= 0x07; ct = 3;
 			}
 			if (ct == 0) continue;
-			f_read(fp, s, ct, &rc);	/* Get trailing bytes */
+			gets_read(fp, s, ct, &rc);	/* Get trailing bytes */
 			if (rc != ct) break;
 			rc = 0;
 			do {	/* Merge the byte sequence */
@@ -6533,7 +7354,12 @@ TCHAR* f_gets (
 #else			/* Byte-by-byte read without any conversion (ANSI/OEM API) */
 	len -= 1;	/* Make a room for the terminator */
 	while (nc < len) {
-		f_read(fp, s, 1, &rc);	/* Get a byte */
+		if ((rc = gets_ascii(fp, p, (UINT)(len - nc))) != 0) {	/* Run of ASCII chars? */
+			p += rc; nc += (int)rc;
+			if (p[-1] == '\n') break;	/* End of line? */
+			continue;
+		}
+		gets_read(fp, s, 1, &rc);	/* Get a byte */
 		if (rc != 1) break;		/* EOF? */
 		dc = s[0];
 		if (FF_USE_STRFUNC == 2 && dc == '\r') continue;
@@ -7025,6 +7851,15 @@ int f_printf (
 		}
 #endif
 		i = 0;
+#if FF_PRINT_LLI && FF_INTDEF == 2
+		if (r == 10 && v <= 0xFFFFFFFF) {	/* Decimal within 32 bits? Avoid the 64-bit division per digit */
+			DWORD v32 = (DWORD)v;
+
+			do {
+				str[i++] = (char)('0' + v32 % 10); v32 /= 10;
+			} while (v32);
+		} else
+#endif
 		do {	/* Make an integer number string */
 			d = (char)(v % r); v /= r;
 			if (d > 9) d += (tc == 'x') ? 0x27 : 0x07;
@@ -7053,6 +7888,173 @@ int f_printf (
 
 
 
+#if !FF_FS_READONLY && FF_USE_FMT
+/*-----------------------------------------------------------------------*/
+/* Buffered Text Writer (with sub-functions)                             */
+/*-----------------------------------------------------------------------*/
+
+static const char DigitPair[] =	/* Two decimal digits of 0..99 */
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static const DWORD Pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+
+/* Make room for n bytes in the buffer, writing it out if needed */
+
+static void fmt_room (FFMT* fb, UINT n)
+{
+	UINT bw;
+
+
+	if (fb->len + n > sizeof fb->buf) {
+		if (fb->res == FR_OK) {
+			fb->res = f_write(fb->fp, fb->buf, fb->len, &bw);
+			if (fb->res == FR_OK && bw != fb->len) fb->res = FR_DENIED;	/* Disk full? */
+		}
+		fb->len = 0;
+	}
+}
+
+
+/* Put the decimal digits of val backward from end, return number of digits */
+
+static UINT fmt_utoa (char* end, DWORD val)
+{
+	char *p = end;
+	UINT d;
+
+
+	while (val >= 100) {	/* Two digits per division */
+		d = (UINT)(val % 100) * 2; val /= 100;
+		*--p = DigitPair[d + 1]; *--p = DigitPair[d];
+	}
+	if (val >= 10) {
+		d = (UINT)val * 2;
+		*--p = DigitPair[d + 1]; *--p = DigitPair[d];
+	} else {
+		*--p = (char)('0' + val);
+	}
+	return (UINT)(end - p);
+}
+
+
+/* Put sign, integer part and zero padded fractional part */
+
+static void fmt_num (FFMT* fb, int neg, DWORD ip, DWORD fp, UINT dp)
+{
+	char str[24], *p = str + sizeof str;
+	UINT n = 0;
+
+
+	if (dp) {
+		n = fmt_utoa(p, fp);
+		while (n < dp) str[sizeof str - ++n] = '0';	/* Leading zeros of the fraction */
+		str[sizeof str - ++n] = '.';
+	}
+	n += fmt_utoa(p - n, ip);
+	if (neg) str[sizeof str - ++n] = '-';
+	fmt_room(fb, n);
+	memcpy(fb->buf + fb->len, p - n, n);
+	fb->len += n;
+}
+
+
+
+void f_fmt_init (
+	FFMT* fb,	/* Pointer to the writer object */
+	FIL* fp		/* File opened for writing */
+)
+{
+	fb->fp = fp;
+	fb->len = 0;
+	fb->res = FR_OK;
+}
+
+
+
+void f_fmt_putc (
+	FFMT* fb,
+	char c
+)
+{
+	fmt_room(fb, 1);
+	fb->buf[fb->len++] = c;
+}
+
+
+
+void f_fmt_puts (
+	FFMT* fb,
+	const char* str
+)
+{
+	while (*str) {
+		fmt_room(fb, 1);
+		fb->buf[fb->len++] = *str++;
+	}
+}
+
+
+
+void f_fmt_uint (
+	FFMT* fb,
+	DWORD val,
+	UINT width	/* Minimum number of digits, zero padded (up to 10) */
+)
+{
+	char str[10];
+	UINT n;
+
+
+	n = fmt_utoa(str + sizeof str, val);
+	if (width > sizeof str) width = sizeof str;
+	while (n < width) str[sizeof str - ++n] = '0';
+	fmt_room(fb, n);
+	memcpy(fb->buf + fb->len, str + sizeof str - n, n);
+	fb->len += n;
+}
+
+
+
+void f_fmt_int (
+	FFMT* fb,
+	long val
+)
+{
+	fmt_num(fb, val < 0, (val < 0) ? 0 - (DWORD)val : (DWORD)val, 0, 0);
+}
+
+
+
+void f_fmt_fix (
+	FFMT* fb,
+	long val,	/* Value in units of 10^-dp */
+	UINT dp		/* Number of fractional digits (0..9) */
+)
+{
+	DWORD m = (val < 0) ? 0 - (DWORD)val : (DWORD)val;
+
+
+	if (dp > 9) dp = 9;
+	fmt_num(fb, val < 0, m / Pow10[dp], m % Pow10[dp], dp);
+}
+
+
+
+FRESULT f_fmt_flush (
+	FFMT* fb
+)
+{
+	fmt_room(fb, sizeof fb->buf);	/* Write out everything buffered */
+	return fb->res;
+}
+
+#endif /* !FF_FS_READONLY && FF_USE_FMT */
+
+
+
 #if FF_CODE_PAGE == 0
 /*-----------------------------------------------------------------------*/
 /* Set Active Codepage for the Path Name                                 */
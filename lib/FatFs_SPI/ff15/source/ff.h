@@ -257,10 +257,24 @@ typedef struct {
 
 
 
+#if FF_USE_DIR_BATCH
+/* Compact directory item filled by f_readdir_batch() (FILENT) */
+
+typedef struct {
+	FSIZE_t	fsize;			/* File size */
+	WORD	fdate;			/* Modified date */
+	WORD	ftime;			/* Modified time */
+	WORD	name;			/* Offset of the file name in the caller's name buffer */
+	BYTE	fattrib;		/* File attribute */
+} FILENT;
+#endif
+
+
+
 /* Format parameter structure (MKFS_PARM) */
 
 typedef struct {
-	BYTE fmt;			/* Format option (FM_FAT, FM_FAT32, FM_EXFAT and FM_SFD) */
+	BYTE fmt;			/* Format option (FM_FAT, FM_FAT32, FM_EXFAT, FM_SFD and FM_ERASE) */
 	BYTE n_fat;			/* Number of FATs */
 	UINT align;			/* Data area alignment (sector) */
 	UINT n_root;		/* Number of root directory entries */
@@ -296,6 +310,19 @@ typedef enum {
 
 
 
+#if FF_USE_FMT
+/* Buffered text writer object (FFMT) */
+
+typedef struct {
+	FIL*	fp;				/* File to write */
+	UINT	len;			/* Number of bytes in buf[] */
+	FRESULT	res;			/* First error (output after it is discarded) */
+	char	buf[FF_FMT_BUF];	/* Output buffer */
+} FFMT;
+#endif
+
+
+
 
 /*--------------------------------------------------------------*/
 /* FatFs Module Application Interface                           */
@@ -313,6 +340,9 @@ FRESULT f_closedir (DIR* dp);										/* Close an open directory */
 FRESULT f_readdir (DIR* dp, FILINFO* fno);							/* Read a directory item */
 FRESULT f_findfirst (DIR* dp, FILINFO* fno, const TCHAR* path, const TCHAR* pattern);	/* Find first file */
 FRESULT f_findnext (DIR* dp, FILINFO* fno);							/* Find next file */
+#if FF_USE_DIR_BATCH
+FRESULT f_readdir_batch (DIR* dp, FILENT* ent, UINT n_ent, TCHAR* names, UINT sz_names, UINT* used, const TCHAR* pattern, UINT* nread);	/* Read a batch of directory items */
+#endif
 FRESULT f_mkdir (const TCHAR* path);								/* Create a sub directory */
 FRESULT f_unlink (const TCHAR* path);								/* Delete an existing file or directory */
 FRESULT f_rename (const TCHAR* path_old, const TCHAR* path_new);	/* Rename/Move a file or directory */
@@ -335,6 +365,15 @@ int f_putc (TCHAR c, FIL* fp);										/* Put a character to the file */
 int f_puts (const TCHAR* str, FIL* cp);								/* Put a string to the file */
 int f_printf (FIL* fp, const TCHAR* str, ...);						/* Put a formatted string to the file */
 TCHAR* f_gets (TCHAR* buff, int len, FIL* fp);						/* Get a string from the file */
+#if FF_USE_FMT
+void f_fmt_init (FFMT* fb, FIL* fp);								/* Start buffered text output to the file */
+void f_fmt_putc (FFMT* fb, char c);									/* Put a byte */
+void f_fmt_puts (FFMT* fb, const char* str);						/* Put a string */
+void f_fmt_uint (FFMT* fb, DWORD val, UINT width);					/* Put an unsigned decimal, zero padded to width digits */
+void f_fmt_int (FFMT* fb, long val);								/* Put a signed decimal */
+void f_fmt_fix (FFMT* fb, long val, UINT dp);						/* Put val / 10^dp with dp fractional digits */
+FRESULT f_fmt_flush (FFMT* fb);										/* Write the buffered output to the file */
+#endif
 
 /* Some API fucntions are implemented as macro */
 
@@ -407,6 +446,7 @@ void ff_mutex_give (int vol);		/* Unlock sync object */
 #define FM_EXFAT	0x04
 #define FM_ANY		0x07
 #define FM_SFD		0x08
+#define FM_ERASE	0x10	/* Clear FAT, bitmap and root directory by erasing them on the device (CTRL_ERASE_ZEROS) */
 
 /* Filesystem type (FATFS.fs_type) */
 #define FS_FAT12	1
@@ -30,6 +30,13 @@
 /  f_findnext(). (0:Disable, 1:Enable 2:Enable with matching altname[] too) */
 
 
+#define FF_USE_DIR_BATCH	1
+/* This option switches f_readdir_batch(), which reads many directory items in
+/  one call into an array of FILENT and a name buffer, optionally filtered by a
+/  pattern as f_findnext() does. The volume is locked and the LFN working buffer
+/  is taken once per batch instead of once per item. (0:Disable or 1:Enable) */
+
+
 #define FF_USE_MKFS		1
 /* This option switches f_mkfs() function. (0:Disable or 1:Enable) */
 
@@ -38,10 +45,44 @@
 /* This option switches fast seek function. (0:Disable or 1:Enable) */
 
 
-#define FF_USE_EXPAND	0
+#define FF_USE_EXPAND	1
 /* This option switches f_expand function. (0:Disable or 1:Enable) */
 
 
+#define FF_USE_IO_STATS	1
+/* This option counts how f_write() splits requests into direct sector writes
+/  and buffered pieces, in io_stats (io_stats.h). (0:Disable or 1:Enable) */
+
+
+#define FF_USE_TRACE	1
+/* This option records entry and exit of the main file functions in the event
+/  tracer (sd_trace.h). (0:Disable or 1:Enable) */
+
+
+#define FF_USE_MOUNT_HINT	1
+/* This option lets mount_volume() ask the disk driver where the volume was found
+/  last time (GET_MOUNT_HINT). If the VBR there still has the same serial number,
+/  the partition table is not read and the FSInfo sector comes in the same
+/  disk_read() as the VBR. (0:Disable or 1:Enable) */
+
+
+#define FF_USE_DIR_INDEX	1
+#define FF_DIR_INDEX_SLOTS	2048
+#define FF_DIR_INDEX_VOLUMES	1
+/* FF_USE_DIR_INDEX keeps, for each volume, an in-memory hash table from name to
+/  entry position for one large directory (FF_USE_LFN needed). Looking up a name
+/  there reads only the candidate entry block instead of scanning the directory
+/  from the top. The table is built in one pass when a lookup has had to scan at
+/  least 64 entries, dir_register() and dir_remove() keep it current, and a
+/  remount drops it. (0:Disable or 1:Enable)
+/  FF_DIR_INDEX_SLOTS sets its size in slots of 4 bytes (power of 2, 64 or more).
+/  Up to 3/4 of them are used, one per 8.3 name and two per long name. In a
+/  bigger directory the names that fit are still found at once, but a name that
+/  is not there is only known to be missing after a scan.
+/  FF_DIR_INDEX_VOLUMES is the number of volumes, from drive 0 up, that have a
+/  table (1 to FF_VOLUMES); the others always scan. */
+
+
 #define FF_USE_CHMOD	0
 /* This option switches attribute manipulation functions, f_chmod() and f_utime().
 /  (0:Disable or 1:Enable) Also FF_FS_READONLY needs to be 0 to enable this option. */
@@ -80,6 +121,18 @@
 */
 
 
+#define FF_USE_FMT		1
+#define FF_FMT_BUF		512
+/* FF_USE_FMT switches the buffered text writer f_fmt_*(). The caller owns an
+/  FFMT object whose FF_FMT_BUF byte buffer collects strings, integers and
+/  fixed-point decimals, and it goes to the file in one f_write() when it is
+/  full or at f_fmt_flush(). Numbers are converted two digits per step without
+/  stdio. Bytes are written as given, without the code conversion of the
+/  string functions. FF_FMT_BUF should be a multiple of the sector size, so
+/  that a full buffer is written to the sectors of a sector-aligned file
+/  directly. (0:Disable or 1:Enable) */
+
+
 /*---------------------------------------------------------------------------/
 / Locale and Namespace Configurations
 /---------------------------------------------------------------------------*/
@@ -275,8 +328,8 @@
 /      lock control is independent of re-entrancy. */
 
 
-#define FF_FS_REENTRANT	0
-#define FF_FS_TIMEOUT	1000
+#define FF_FS_REENTRANT	1
+#define FF_FS_TIMEOUT	5000
 /* The option FF_FS_REENTRANT switches the re-entrancy (thread safe) of the FatFs
 /  module itself. Note that regardless of this option, file access to different
 /  volume is always re-entrant and volume control functions, f_mount(), f_mkfs()
@@ -289,6 +342,8 @@
 /      function, must be added to the project. Samples are available in ffsystem.c.
 /
 /  The FF_FS_TIMEOUT defines timeout period in unit of O/S time tick.
+/  (ffsystem.c uses the Pico SDK mutexes: ms. Long enough for f_expand() of a
+/  log segment on the other core.)
 */
 
 
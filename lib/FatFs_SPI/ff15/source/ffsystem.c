@@ -12,12 +12,26 @@
 /*------------------------------------------------------------------------*/
 
 #include <stdlib.h>		/* with POSIX API */
+#include "ff_pool.h"
+
+
+/* Every call that takes a path asks for an LFN working buffer of this size.
+/  Those come from a pool: a call holds its buffer only while its volume is
+/  locked, so one block per volume is enough. Other sizes (the work areas of
+/  f_mkfs() and dir_clear(), never this size) still come from the heap. */
+#if FF_FS_EXFAT
+#define LFN_BUF_SIZE	((FF_MAX_LFN + 1) * 2 + (FF_MAX_LFN + 44U) / 15 * 32)	/* As INIT_NAMBUF in ff.c */
+#else
+#define LFN_BUF_SIZE	((FF_MAX_LFN + 1) * 2)
+#endif
+FF_POOL_DEFINE(ff_pool_lfn, LFN_BUF_SIZE, FF_VOLUMES);
 
 
 void* ff_memalloc (	/* Returns pointer to the allocated memory block (null if not enough core) */
 	UINT msize		/* Number of bytes to allocate */
 )
 {
+	if (msize == LFN_BUF_SIZE) return ff_pool_alloc(&ff_pool_lfn);
 	return malloc((size_t)msize);	/* Allocate a new memory block */
 }
 
@@ -26,7 +40,11 @@ void ff_memfree (
 	void* mblock	/* Pointer to the memory block to free (no effect if null) */
 )
 {
-	free(mblock);	/* Free the memory block */
+	if (ff_pool_owns(&ff_pool_lfn, mblock)) {
+		ff_pool_free(&ff_pool_lfn, mblock);
+	} else {
+		free(mblock);	/* Free the memory block */
+	}
 }
 
 #endif
@@ -39,7 +57,7 @@ void ff_memfree (
 /* Definitions of Mutex                                                   */
 /*------------------------------------------------------------------------*/
 
-#define OS_TYPE	0	/* 0:Win32, 1:uITRON4.0, 2:uC/OS-II, 3:FreeRTOS, 4:CMSIS-RTOS */
+#define OS_TYPE	5	/* 0:Win32, 1:uITRON4.0, 2:uC/OS-II, 3:FreeRTOS, 4:CMSIS-RTOS, 5:Pico SDK */
 
 
 #if   OS_TYPE == 0	/* Win32 */
@@ -64,6 +82,12 @@ static SemaphoreHandle_t Mutex[FF_VOLUMES + 1];	/* Table of mutex handle */
 #include "cmsis_os.h"
 static osMutexId Mutex[FF_VOLUMES + 1];	/* Table of mutex ID */
 
+#elif OS_TYPE == 5	/* Pico SDK, no RTOS: the owner of a mutex is a core */
+#include "hardware/timer.h"
+#include "pico/mutex.h"
+#include "io_stats.h"
+static mutex_t Mutex[FF_VOLUMES + 1];	/* Table of mutexes */
+
 #endif
 
 
@@ -106,6 +130,12 @@ int ff_mutex_create (	/* Returns 1:Function succeeded or 0:Could not create the
 	Mutex[vol] = osMutexCreate(osMutex(cmsis_os_mutex));
 	return (int)(Mutex[vol] != NULL);
 
+#elif OS_TYPE == 5	/* Pico SDK */
+	/* Created once and kept: f_mount() deletes and creates it again on a
+	   remount, when the other core may be waiting on it. */
+	if (!mutex_is_initialized(&Mutex[vol])) mutex_init(&Mutex[vol]);
+	return 1;
+
 #endif
 }
 
@@ -138,6 +168,9 @@ void ff_mutex_delete (	/* Returns 1:Function succeeded or 0:Could not delete due
 #elif OS_TYPE == 4	/* CMSIS-RTOS */
 	osMutexDelete(Mutex[vol]);
 
+#elif OS_TYPE == 5	/* Pico SDK */
+	(void)vol;	/* Kept (see ff_mutex_create) */
+
 #endif
 }
 
@@ -171,6 +204,18 @@ int ff_mutex_take (	/* Returns 1:Succeeded or 0:Timeout */
 #elif OS_TYPE == 4	/* CMSIS-RTOS */
 	return (int)(osMutexWait(Mutex[vol], FF_FS_TIMEOUT) == osOK);
 
+#elif OS_TYPE == 5	/* Pico SDK: FF_FS_TIMEOUT is in ms */
+	uint32_t start;
+	int rv;
+
+	++io_stats.ff_lock_takes;
+	if (mutex_try_enter(&Mutex[vol], NULL)) return 1;
+	start = time_us_32();	/* Held by the other core: count the wait */
+	rv = (int)mutex_enter_timeout_ms(&Mutex[vol], FF_FS_TIMEOUT);
+	io_hist_add(&io_stats.ff_lock_wait, time_us_32() - start);
+	if (!rv) ++io_stats.ff_lock_timeouts;
+	return rv;
+
 #endif
 }
 
@@ -201,6 +246,9 @@ void ff_mutex_give (
 #elif OS_TYPE == 4	/* CMSIS-RTOS */
 	osMutexRelease(Mutex[vol]);
 
+#elif OS_TYPE == 5	/* Pico SDK */
+	mutex_exit(&Mutex[vol]);
+
 #endif
 }
 
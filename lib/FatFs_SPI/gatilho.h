@@ -0,0 +1,190 @@
+#ifndef GATILHO_H
+#define GATILHO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ff.h"
+#include "lib/FatFs_SPI/aquisicao.h"
+
+// Captura por evento com pré-disparo. Enquanto o log grava, as amostras passam por
+// um anel em RAM com as últimas GAT_ANEL; um disparo (módulo da aceleração ou da
+// rotação passando do limiar, ou o botão/comando "capture") grava num arquivo novo
+// EVENTOS/EVnnnnn.CSV as amostras de pre_us antes até pos_us depois dele, com o
+// tempo relativo ao disparo e os valores brutos. Os limiares disparam na subida:
+// um sinal que continua acima não gera outro evento. Sem eventos, nada vai para o
+// cartão.
+#define GAT_DIR "EVENTOS"
+#define GAT_ANEL 2048 // Amostras guardadas antes do disparo: 2 s a 1000 Hz (potência de 2)
+#define GAT_PRE_MS_PADRAO 1000
+#define GAT_POS_MS_PADRAO 1000
+
+typedef struct
+{
+  // Configuração
+  uint32_t acel_lim2; // Limiar do módulo da aceleração, em contagens ao quadrado; 0: desligado
+  uint32_t giro_lim2; // Limiar do módulo da rotação, idem
+  uint32_t pre_us;    // Tempo gravado antes do disparo
+  uint32_t pos_us;    // E depois
+
+  // Estado
+  uint32_t n;         // Amostras que já passaram pelo anel (cresce livremente)
+  bool acima;         // Última amostra acima de um limiar
+  bool manual;        // Disparo manual pendente, no tempo manual_us
+  uint32_t manual_us;
+  bool gravando;      // Arquivo de evento aberto
+  uint32_t disparo_us;
+  const char *causa;
+  uint32_t numero;    // Próximo número de arquivo a tentar
+  uint32_t amostras;  // Amostras no evento em gravação
+  char nome[24];
+  FIL fil;
+  FFMT fmt;
+
+  // Contadores
+  uint32_t eventos;
+  uint32_t ignorados; // Disparos manuais durante a gravação de outro evento
+} gat_t;
+
+static gat_t gat = {.pre_us = GAT_PRE_MS_PADRAO * 1000, .pos_us = GAT_POS_MS_PADRAO * 1000};
+static amostra_t gat_anel[GAT_ANEL];
+
+// Zera o anel no início do log; a configuração e a numeração dos arquivos ficam.
+static void gat_iniciar()
+{
+  gat.n = 0;
+  gat.acima = false;
+  gat.manual = false;
+  gat.gravando = false;
+}
+
+// Disparo manual: vale para a primeira amostra lida a partir de agora.
+static void gat_disparar()
+{
+  if (gat.manual)
+    return;
+  gat.manual = true;
+  gat.manual_us = time_us_32();
+}
+
+static void gat_linha(const amostra_t *a)
+{
+  f_fmt_int(&gat.fmt, (long)(int32_t)(a->t_us - gat.disparo_us));
+  for (int c = 0; c < 3; c++)
+  {
+    f_fmt_putc(&gat.fmt, ',');
+    f_fmt_int(&gat.fmt, a->accel[c]);
+  }
+  for (int c = 0; c < 3; c++)
+  {
+    f_fmt_putc(&gat.fmt, ',');
+    f_fmt_int(&gat.fmt, a->gyro[c]);
+  }
+  f_fmt_putc(&gat.fmt, '\n');
+  gat.amostras++;
+}
+
+// Abre o arquivo do evento e grava o que o anel tem de pre_us antes do disparo.
+static FRESULT gat_abrir(const amostra_t *a, const char *causa)
+{
+  FRESULT fr = f_mkdir(GAT_DIR);
+  if (FR_OK != fr && FR_EXIST != fr)
+    return fr;
+  do // Nomes já usados (de outras sessões) são pulados
+  {
+    snprintf(gat.nome, sizeof gat.nome, GAT_DIR "/EV%05lu.CSV", (unsigned long)(gat.numero++ % 100000));
+    fr = f_open(&gat.fil, gat.nome, FA_WRITE | FA_CREATE_NEW);
+  } while (FR_EXIST == fr);
+  if (FR_OK != fr)
+    return fr;
+  gat.gravando = true;
+  gat.disparo_us = a->t_us;
+  gat.causa = causa;
+  gat.amostras = 0;
+  f_fmt_init(&gat.fmt, &gat.fil);
+  f_fmt_puts(&gat.fmt, "t_us,accel_x,accel_y,accel_z,giro_x,giro_y,giro_z\n");
+  // Volta no anel até pre_us antes do disparo (a amostra do disparo ainda não está nele)
+  uint32_t k = 0, max = gat.n < GAT_ANEL ? gat.n : GAT_ANEL;
+  while (k < max && a->t_us - gat_anel[(gat.n - k - 1) & (GAT_ANEL - 1)].t_us <= gat.pre_us)
+    k++;
+  for (; k; k--)
+    gat_linha(&gat_anel[(gat.n - k) & (GAT_ANEL - 1)]);
+  return gat.fmt.res;
+}
+
+// Fecha o arquivo do evento, completo ou não.
+static FRESULT gat_fechar()
+{
+  if (!gat.gravando)
+    return FR_OK;
+  gat.gravando = false;
+  FRESULT fr = f_fmt_flush(&gat.fmt);
+  FRESULT fr2 = f_close(&gat.fil);
+  if (FR_OK == fr)
+    fr = fr2;
+  if (FR_OK == fr)
+  {
+    gat.eventos++;
+    printf("\n[EVENTO] %s: %s, %lu amostras.\n", gat.causa, gat.nome, gat.amostras);
+  }
+  return fr;
+}
+
+// Cartão perdido: o FIL morre com o volume, o evento em gravação fica como está.
+static void gat_abandonar()
+{
+  gat.gravando = false;
+}
+
+static inline uint32_t gat_modulo2(const int16_t v[3])
+{
+  return (uint32_t)(v[0] * v[0]) + (uint32_t)(v[1] * v[1]) + (uint32_t)(v[2] * v[2]);
+}
+
+// Causa do disparo nesta amostra, ou NULL.
+static const char *gat_condicao(const amostra_t *a)
+{
+  const char *causa = NULL;
+  if (gat.giro_lim2 && gat_modulo2(a->gyro) >= gat.giro_lim2)
+    causa = "rotação";
+  if (gat.acel_lim2 && gat_modulo2(a->accel) >= gat.acel_lim2)
+    causa = "aceleração";
+  bool subiu = causa && !gat.acima;
+  gat.acima = causa;
+  if (gat.manual && (int32_t)(a->t_us - gat.manual_us) >= 0)
+  {
+    gat.manual = false;
+    return "manual";
+  }
+  return subiu ? causa : NULL;
+}
+
+/**
+ * Passa n amostras pelo anel e pelos disparos, gravando o evento em andamento.
+ */
+static FRESULT gat_bloco(const amostra_t *a, uint32_t n)
+{
+  FRESULT fr = FR_OK;
+  for (uint32_t i = 0; i < n && FR_OK == fr; i++)
+  {
+    const char *causa = gat_condicao(&a[i]);
+    if (causa && gat.gravando)
+      gat.ignorados += 0 == strcmp(causa, "manual");
+    else if (causa)
+      fr = gat_abrir(&a[i], causa);
+    if (gat.gravando)
+    {
+      gat_linha(&a[i]);
+      if (a[i].t_us - gat.disparo_us >= gat.pos_us)
+        fr = gat_fechar();
+      else
+        fr = gat.fmt.res;
+    }
+    gat_anel[gat.n++ & (GAT_ANEL - 1)] = a[i];
+  }
+  return fr;
+}
+
+#endif
@@ -0,0 +1,60 @@
+/* ff_pool.h
+Fixed-size block pools for the objects that are allocated on every open: the
+LFN working buffer FatFs asks ff_memalloc() for in each call that takes a path
+(FF_USE_LFN 3), and the FIL behind each ff_fopen() FF_FILE.
+
+Storage is static, and a block is taken from or given back to a free list in
+constant time. Blocks never move or split, so there is no fragmentation, and
+running out is a sized limit rather than a heap accident. Both cores can use a
+pool: the free list is guarded by hardware spin lock PICO_SPINLOCK_ID_OS1,
+which the SDK leaves to the application when there is no RTOS.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ff_pool_t {
+    const char *name;
+    size_t block_size;  // Multiple of 8
+    size_t n_blocks;
+    uint8_t *storage;   // n_blocks * block_size bytes
+
+    // State variables:
+    void *free_list;    // Blocks given back, linked through their first word
+    size_t carved;      // Blocks handed out at least once; the rest are untouched
+    uint32_t used;
+    uint32_t peak;      // Highest value of used
+    uint32_t fails;     // Allocations refused because the pool was empty
+} ff_pool_t;
+
+// Defines the pool var with static storage for count blocks of size bytes.
+#define FF_POOL_DEFINE(var, size, count)                                     \
+    static uint8_t var##_storage[(count) * (((size) + 7) & ~7u)]             \
+        __attribute__((aligned(8)));                                         \
+    ff_pool_t var = {#var, ((size) + 7) & ~7u, (count), var##_storage}
+
+void *ff_pool_alloc(ff_pool_t *pool);  // NULL if the pool is empty
+void ff_pool_free(ff_pool_t *pool, void *block);
+static inline bool ff_pool_owns(const ff_pool_t *pool, const void *p) {
+    const uint8_t *b = p;
+    return b >= pool->storage && b < pool->storage + pool->n_blocks * pool->block_size;
+}
+
+// The pools of this library
+extern ff_pool_t ff_pool_lfn;  // ffsystem.c: LFN working buffers
+extern ff_pool_t ff_pool_fil;  // ff_stdio.c: FIL objects
+
+void ff_pool_print(const ff_pool_t *pool);
+void ff_pool_print_all(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* [] END OF FILE */
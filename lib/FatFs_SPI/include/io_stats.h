@@ -0,0 +1,101 @@
+/* io_stats.h
+Always-on I/O counters and latency histograms for each layer of the stack:
+SD commands (sd_card.c), SPI transfers (spi.c), the FatFs disk interface
+(glue.c), the f_write paths in FatFs (ff.c) and the FatFs locks (ffsystem.c).
+
+Updating a counter is a few instructions; timed spots add two reads of the
+microsecond timer. The counters are not atomic: when two cores do I/O at the
+same time an increment can occasionally be lost.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bucket 0 counts 0 us; bucket i counts [2^(i-1), 2^i) us; the last one is open ended.
+#define IO_HIST_BUCKETS 24
+// Calls by sector count: bucket i counts [2^i, 2^(i+1)) sectors.
+#define IO_SECT_BUCKETS 8
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t hist[IO_HIST_BUCKETS];
+} io_hist_t;
+
+typedef struct {
+    // sd_card.c
+    uint32_t sd_cmd[64];         // Commands sent, by index
+    uint32_t sd_acmd[64];        // Application commands sent (each preceded by CMD55)
+    uint32_t sd_cmd_retries;     // Resent after no response
+    uint32_t sd_cmd_errors;      // Ended with an error status
+    io_hist_t sd_wait_ready;     // Card busy (holding DO low)
+    io_hist_t sd_wait_token;     // Waiting for a data start token
+    uint32_t sd_timeouts;
+    uint32_t sd_init_us;         // Last successful sd_init, after the card detect check
+    uint32_t sd_acmd41_us;       // Of which waiting for the card to leave the idle state
+    uint32_t sd_acmd41_polls;
+    uint32_t sd_geometry_hits;   // Card found in the geometry cache: CSD not read
+    // spi.c
+    uint32_t spi_byte_xfers;     // Single-byte transfers (sd_spi_write)
+    uint32_t spi_block_xfers;    // Multi-byte DMA transfers
+    uint64_t spi_bytes;
+    uint32_t spi_timeouts;
+    // glue.c
+    io_hist_t disk_read;
+    io_hist_t disk_write;
+    uint32_t disk_read_sect[IO_SECT_BUCKETS];
+    uint32_t disk_write_sect[IO_SECT_BUCKETS];
+    uint32_t disk_errors;
+    // ff.c: how f_write splits requests
+    uint32_t f_write_calls;
+    uint32_t f_write_direct;     // Runs of whole sectors written straight from the caller's buffer
+    uint32_t f_write_direct_sect;
+    uint32_t f_write_partial;    // Pieces copied into the sector buffer
+    uint32_t f_write_flush;      // Dirty sector buffer written back
+    uint32_t f_write_fill;       // Sector read in before a partial overwrite
+    uint32_t f_write_cluster;    // Cluster chain lookups/extensions
+    uint32_t f_sync_calls;
+    // ff.c: mount_volume
+    uint32_t f_mount_hint_hits;   // Volume found where the driver remembered it
+    uint32_t f_mount_hint_misses; // Hint given but stale: searched from the MBR
+    // ff.c: directory name index (FF_USE_DIR_INDEX)
+    uint32_t f_dir_index_builds;  // Directory indexed after a long scan
+    uint32_t f_dir_index_hits;    // Name found by reading only its entry block
+    uint32_t f_dir_index_absent;  // Name known to be missing without a scan
+    uint32_t f_dir_index_scans;   // Not in a table that lacks some names: scanned
+    // ffsystem.c: volume and system locks (FF_FS_REENTRANT)
+    uint32_t ff_lock_takes;
+    io_hist_t ff_lock_wait;      // Only the takes that found the lock held by the other core
+    uint32_t ff_lock_timeouts;   // Gave up after FF_FS_TIMEOUT: the call failed with FR_TIMEOUT
+} io_stats_t;
+
+extern io_stats_t io_stats;
+
+static inline void io_hist_add(io_hist_t *h, uint32_t us) {
+    ++h->count;
+    h->total_us += us;
+    if (us > h->max_us) h->max_us = us;
+    uint32_t b = us ? 32 - __builtin_clz(us) : 0;
+    if (b >= IO_HIST_BUCKETS) b = IO_HIST_BUCKETS - 1;
+    ++h->hist[b];
+}
+
+static inline void io_sect_add(uint32_t *buckets, uint32_t count) {
+    uint32_t b = count ? 31 - __builtin_clz(count) : 0;
+    if (b >= IO_SECT_BUCKETS) b = IO_SECT_BUCKETS - 1;
+    ++buckets[b];
+}
+
+void io_stats_reset(void);
+void io_stats_print(void);       // Human readable
+void io_stats_print_json(void);  // One JSON object on a single line
+
+#ifdef __cplusplus
+}
+#endif
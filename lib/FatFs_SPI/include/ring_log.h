@@ -0,0 +1,144 @@
+/* ring_log.h
+Continuous logging into a ring of fixed-size, preallocated segment files.
+
+Segments are named <dir>/LOGnnnn.BIN. Each one is allocated contiguously with
+f_expand before it is needed, so rotating from a full segment to the next one
+is only a switch between two open FIL objects. Preparing the next segment and
+deleting the oldest one to stay within the quota are done in ring_log_service,
+which the application calls when it has spare time.
+
+Data is appended as self-describing records (ring_log_rec_t header plus
+payload) and committed with f_sync at most every sync_bytes bytes or sync_ms
+ms. Since segments are preallocated, a commit only rewrites the partial data
+sector and the directory entry; the FAT is never touched. sync_max_pct caps
+the share of wall time spent committing. After a power failure the segments
+of the interrupted run are still at their preallocated size: ring_log_recover
+scans them for the last record with a valid CRC and cuts the file there. The
+application calls it right after mounting the volume, so that readers never
+see the unwritten tail; ring_log_open calls it too, for volumes mounted
+without it.
+
+The first sector of each segment holds a sparse index (ring_log_index_t): the
+offset, sequence number and timestamp of one record about every 1/31 of the
+segment. It is rewritten in place at the commit after an entry is added, so a
+reader can binary-search it and seek close to a point in time instead of
+scanning the segment from the start. Records start right after it.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+//
+#include "ff.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RING_LOG_MAX_SEGNO 10000  // Segment numbers wrap at LOG9999.BIN
+#define RING_LOG_MAGIC 0x474F4C52  // "RLOG"
+#define RING_LOG_MAX_RECORD 4096   // Largest payload of one record
+#define RING_LOG_LEN_MASK 0x1FFF   // Payload bytes in ring_log_rec_t.len
+#define RING_LOG_TYPE_SHIFT 13     // Record type (0..7) in the top bits of len
+#define RING_LOG_INDEX_MAGIC 0x58444952  // "RIDX"
+#define RING_LOG_INDEX_SIZE 512    // Index block at the start of each segment
+#define RING_LOG_INDEX_ENTRIES 31
+
+// Record header, little-endian, written before each payload
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;    // Increases by one per record, across segments and runs
+    uint16_t len;    // Payload bytes following the header, and the record type
+    uint16_t segno;  // Segment written to; rejects stale data in reused clusters
+    uint32_t crc;    // CRC32 of this header (with crc = 0) and the payload
+} ring_log_rec_t;
+
+typedef struct {
+    uint64_t t_us;   // Timestamp given to ring_log_write_at() for this record
+    uint32_t offset; // Byte offset of its header in the segment
+    uint32_t seq;
+} ring_log_index_entry_t;
+
+// Index block, little-endian, at offset 0 of each segment
+typedef struct {
+    uint32_t magic;
+    uint16_t segno;
+    uint16_t count;  // Entries in use
+    uint32_t crc;    // CRC32 of entry[0..count)
+    uint32_t reserved;
+    ring_log_index_entry_t entry[RING_LOG_INDEX_ENTRIES];
+} ring_log_index_t;
+
+typedef struct {
+    // Configuration, set before ring_log_open():
+    const char *dir;        // Directory holding the segment files
+    FSIZE_t segment_size;   // Bytes per segment (multiple of the sector size)
+    uint32_t segment_ms;    // Rotate after this many ms (0: rotate on size only)
+    uint32_t max_segments;  // Quota: the oldest segment is deleted beyond this
+    uint32_t sync_bytes;    // Commit after this many bytes (0: no byte bound)
+    uint32_t sync_ms;       // Commit after this many ms (0: no time bound)
+    uint8_t sync_max_pct;   // Max. % of time spent in f_sync (0: no limit)
+
+    // State:
+    FIL fil[2];             // Current segment and the preallocated next one
+    uint8_t cur;            // Index in fil[] of the current segment
+    bool is_open;
+    bool next_ready;        // fil[!cur] is open and preallocated
+    uint32_t oldest;        // Number of the oldest segment on the card
+    uint32_t newest;        // Number of the current segment
+    uint32_t count;         // Segments on the card, including the current one
+    FSIZE_t pos;            // Bytes written to the current segment, index included
+    uint64_t opened_us;     // When the current segment was started
+    uint32_t seq;           // Sequence number of the next record
+    FSIZE_t synced_pos;     // pos at the last commit
+    uint64_t synced_us;     // When the last commit ended
+    uint64_t sync_hold_us;  // No commit before this time (sync_max_pct)
+    uint64_t started_us;    // When ring_log_open() was called
+    uint8_t present[(RING_LOG_MAX_SEGNO + 7) / 8];  // Segment numbers on the card
+    ring_log_index_t index; // Index of the current segment
+    FSIZE_t index_next;     // pos at which the next index entry is taken
+    bool index_dirty;       // index has entries not yet on the card
+
+    // Counters:
+    uint32_t rotations;
+    uint32_t deleted;
+    uint32_t stalls;        // Rotations that had to create a segment inline
+    uint32_t syncs;
+    uint64_t sync_us;       // Total time spent in f_sync
+    uint32_t recovered;     // Records kept in segments left by a power failure
+} ring_log_t;
+
+// Cuts the segments left at full size by an interrupted run after their last
+// valid record. Needs only dir; the log must not be open. A missing dir is
+// not an error.
+FRESULT ring_log_recover(ring_log_t *rl);
+FRESULT ring_log_open(ring_log_t *rl);
+FRESULT ring_log_write(ring_log_t *rl, const void *buff, UINT btw);  // One record
+// One record of a type (0..7) chosen by the application; ring_log_write is type 0
+FRESULT ring_log_write_type(ring_log_t *rl, uint8_t type, const void *buff, UINT btw);
+// Same, with the timestamp (us) the index uses for this record; the other
+// write functions use time_us_64(). Timestamps must not decrease.
+FRESULT ring_log_write_at(ring_log_t *rl, uint8_t type, const void *buff, UINT btw,
+                          uint64_t t_us);
+FRESULT ring_log_sync(ring_log_t *rl);
+FRESULT ring_log_service(ring_log_t *rl);
+FRESULT ring_log_close(ring_log_t *rl);
+// Drops the open segments without touching the card, after it was removed or
+// failed. ring_log_recover() cuts them as after a power failure.
+void ring_log_abandon(ring_log_t *rl);
+void ring_log_segment_name(const ring_log_t *rl, uint32_t segno, char *buf, size_t size);
+
+// Reading a closed segment. ring_log_read_index() loads its index and leaves
+// the file at the first record; segments written before the index existed,
+// or whose index is damaged, give an all-zero index (magic and segno too).
+// ring_log_read() reads the next record into buff (size bytes at least) and
+// sets *valid false at the end of the data.
+FRESULT ring_log_read_index(FIL *fp, ring_log_index_t *idx);
+FRESULT ring_log_read(FIL *fp, ring_log_rec_t *h, void *buff, UINT size, bool *valid);
+// Last entry with t_us <= t_us (binary search), or -1 if there is none
+int ring_log_index_find(const ring_log_index_t *idx, uint64_t t_us);
+
+#ifdef __cplusplus
+}
+#endif
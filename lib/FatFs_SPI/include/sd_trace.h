@@ -0,0 +1,85 @@
+/* sd_trace.h
+RAM ring buffer of timestamped events from the SD/SPI driver and FatFs, for
+finding out where the time of a slow operation went.
+
+Each event is 8 bytes: the 1 MHz timer (the Cortex-M0+ has no cycle counter),
+an argument, an event code with a begin/end flag, and the core number.
+Recording one is a handful of instructions and never blocks. When the buffer
+is full the oldest events are overwritten. sd_trace_dump() prints the buffer
+as "T,<us>,<core>,<event>,<B|E>,<arg>" lines; ArquivosDados/trace2chrome.py
+turns them into a Chrome trace (chrome://tracing, Perfetto).
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+//
+#include "pico/stdlib.h"
+#include "hardware/structs/timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SD_TRACE_LEN
+#define SD_TRACE_LEN 1024  // Events kept (power of 2)
+#endif
+
+typedef enum {
+    SD_TR_CMD,         // sd_cmd: arg = command index (| 0x100 for ACMD); end: arg = R1
+    SD_TR_WAIT_READY,  // Card busy; end: arg = 1 on timeout
+    SD_TR_WAIT_TOKEN,  // Waiting for a data token; arg = token; end: arg = 1 on timeout
+    SD_TR_DMA,         // spi_transfer of a block; arg = length
+    SD_TR_LOCK_WAIT,   // sd_acquire waiting for the card mutex
+    SD_TR_LOCK_HELD,   // Card mutex held
+    SD_TR_DISK_READ,   // disk_read; arg = sector count; end: arg = DRESULT
+    SD_TR_DISK_WRITE,  // disk_write; arg = sector count; end: arg = DRESULT
+    SD_TR_FF_OPEN,     // FatFs API calls; end: arg = FRESULT
+    SD_TR_FF_READ,
+    SD_TR_FF_WRITE,
+    SD_TR_FF_SYNC,
+    SD_TR_FF_CLOSE,
+    SD_TR_FF_LSEEK,
+    SD_TR_FF_EXPAND,
+    SD_TR_FF_TRUNCATE,
+    SD_TR_FF_UNLINK,
+    SD_TR_COUNT
+} sd_trace_ev_t;
+
+#define SD_TR_END 0x80  // Flag in sd_trace_rec_t.ev: end of the event
+
+typedef struct {
+    uint32_t t_us;
+    uint16_t arg;
+    uint8_t ev;
+    uint8_t core;
+} sd_trace_rec_t;
+
+extern sd_trace_rec_t sd_trace_buf[SD_TRACE_LEN];
+extern volatile uint32_t sd_trace_head;  // Events recorded so far
+extern volatile bool sd_trace_on;
+
+static inline void sd_trace_rec(uint8_t ev, uint32_t arg) {
+    if (!sd_trace_on) return;
+    // Not atomic: an interrupt or the other core recording at the same time
+    // can overwrite one event, which is acceptable for a diagnostic.
+    sd_trace_rec_t *r = &sd_trace_buf[sd_trace_head++ & (SD_TRACE_LEN - 1)];
+    r->t_us = timer_hw->timerawl;
+    r->arg = (uint16_t)arg;
+    r->ev = ev;
+    r->core = get_core_num();
+}
+static inline void sd_trace_begin(sd_trace_ev_t ev, uint32_t arg) {
+    sd_trace_rec(ev, arg);
+}
+static inline void sd_trace_end(sd_trace_ev_t ev, uint32_t arg) {
+    sd_trace_rec(ev | SD_TR_END, arg);
+}
+
+void sd_trace_enable(bool on);
+void sd_trace_clear(void);
+void sd_trace_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,175 @@
+#ifndef LISTAGEM_H
+#define LISTAGEM_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "pico/stdlib.h"
+#include "ff.h"
+
+// Listagem de pastas em lotes. f_readdir_batch() preenche um vetor de itens
+// compactos (FILENT, com os nomes num buffer à parte) sem nenhuma saída por
+// item; filtro, ordenação e paginação trabalham sobre o vetor, e o texto vai
+// para a USB em blocos de até LS_SAIDA_TAM bytes, não linha a linha.
+// Os ~31 KiB de vetores ficam num ls_trabalho_t emprestado por quem chama,
+// e não em variáveis estáticas.
+#define LS_MAX_ITENS 1024         // Itens guardados para ordenar
+#define LS_NOMES_TAM (12 * 1024)  // Bytes para os nomes desses itens
+#define LS_LOTE 32                // Itens por chamada quando não se guarda
+#define LS_POR_PAGINA 50
+#define LS_SAIDA_TAM 1024
+
+typedef enum
+{
+  LS_NOME,
+  LS_TAMANHO,
+  LS_DATA
+} ls_ordem_t;
+
+typedef struct
+{
+  bool longo;          // -l: atributos, tamanho e data
+  bool ordenar;        // false com -f: ordem da pasta, sem limite de itens
+  ls_ordem_t ordem;    // Nome; -s: tamanho; -t: data (maiores/mais novos primeiro)
+  bool inverso;        // -r
+  uint32_t pagina;     // -p <n>: só a página n (1, 2, ...); 0 = todas
+  uint32_t por_pagina;
+} ls_opcoes_t;
+
+typedef struct
+{
+  uint32_t itens;      // Itens que passaram pelo padrão
+  uint32_t pastas;
+  uint64_t bytes;
+  uint32_t mostrados;
+  bool truncado;       // Mais itens que LS_MAX_ITENS: só os primeiros foram ordenados
+  uint32_t us;
+} ls_resumo_t;
+
+typedef struct
+{
+  FILENT itens[LS_MAX_ITENS];
+  char nomes[LS_NOMES_TAM];
+  FILENT lote[LS_LOTE];
+  char lote_nomes[2048];
+  char saida[LS_SAIDA_TAM];
+} ls_trabalho_t;
+
+static ls_trabalho_t *ls_t; // O de ls_listar() em andamento
+static size_t ls_saida_n;
+static ls_ordem_t ls_cmp_ordem;
+static bool ls_cmp_inverso;
+
+static void ls_descarregar()
+{
+  if (ls_saida_n)
+    fwrite(ls_t->saida, 1, ls_saida_n, stdout);
+  ls_saida_n = 0;
+}
+
+static void ls_linha(const FILENT *e, const char *nome, bool longo)
+{
+  if (LS_SAIDA_TAM - ls_saida_n < FF_LFN_BUF + 64)
+    ls_descarregar();
+  char *p = ls_t->saida + ls_saida_n;
+  size_t livre = LS_SAIDA_TAM - ls_saida_n;
+  int n;
+  if (longo)
+    n = snprintf(p, livre, "%c%c%c%c %10llu %04u-%02u-%02u %02u:%02u %s%s\n",
+                 (e->fattrib & AM_DIR) ? 'd' : '-', (e->fattrib & AM_RDO) ? 'r' : 'w',
+                 (e->fattrib & AM_HID) ? 'h' : '-', (e->fattrib & AM_SYS) ? 's' : '-',
+                 (unsigned long long)e->fsize, 1980 + (e->fdate >> 9), (e->fdate >> 5) & 15,
+                 e->fdate & 31, e->ftime >> 11, (e->ftime >> 5) & 63, nome,
+                 (e->fattrib & AM_DIR) ? "/" : "");
+  else
+    n = snprintf(p, livre, "%s [%s] [size=%llu]\n", nome,
+                 (e->fattrib & AM_DIR) ? "directory" : (e->fattrib & AM_RDO) ? "read only file" : "writable file",
+                 (unsigned long long)e->fsize);
+  if (n > 0)
+    ls_saida_n += (size_t)n < livre ? (size_t)n : livre - 1;
+}
+
+static int ls_comparar(const void *a, const void *b)
+{
+  const FILENT *x = a, *y = b;
+  int r = 0;
+  if (ls_cmp_ordem == LS_TAMANHO && x->fsize != y->fsize)
+    r = x->fsize > y->fsize ? -1 : 1;
+  else if (ls_cmp_ordem == LS_DATA && (x->fdate != y->fdate || x->ftime != y->ftime))
+    r = ((uint32_t)x->fdate << 16 | x->ftime) > ((uint32_t)y->fdate << 16 | y->ftime) ? -1 : 1;
+  if (!r)
+    r = strcasecmp(ls_t->nomes + x->name, ls_t->nomes + y->name);
+  return ls_cmp_inverso ? -r : r;
+}
+
+/**
+ * Lista a pasta com os itens que casam com padrao (NULL = todos), usando t
+ * como área de trabalho. Sem ordenação os itens são escritos à medida que os
+ * lotes chegam.
+ */
+static FRESULT ls_listar(const char *pasta, const char *padrao, const ls_opcoes_t *op, ls_resumo_t *r,
+                         ls_trabalho_t *t)
+{
+  DIR dj;
+  memset(r, 0, sizeof *r);
+  ls_t = t;
+  uint32_t t0 = time_us_32();
+  FRESULT fr = f_opendir(&dj, pasta);
+  if (FR_OK != fr)
+    return fr;
+
+  uint32_t inicio = op->pagina ? (op->pagina - 1) * op->por_pagina : 0;
+  uint32_t fim = op->pagina ? inicio + op->por_pagina : UINT32_MAX;
+  UINT guardados = 0, usados = 0;
+  ls_saida_n = 0;
+  for (;;)
+  {
+    FILENT *lote;
+    UINT n, lote_usados = 0;
+    bool guardar = op->ordenar && guardados < LS_MAX_ITENS && LS_NOMES_TAM - usados >= FF_LFN_BUF + 1;
+    if (guardar)
+    {
+      lote = t->itens + guardados;
+      fr = f_readdir_batch(&dj, lote, LS_MAX_ITENS - guardados, t->nomes, LS_NOMES_TAM, &usados, padrao, &n);
+      guardados += n;
+    }
+    else
+    {
+      lote = t->lote;
+      fr = f_readdir_batch(&dj, lote, LS_LOTE, t->lote_nomes, sizeof t->lote_nomes, &lote_usados, padrao, &n);
+      if (op->ordenar && n)
+        r->truncado = true; // Só contados
+    }
+    if (FR_OK != fr || 0 == n)
+      break;
+    for (UINT i = 0; i < n; i++, r->itens++)
+    {
+      if (lote[i].fattrib & AM_DIR)
+        r->pastas++;
+      else
+        r->bytes += lote[i].fsize;
+      if (!op->ordenar && r->itens >= inicio && r->itens < fim)
+      {
+        ls_linha(&lote[i], t->lote_nomes + lote[i].name, op->longo);
+        r->mostrados++;
+      }
+    }
+  }
+  f_closedir(&dj);
+
+  if (FR_OK == fr && op->ordenar)
+  {
+    ls_cmp_ordem = op->ordem;
+    ls_cmp_inverso = op->inverso;
+    qsort(t->itens, guardados, sizeof t->itens[0], ls_comparar);
+    for (uint32_t i = inicio; i < guardados && i < fim; i++, r->mostrados++)
+      ls_linha(&t->itens[i], t->nomes + t->itens[i].name, op->longo);
+  }
+  ls_descarregar();
+  r->us = time_us_32() - t0;
+  return fr;
+}
+
+#endif
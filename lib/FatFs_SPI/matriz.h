@@ -1,8 +1,13 @@
 #ifndef MATRIZ_H
 #define MATRIZ_H
 
+#include <math.h>
+
 #include "hardware/pio.h"
 #include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
 #include "pico/stdlib.h"
 
 // Biblioteca gerada pelo arquivo .pio durante compilação.
@@ -12,24 +17,79 @@
 #define LED_COUNT 25
 #define LED_PIN_MATRIZ 7
 
+// Brilho padrão (0-255). Equivale ao antigo fator 0.05.
+#define NP_BRILHO_PADRAO 13
+#define NP_GAMMA 2.2f
 
-// Definição de pixel GRB
-struct pixel_t
-{
-  uint8_t G, R, B; // Três valores de 8-bits compõem um pixel.
-};
-typedef struct pixel_t pixel_t;
-typedef pixel_t npLED_t; // Mudança de nome de "struct pixel_t" para "npLED_t" por clareza.
+// Tempo após o fim do DMA até o próximo quadro. O DMA termina quando a última
+// palavra entra na FIFO TX, e a PIO ainda transmite a FIFO inteira (juntada em
+// ws2818b_program_init: 8 palavras) mais a palavra no OSR, 24 bits cada a 800 kHz
+// (30 us por palavra). Só depois disso a linha fica baixa para o RESET (>= 280 us).
+#define NP_FIFO_PALAVRAS 8
+#define NP_BIT_NS 1250 // 800 kHz
+#define NP_RESET_MIN_US 280
+#define NP_RESET_MARGEM_US 50
+#define NP_RESET_US (((NP_FIFO_PALAVRAS + 1) * 24 * NP_BIT_NS + 999) / 1000 + NP_RESET_MIN_US + NP_RESET_MARGEM_US)
+
+// Buffer de pixels: uma palavra de 32 bits por LED, no formato GRB << 8,
+// pronta para a máquina PIO (24 bits, MSB primeiro).
+uint32_t leds[LED_COUNT];
 
-// Declaração do buffer de pixels que formam a matriz.
-npLED_t leds[LED_COUNT];
+// Cópia enviada pelo DMA, para que o buffer acima possa ser alterado durante a transmissão.
+static uint32_t np_dma_buf[LED_COUNT];
 
-// Variáveis para uso da máquina PIO.
+// Tabela de correção gama + brilho, calculada uma única vez.
+static uint8_t np_lut[256];
+
+// Variáveis para uso da máquina PIO e do DMA.
 PIO np_pio;
 uint sm;
+static int np_dma_chan = -1;
+static volatile bool np_ocupado = false;  // Quadro em transmissão ou aguardando o RESET
+static volatile bool np_pendente = false; // npWrite() chamado durante a transmissão
 
 /**
- * Inicializa a máquina PIO para controle da matriz de LEDs.
+ * Recalcula a tabela de gama e brilho (0-255).
+ */
+void npSetBrilho(uint8_t brilho)
+{
+  for (uint i = 0; i < 256; ++i)
+    np_lut[i] = (uint8_t)(powf(i / 255.0f, NP_GAMMA) * brilho + 0.5f);
+}
+
+static void np_iniciar_dma()
+{
+  for (uint i = 0; i < LED_COUNT; ++i)
+    np_dma_buf[i] = leds[i];
+  np_ocupado = true;
+  dma_channel_transfer_from_buffer_now(np_dma_chan, np_dma_buf, LED_COUNT);
+}
+
+// Fim do intervalo de RESET: libera a matriz e envia o quadro pendente, se houver.
+static int64_t np_reset_callback(alarm_id_t id, void *user_data)
+{
+  if (np_pendente)
+  {
+    np_pendente = false;
+    np_iniciar_dma();
+  }
+  else
+    np_ocupado = false;
+  return 0;
+}
+
+static void np_dma_irq_handler()
+{
+  if (dma_hw->ints0 & (1u << np_dma_chan))
+  {
+    dma_hw->ints0 = 1u << np_dma_chan; // Limpa a interrupção
+    if (add_alarm_in_us(NP_RESET_US, np_reset_callback, NULL, true) < 0)
+      np_ocupado = false;
+  }
+}
+
+/**
+ * Inicializa a máquina PIO e o canal de DMA para controle da matriz de LEDs.
  */
 void npInit(uint pin)
 {
@@ -39,23 +99,37 @@ void npInit(uint pin)
   np_pio = pio0;
 
   // Toma posse de uma máquina PIO.
-  sm = pio_claim_unused_sm(np_pio, false);
-  if (sm < 0)
+  int sm_livre = pio_claim_unused_sm(np_pio, false);
+  if (sm_livre < 0)
   {
     np_pio = pio1;
-    sm = pio_claim_unused_sm(np_pio, true); // Se nenhuma máquina estiver livre, panic!
+    offset = pio_add_program(np_pio, &ws2818b_program);
+    sm_livre = pio_claim_unused_sm(np_pio, true); // Se nenhuma máquina estiver livre, panic!
   }
+  sm = (uint)sm_livre;
 
   // Inicia programa na máquina PIO obtida.
   ws2818b_program_init(np_pio, sm, offset, pin, 800000.f);
 
+  // DMA de palavras de 32 bits do buffer para a FIFO TX, no ritmo da PIO.
+  np_dma_chan = dma_claim_unused_channel(true);
+  dma_channel_config c = dma_channel_get_default_config(np_dma_chan);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, pio_get_dreq(np_pio, sm, true));
+  dma_channel_configure(np_dma_chan, &c, &np_pio->txf[sm], np_dma_buf, LED_COUNT, false);
+
+  // Compartilha a DMA_IRQ_0 com o driver SPI do cartão SD.
+  dma_channel_set_irq0_enabled(np_dma_chan, true);
+  irq_add_shared_handler(DMA_IRQ_0, np_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  irq_set_enabled(DMA_IRQ_0, true);
+
+  npSetBrilho(NP_BRILHO_PADRAO);
+
   // Limpa buffer de pixels.
   for (uint i = 0; i < LED_COUNT; ++i)
-  {
-    leds[i].R = 0;
-    leds[i].G = 0;
-    leds[i].B = 0;
-  }
+    leds[i] = 0;
 }
 
 /**
@@ -64,9 +138,7 @@ void npInit(uint pin)
 
 void npSetLED(const uint index, const uint8_t r, const uint8_t g, const uint8_t b)
 {
-  leds[index].R = (uint8_t)(r * 0.05);
-  leds[index].G = (uint8_t)(g * 0.05);
-  leds[index].B = (uint8_t)(b * 0.05);
+  leds[index] = ((uint32_t)np_lut[g] << 24) | ((uint32_t)np_lut[r] << 16) | ((uint32_t)np_lut[b] << 8);
 }
 
 /**
@@ -75,22 +147,24 @@ void npSetLED(const uint index, const uint8_t r, const uint8_t g, const uint8_t
 void npClear()
 {
   for (uint i = 0; i < LED_COUNT; ++i)
-    npSetLED(i, 0, 0, 0);
+    leds[i] = 0;
 }
 
 /**
  * Escreve os dados do buffer nos LEDs.
+ * Não bloqueia: se um quadro ainda está sendo enviado, o novo é enviado ao fim dele.
  */
 void npWrite()
 {
-  // Escreve cada dado de 8-bits dos pixels em sequência no buffer da máquina PIO.
-  for (uint i = 0; i < LED_COUNT; ++i)
-  {
-    pio_sm_put_blocking(np_pio, sm, leds[i].G);
-    pio_sm_put_blocking(np_pio, sm, leds[i].R);
-    pio_sm_put_blocking(np_pio, sm, leds[i].B);
-  }
-  sleep_us(100); // Espera 100us, sinal de RESET do datasheet.
+  if (np_dma_chan < 0)
+    return; // npInit() ainda não foi chamado
+
+  uint32_t irq = save_and_disable_interrupts();
+  if (np_ocupado)
+    np_pendente = true;
+  else
+    np_iniciar_dma();
+  restore_interrupts(irq);
 }
 
 // Função para converter a posição do matriz para uma posição do vetor.
@@ -131,19 +205,12 @@ void printColor(int r, int g, int b)
     }
   }
   npWrite(); // Atualiza os LEDs
-  sleep_us(1);
 }
 
 void printLevelBar(int valor)
 {
     // Limpa a matriz
-    for (int y = 0; y < 5; y++)
-    {
-        for (int x = 0; x < 5; x++)
-        {
-            npSetLED(getIndex(x, y), 0, 0, 0); // Desliga todos os LEDs
-        }
-    }
+    npClear();
 
     int linhas = 1;
 
@@ -159,12 +226,11 @@ void printLevelBar(int valor)
         int y = 4 - i; // y decrescendo
         for (int x = 0; x < 5; x++)
         {
-            npSetLED(getIndex(x, y), 0, 0, 25);
+            npSetLED(getIndex(x, y), 0, 0, 255); // Intensidade limitada pelo brilho da tabela
         }
     }
 
     npWrite(); // Atualiza os LEDs
-    sleep_us(1);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,53 @@
+#ifndef NUCLEO1_H
+#define NUCLEO1_H
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+// Tarefas no núcleo 1. O núcleo 0 entrega a função e o argumento pela FIFO
+// entre os núcleos; uma tarefa por vez. O núcleo 1 tem só 2 KiB de pilha:
+// buffers e estruturas grandes (FIL, por exemplo) ficam em variáveis estáticas.
+typedef void (*nucleo1_tarefa_t)(void *arg);
+
+static volatile bool nucleo1_ocupado = false;
+
+static void nucleo1_laco()
+{
+  while (true)
+  {
+    nucleo1_tarefa_t tarefa = (nucleo1_tarefa_t)(uintptr_t)multicore_fifo_pop_blocking();
+    void *arg = (void *)(uintptr_t)multicore_fifo_pop_blocking();
+    tarefa(arg);
+    nucleo1_ocupado = false;
+    __sev(); // Acorda o núcleo 0 se ele espera em nucleo1_aguardar()
+  }
+}
+
+void nucleo1_iniciar()
+{
+  multicore_launch_core1(nucleo1_laco);
+}
+
+/**
+ * Começa a executar tarefa(arg) no núcleo 1. Retorna false se ele ainda está
+ * ocupado com a anterior.
+ */
+static inline bool nucleo1_executar(nucleo1_tarefa_t tarefa, void *arg)
+{
+  if (nucleo1_ocupado)
+    return false;
+  nucleo1_ocupado = true;
+  multicore_fifo_push_blocking((uintptr_t)tarefa);
+  multicore_fifo_push_blocking((uintptr_t)arg);
+  return true;
+}
+
+// Dorme até o núcleo 1 terminar a tarefa em andamento.
+static inline void nucleo1_aguardar()
+{
+  while (nucleo1_ocupado)
+    __wfe();
+}
+
+#endif
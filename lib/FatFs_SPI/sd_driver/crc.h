@@ -36,6 +36,8 @@ specific language governing permissions and limitations under the License.
 char crc7(const char* data, int length);
 unsigned short crc16(const char* data, int length);
 void update_crc16(unsigned short *pCrc16, const char data[], size_t length);
+unsigned long crc32(const void* data, size_t length);
+void update_crc32(unsigned long *pCrc32, const void* data, size_t length);
 
 #endif
 
@@ -166,8 +166,12 @@ specific language governing permissions and limitations under the License.
 #include "pico/mutex.h"
 //
 #include "hw_config.h"  // Hardware Configuration of the SPI and SD Card "objects"
+#include "io_stats.h"
 #include "my_debug.h"
+#include "sd_trace.h"
 #include "sd_spi.h"
+#include "sd_volume.h"
+#include "util.h"  // calculate_checksum
 //
 #include "sd_card.h"
 //
@@ -351,13 +355,20 @@ static bool sd_wait_ready(sd_card_t *pSD, int timeout) {
 
     // Keep sending dummy clocks with DI held high until the card releases the
     // DO line
+    uint32_t start = time_us_32();
+    sd_trace_begin(SD_TR_WAIT_READY, 0);
     absolute_time_t timeout_time = make_timeout_time_ms(timeout);
     do {
         resp = sd_spi_write(pSD, 0xFF);
     } while (resp == 0x00 &&
              0 < absolute_time_diff_us(get_absolute_time(), timeout_time));
+    io_hist_add(&io_stats.sd_wait_ready, time_us_32() - start);
+    sd_trace_end(SD_TR_WAIT_READY, resp == 0x00);
 
-    if (resp == 0x00) DBG_PRINTF("%s failed\r\n", __FUNCTION__);
+    if (resp == 0x00) {
+        ++io_stats.sd_timeouts;
+        DBG_PRINTF("%s failed\r\n", __FUNCTION__);
+    }
 
     // Return success/failure
     return (resp > 0x00);
@@ -375,10 +386,14 @@ static void sd_unlock(sd_card_t *pSD) {
 
 // Locks the SD card and acquires its SPI
 static void sd_acquire(sd_card_t *pSD) {
+    sd_trace_begin(SD_TR_LOCK_WAIT, 0);
     sd_lock(pSD);
     sd_spi_acquire(pSD);
+    sd_trace_end(SD_TR_LOCK_WAIT, 0);
+    sd_trace_begin(SD_TR_LOCK_HELD, 0);
 }
 static void sd_release(sd_card_t *pSD) {
+    sd_trace_end(SD_TR_LOCK_HELD, 0);
     sd_unlock(pSD);
     sd_spi_release(pSD);
 }
@@ -457,14 +472,20 @@ static int sd_cmd(sd_card_t *pSD, const cmdSupported cmd, uint32_t arg,
     int32_t status = SD_BLOCK_DEVICE_ERROR_NONE;
     uint32_t response;
 
+    sd_trace_begin(SD_TR_CMD, isAcmd ? 0x100 | cmd : cmd);
     // No need to wait for card to be ready when sending the stop command
     if (CMD12_STOP_TRANSMISSION != cmd) {
         if (false == sd_wait_ready(pSD, SD_COMMAND_TIMEOUT)) {
             DBG_PRINTF("%s:%d: Card not ready yet\r\n", __FILE__, __LINE__);
         }
     }
+    if (isAcmd)
+        ++io_stats.sd_acmd[cmd & 63];
+    else
+        ++io_stats.sd_cmd[cmd & 63];
     // Re-try command
     for (int i = 0; i < SD_COMMAND_RETRIES; i++) {
+        if (i) ++io_stats.sd_cmd_retries;
         // Send CMD55 for APP command first
         if (isAcmd) {
             response = sd_cmd_spi(pSD, CMD55_APP_CMD, 0x0);
@@ -485,14 +506,17 @@ static int sd_cmd(sd_card_t *pSD, const cmdSupported cmd, uint32_t arg,
     if (NULL != resp) {
         *resp = response;
     }
+    sd_trace_end(SD_TR_CMD, response);
     // Process the response R1  : Exit on CRC/Illegal command error/No response
     if (R1_NO_RESPONSE == response) {
         DBG_PRINTF("No response CMD:%d response: 0x%" PRIx32 "\r\n", cmd,
                    response);
+        ++io_stats.sd_cmd_errors;
         return SD_BLOCK_DEVICE_ERROR_NO_DEVICE;  // No device
     }
     if (response & R1_COM_CRC_ERROR && ACMD23_SET_WR_BLK_ERASE_COUNT != cmd) {
         DBG_PRINTF("CRC error CMD:%d response 0x%" PRIx32 "\r\n", cmd, response);
+        ++io_stats.sd_cmd_errors;
         return SD_BLOCK_DEVICE_ERROR_CRC;  // CRC error
     }
     if (response & R1_ILLEGAL_COMMAND) {
@@ -503,6 +527,7 @@ static int sd_cmd(sd_card_t *pSD, const cmdSupported cmd, uint32_t arg,
             // Illegal command is for Ver1 or not SD Card
             pSD->card_type = CARD_UNKNOWN;
         }
+        ++io_stats.sd_cmd_errors;
         return SD_BLOCK_DEVICE_ERROR_UNSUPPORTED;  // Command not supported
     }
 
@@ -608,6 +633,7 @@ static int sd_cmd(sd_card_t *pSD, const cmdSupported cmd, uint32_t arg,
     if (NULL != resp) {
         *resp = response;
     }
+    if (SD_BLOCK_DEVICE_ERROR_NONE != status) ++io_stats.sd_cmd_errors;
     return status;
 }
 
@@ -618,8 +644,8 @@ bool sd_card_detect(sd_card_t *pSD) {
         pSD->m_Status &= ~STA_NODISK;
         return true;
     }
-    /*!< Check GPIO to detect SD */
-    if (gpio_get(pSD->card_detect_gpio) == pSD->card_detected_true) {
+    /*!< Debounced card detect GPIO, kept up to date by sd_cd_irq_handler */
+    if (pSD->cd_present) {
         // The socket is now occupied
         pSD->m_Status &= ~STA_NODISK;
         TRACE_PRINTF("SD card detected!\r\n");
@@ -643,14 +669,18 @@ static uint32_t sd_go_idle_state(sd_card_t *pSD) {
      * case when MCU power-on occurs the SDCard will resume operations as
      * though there was no reset. In this scenario the first CMD0 will
      * not be interpreted as a command and get lost. For some cards retrying
-     * the command overcomes this situation. */
+     * the command overcomes this situation. Such a card normally takes the
+     * second CMD0, so the wait between tries starts at 1 ms and backs off
+     * towards 100 ms for the slow ones. */
+    uint32_t wait_us = 1000;
     for (int i = 0; i < SD_CMD0_GO_IDLE_STATE_RETRIES; i++) {
         sd_cmd(pSD, CMD0_GO_IDLE_STATE, 0x0, false, &response);
         if (R1_IDLE_STATE == response) {
             break;
         }
         sd_release(pSD);
-        busy_wait_us(100 * 1000);
+        busy_wait_us(wait_us);
+        wait_us = MIN(2 * wait_us, 100 * 1000);
         sd_acquire(pSD);
     }
     return response;
@@ -753,23 +783,107 @@ static uint64_t sd_sectors_nolock(sd_card_t *pSD) {
     return blocks;
 }
 uint64_t sd_sectors(sd_card_t *pSD) {
+    if (pSD->volume) return pSD->sectors;  // Set when the volume was initialized
     sd_acquire(pSD);
     uint64_t sectors = sd_sectors_nolock(pSD);
     sd_release(pSD);
     return sectors;
 }
 
+// CMD10, Response R2 (R1 byte + 16-byte block read)
+static bool sd_read_cid(sd_card_t *pSD, uint8_t *cid) {
+    if (sd_cmd(pSD, CMD10_SEND_CID, 0x0, false, 0) != 0x0) {
+        DBG_PRINTF("Didn't get a response from the disk\r\n");
+        return false;
+    }
+    return sd_read_bytes(pSD, cid, 16) == 0;
+}
+
+/* Geometry cache
+
+What sd_init learns from the CSD, and where FatFs found the volume, for the
+last few cards, in RAM that a reset does not clear (like rtc_save in rtc.c).
+After a warm reset, a card with the same CID skips the CSD read, and f_mount
+goes straight to the volume boot record (FF_USE_MOUNT_HINT).
+*/
+#define SD_GEOMETRY_CACHE_SIZE 4
+#define SD_GEOMETRY_NO_MOUNT UINT32_MAX
+
+typedef struct sd_geometry {
+    uint32_t signature;
+    uint8_t cid[16];
+    uint32_t sectors;
+    uint32_t mount_sector;  // Where the FAT volume starts, or SD_GEOMETRY_NO_MOUNT
+    uint32_t mount_vsn;     // Its volume serial number
+    uint32_t checksum;  // last, not included in checksum
+} sd_geometry_t;
+static sd_geometry_t sd_geometry[SD_GEOMETRY_CACHE_SIZE]
+    __attribute__((section(".uninitialized_data")));
+
+static void sd_geometry_seal(sd_geometry_t *g) {
+    g->signature = 0x5D6E0CAC;
+    g->checksum = calculate_checksum((uint32_t *)g, sizeof *g);
+}
+static bool sd_geometry_valid(const sd_geometry_t *g) {
+    return g->signature == 0x5D6E0CAC &&
+           g->checksum == calculate_checksum((uint32_t *)g, sizeof *g);
+}
+static sd_geometry_t *sd_geometry_find(const uint8_t *cid) {
+    for (size_t i = 0; i < SD_GEOMETRY_CACHE_SIZE; ++i)
+        if (sd_geometry_valid(&sd_geometry[i]) && !memcmp(sd_geometry[i].cid, cid, 16))
+            return &sd_geometry[i];
+    return NULL;
+}
+static void sd_geometry_add(const uint8_t *cid, uint64_t sectors) {
+    if (sectors > UINT32_MAX) return;
+    sd_geometry_t *g = NULL;
+    for (size_t i = 0; i < SD_GEOMETRY_CACHE_SIZE && !g; ++i)
+        if (!sd_geometry_valid(&sd_geometry[i])) g = &sd_geometry[i];
+    // All in use: the last CID byte is its CRC, as good as a random pick
+    if (!g) g = &sd_geometry[cid[15] % SD_GEOMETRY_CACHE_SIZE];
+    memcpy(g->cid, cid, sizeof g->cid);
+    g->sectors = sectors;
+    g->mount_sector = SD_GEOMETRY_NO_MOUNT;
+    g->mount_vsn = 0;
+    sd_geometry_seal(g);
+}
+
+bool sd_get_mount_hint(sd_card_t *pSD, uint64_t *sector, uint32_t *vsn) {
+    if (pSD->volume || (pSD->m_Status & STA_NOINIT)) return false;
+    const sd_geometry_t *g = sd_geometry_find(pSD->cid);
+    if (!g || SD_GEOMETRY_NO_MOUNT == g->mount_sector) return false;
+    *sector = g->mount_sector;
+    *vsn = g->mount_vsn;
+    return true;
+}
+
+void sd_set_mount_hint(sd_card_t *pSD, uint64_t sector, uint32_t vsn) {
+    if (pSD->volume || (pSD->m_Status & STA_NOINIT)) return;
+    sd_geometry_t *g = sd_geometry_find(pSD->cid);
+    if (!g || sector >= SD_GEOMETRY_NO_MOUNT) return;
+    g->mount_sector = sector;
+    g->mount_vsn = vsn;
+    sd_geometry_seal(g);
+}
+
 // SPI function to wait till chip is ready and sends start token
 static bool sd_wait_token(sd_card_t *pSD, uint8_t token) {
     TRACE_PRINTF("%s(0x%02hhx)\r\n", __FUNCTION__, token);
 
     const uint32_t timeout = SD_COMMAND_TIMEOUT;  // Wait for start token
+    uint32_t start = time_us_32();
+    sd_trace_begin(SD_TR_WAIT_TOKEN, token);
     absolute_time_t timeout_time = make_timeout_time_ms(timeout);
     do {
         if (token == sd_spi_write(pSD, SPI_FILL_CHAR)) {
+            io_hist_add(&io_stats.sd_wait_token, time_us_32() - start);
+            sd_trace_end(SD_TR_WAIT_TOKEN, 0);
             return true;
         }
     } while (0 < absolute_time_diff_us(get_absolute_time(), timeout_time));
+    io_hist_add(&io_stats.sd_wait_token, time_us_32() - start);
+    sd_trace_end(SD_TR_WAIT_TOKEN, 1);
+    ++io_stats.sd_timeouts;
     DBG_PRINTF("sd_wait_token: timeout\r\n");
     return false;
 }
@@ -809,17 +923,22 @@ static int sd_read_bytes(sd_card_t *pSD, uint8_t *buffer, uint32_t length) {
 
     return 0;
 }
-static int sd_read_block(sd_card_t *pSD, uint8_t *buffer, uint32_t length) {
-    uint16_t crc;
-
+// Waits for the start token and starts the DMA of one data block
+static int sd_read_block_start(sd_card_t *pSD, uint8_t *buffer, uint32_t length) {
     // read until start byte (0xFE)
     if (false == sd_wait_token(pSD, SPI_START_BLOCK)) {
         DBG_PRINTF("%s:%d Read timeout\r\n", __FILE__, __LINE__);
         return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
     }
     // read data
-    // bool spi_transfer(const uint8_t *tx, uint8_t *rx, size_t length)
-    if (!sd_spi_transfer(pSD, NULL, buffer, length)) {
+    sd_spi_transfer_start(pSD, NULL, buffer, length);
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+// Waits for the DMA of the block and checks its CRC
+static int sd_read_block_finish(sd_card_t *pSD, uint8_t *buffer, uint32_t length) {
+    uint16_t crc;
+
+    if (!sd_spi_transfer_wait_complete(pSD, 1000)) {
         return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
     }
     // Read the CRC16 checksum for the data block
@@ -842,18 +961,19 @@ static int sd_read_block(sd_card_t *pSD, uint8_t *buffer, uint32_t length) {
 
     return SD_BLOCK_DEVICE_ERROR_NONE;
 }
+static int sd_read_block(sd_card_t *pSD, uint8_t *buffer, uint32_t length) {
+    int status = sd_read_block_start(pSD, buffer, length);
+    if (SD_BLOCK_DEVICE_ERROR_NONE != status) return status;
+    return sd_read_block_finish(pSD, buffer, length);
+}
 
-static int in_sd_read_blocks(sd_card_t *pSD, uint8_t *buffer,
-                             uint64_t ulSectorNumber, uint32_t ulSectorCount) {
-    uint32_t blockCnt = ulSectorCount;
-
+// Checks the range and sends CMD17 or CMD18
+static int sd_read_cmd(sd_card_t *pSD, uint64_t ulSectorNumber, uint32_t blockCnt) {
     if (ulSectorNumber + blockCnt > pSD->sectors)
         return SD_BLOCK_DEVICE_ERROR_PARAMETER;
     if (pSD->m_Status & (STA_NOINIT | STA_NODISK))
         return SD_BLOCK_DEVICE_ERROR_PARAMETER;
 
-    int status = SD_BLOCK_DEVICE_ERROR_NONE;
-
     uint64_t addr;
     // SDSC Card (CCS=0) uses byte unit address
     // SDHC and SDXC Cards (CCS=1) use block unit address (512 Bytes unit)
@@ -864,10 +984,17 @@ static int in_sd_read_blocks(sd_card_t *pSD, uint8_t *buffer,
     }
     // Write command ro receive data
     if (blockCnt > 1) {
-        status = sd_cmd(pSD, CMD18_READ_MULTIPLE_BLOCK, addr, false, 0);
+        return sd_cmd(pSD, CMD18_READ_MULTIPLE_BLOCK, addr, false, 0);
     } else {
-        status = sd_cmd(pSD, CMD17_READ_SINGLE_BLOCK, addr, false, 0);
+        return sd_cmd(pSD, CMD17_READ_SINGLE_BLOCK, addr, false, 0);
     }
+}
+
+static int in_sd_read_blocks(sd_card_t *pSD, uint8_t *buffer,
+                             uint64_t ulSectorNumber, uint32_t ulSectorCount) {
+    uint32_t blockCnt = ulSectorCount;
+
+    int status = sd_read_cmd(pSD, ulSectorNumber, blockCnt);
     if (SD_BLOCK_DEVICE_ERROR_NONE != status) {
         return status;
     }
@@ -898,16 +1025,22 @@ int sd_read_blocks(sd_card_t *pSD, uint8_t *buffer, uint64_t ulSectorNumber,
     return status;
 }
 
-static uint8_t sd_write_block(sd_card_t *pSD, const uint8_t *buffer,
-                              uint8_t token, uint32_t length) {
-    uint16_t crc = (~0);
-    uint8_t response = 0xFF;
-
+// Sends the start token and starts the DMA of one data block
+static void sd_write_block_start(sd_card_t *pSD, const uint8_t *buffer,
+                                 uint8_t token, uint32_t length) {
     // indicate start of block
     sd_spi_write(pSD, token);
 
     // write the data
-    bool ret = sd_spi_transfer(pSD, buffer, NULL, length);
+    sd_spi_transfer_start(pSD, buffer, NULL, length);
+}
+// Waits for the DMA, sends the CRC and returns the data response token.
+// The card is busy programming the block until sd_wait_ready() succeeds.
+static uint8_t sd_write_block_finish(sd_card_t *pSD, const uint8_t *buffer,
+                                     uint32_t length) {
+    uint16_t crc = (~0);
+
+    bool ret = sd_spi_transfer_wait_complete(pSD, 1000);
     myASSERT(ret);
 
 #if SD_CRC_ENABLED
@@ -922,41 +1055,28 @@ static uint8_t sd_write_block(sd_card_t *pSD, const uint8_t *buffer,
     sd_spi_write(pSD, crc);
 
     // check the response token
-    response = sd_spi_write(pSD, SPI_FILL_CHAR);
+    return sd_spi_write(pSD, SPI_FILL_CHAR) & SPI_DATA_RESPONSE_MASK;
+}
+static uint8_t sd_write_block(sd_card_t *pSD, const uint8_t *buffer,
+                              uint8_t token, uint32_t length) {
+    sd_write_block_start(pSD, buffer, token, length);
+    uint8_t response = sd_write_block_finish(pSD, buffer, length);
 
     // Wait for last block to be written
     if (false == sd_wait_ready(pSD, SD_COMMAND_TIMEOUT)) {
         DBG_PRINTF("%s:%d: Card not ready yet\r\n", __FILE__, __LINE__);
     }
-    return (response & SPI_DATA_RESPONSE_MASK);
+    return response;
 }
 
-/** Program blocks to a block device
- *
- *
- *  @param buffer       Buffer of data to write to blocks
- *  @param ulSectorNumber     Logical Address of block to begin writing to (LBA)
- *  @param blockCnt     Size to write in blocks
- *  @return         SD_BLOCK_DEVICE_ERROR_NONE(0) - success
- *                  SD_BLOCK_DEVICE_ERROR_NO_DEVICE - device (SD card) is
- * missing or not connected SD_BLOCK_DEVICE_ERROR_CRC - crc error
- *                  SD_BLOCK_DEVICE_ERROR_PARAMETER - invalid parameter
- *                  SD_BLOCK_DEVICE_ERROR_UNSUPPORTED - unsupported command
- *                  SD_BLOCK_DEVICE_ERROR_NO_INIT - device is not initialized
- *                  SD_BLOCK_DEVICE_ERROR_WRITE - SPI write error
- *                  SD_BLOCK_DEVICE_ERROR_ERASE - erase error
- */
-static int in_sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
-                              uint64_t ulSectorNumber, uint32_t blockCnt) {
+// Checks the range and sends CMD24, or ACMD23 and CMD25
+static int sd_write_cmd(sd_card_t *pSD, uint64_t ulSectorNumber, uint32_t blockCnt) {
     if (ulSectorNumber + blockCnt > pSD->sectors)
         return SD_BLOCK_DEVICE_ERROR_PARAMETER;
     if (pSD->m_Status & (STA_NOINIT | STA_NODISK))
         return SD_BLOCK_DEVICE_ERROR_PARAMETER;
 
-    int status = SD_BLOCK_DEVICE_ERROR_NONE;
-    uint8_t response;
     uint64_t addr;
-
     // SDSC Card (CCS=0) uses byte unit address
     // SDHC and SDXC Cards (CCS=1) use block unit address (512 Bytes unit)
     if (SDCARD_V2HC == pSD->card_type) {
@@ -964,43 +1084,22 @@ static int in_sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
     } else {
         addr = ulSectorNumber * _block_size;
     }
-    // Send command to perform write operation
     if (blockCnt == 1) {
         // Single block write command
-        if (SD_BLOCK_DEVICE_ERROR_NONE !=
-            (status = sd_cmd(pSD, CMD24_WRITE_BLOCK, addr, false, 0))) {
-            return status;
-        }
-        // Write data
-        response = sd_write_block(pSD, buffer, SPI_START_BLOCK, _block_size);
-
-        // Only CRC and general write error are communicated via response token
-        if (response != SPI_DATA_ACCEPTED) {
-            DBG_PRINTF("Single Block Write failed: 0x%x \r\n", response);
-            status = SD_BLOCK_DEVICE_ERROR_WRITE;
-        }
-    } else {
-        // Pre-erase setting prior to multiple block write operation
-        sd_cmd(pSD, ACMD23_SET_WR_BLK_ERASE_COUNT, blockCnt, 1, 0);
+        return sd_cmd(pSD, CMD24_WRITE_BLOCK, addr, false, 0);
+    }
+    // Pre-erase setting prior to multiple block write operation
+    sd_cmd(pSD, ACMD23_SET_WR_BLK_ERASE_COUNT, blockCnt, 1, 0);
 
-        // Some SD cards want to be deselected between every bus transaction:
-        sd_spi_deselect_pulse(pSD);
+    // Some SD cards want to be deselected between every bus transaction:
+    sd_spi_deselect_pulse(pSD);
 
-        // Multiple block write command
-        if (SD_BLOCK_DEVICE_ERROR_NONE !=
-            (status = sd_cmd(pSD, CMD25_WRITE_MULTIPLE_BLOCK, addr, false, 0))) {
-            return status;
-        }
-        // Write the data: one block at a time
-        do {
-            response = sd_write_block(pSD, buffer, SPI_START_BLK_MUL_WRITE, _block_size);
-            if (response != SPI_DATA_ACCEPTED) {
-                DBG_PRINTF("Multiple Block Write failed: 0x%x\r\n", response);
-                status = SD_BLOCK_DEVICE_ERROR_WRITE;
-                break;
-            }
-            buffer += _block_size;
-        } while (--blockCnt);  // Send all blocks of data
+    // Multiple block write command
+    return sd_cmd(pSD, CMD25_WRITE_MULTIPLE_BLOCK, addr, false, 0);
+}
+// Ends a write started by sd_write_cmd() and checks the card status
+static int sd_write_stop(sd_card_t *pSD, uint32_t blockCnt) {
+    if (blockCnt > 1) {
         /* In a Multiple Block write operation, the stop transmission will be
          * done by sending 'Stop Tran' token instead of 'Start Block' token at
          * the beginning of the next block
@@ -1010,8 +1109,44 @@ static int in_sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
     uint32_t stat = 0;
     // Some SD cards want to be deselected between every bus transaction:
     sd_spi_deselect_pulse(pSD);
-    status = sd_cmd(pSD, CMD13_SEND_STATUS, 0, false, &stat);
-    return status;
+    return sd_cmd(pSD, CMD13_SEND_STATUS, 0, false, &stat);
+}
+
+/** Program blocks to a block device
+ *
+ *
+ *  @param buffer       Buffer of data to write to blocks
+ *  @param ulSectorNumber     Logical Address of block to begin writing to (LBA)
+ *  @param blockCnt     Size to write in blocks
+ *  @return         SD_BLOCK_DEVICE_ERROR_NONE(0) - success
+ *                  SD_BLOCK_DEVICE_ERROR_NO_DEVICE - device (SD card) is
+ * missing or not connected SD_BLOCK_DEVICE_ERROR_CRC - crc error
+ *                  SD_BLOCK_DEVICE_ERROR_PARAMETER - invalid parameter
+ *                  SD_BLOCK_DEVICE_ERROR_UNSUPPORTED - unsupported command
+ *                  SD_BLOCK_DEVICE_ERROR_NO_INIT - device is not initialized
+ *                  SD_BLOCK_DEVICE_ERROR_WRITE - SPI write error
+ *                  SD_BLOCK_DEVICE_ERROR_ERASE - erase error
+ */
+static int in_sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
+                              uint64_t ulSectorNumber, uint32_t blockCnt) {
+    int status = sd_write_cmd(pSD, ulSectorNumber, blockCnt);
+    if (SD_BLOCK_DEVICE_ERROR_NONE != status) {
+        return status;
+    }
+    uint8_t token = blockCnt > 1 ? SPI_START_BLK_MUL_WRITE : SPI_START_BLOCK;
+    // Write the data: one block at a time
+    for (uint32_t i = 0; i < blockCnt; ++i) {
+        uint8_t response = sd_write_block(pSD, buffer, token, _block_size);
+        // Only CRC and general write error are communicated via response token
+        if (response != SPI_DATA_ACCEPTED) {
+            DBG_PRINTF("Block Write failed: 0x%x\r\n", response);
+            status = SD_BLOCK_DEVICE_ERROR_WRITE;
+            break;
+        }
+        buffer += _block_size;
+    }
+    int stop_status = sd_write_stop(pSD, blockCnt);
+    return status ? status : stop_status;
 }
 
 int sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
@@ -1024,6 +1159,153 @@ int sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
     return status;
 }
 
+// ACMD51, Response R1 + 8-byte block read
+static bool sd_read_scr(sd_card_t *pSD, uint8_t *scr) {
+    if (sd_cmd(pSD, ACMD51_SEND_SCR, 0x0, true, 0) != 0x0) {
+        DBG_PRINTF("Didn't get a response from the disk\r\n");
+        return false;
+    }
+    return sd_read_bytes(pSD, scr, 8) == 0;
+}
+
+#define SD_ERASE_TIMEOUT 30000 /*!< Timeout in ms for an erase (CMD38) to finish */
+
+/** Erase blocks so that they read back as zeros
+ *
+ * Only on SDHC/SDXC, where the erase range is in blocks, and only if the
+ * SCR says erased data is 0 (DATA_STAT_AFTER_ERASE); otherwise the card
+ * is left alone and SD_BLOCK_DEVICE_ERROR_UNSUPPORTED tells the caller
+ * to write the zeros itself.
+ */
+int sd_erase_zeros(sd_card_t *pSD, uint64_t ulSectorNumber, uint64_t blockCnt) {
+    if (!blockCnt || ulSectorNumber + blockCnt > pSD->sectors)
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    if (pSD->m_Status & (STA_NOINIT | STA_NODISK))
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    if (SDCARD_V2HC != pSD->card_type)
+        return SD_BLOCK_DEVICE_ERROR_UNSUPPORTED;
+    sd_acquire(pSD);
+    uint8_t scr[8];
+    int status = SD_BLOCK_DEVICE_ERROR_NONE;
+    if (!sd_read_scr(pSD, scr))
+        status = SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+    else if (scr[1] & 0x80)  // DATA_STAT_AFTER_ERASE: erased blocks read as ones
+        status = SD_BLOCK_DEVICE_ERROR_UNSUPPORTED;
+    if (!status)
+        status = sd_cmd(pSD, CMD32_ERASE_WR_BLK_START_ADDR, ulSectorNumber, false, 0);
+    if (!status)
+        status = sd_cmd(pSD, CMD33_ERASE_WR_BLK_END_ADDR, ulSectorNumber + blockCnt - 1, false, 0);
+    if (!status)
+        status = sd_cmd(pSD, CMD38_ERASE, 0, false, 0);
+    // sd_cmd waited SD_COMMAND_TIMEOUT; a large range can take longer
+    if (!status && !sd_wait_ready(pSD, SD_ERASE_TIMEOUT))
+        status = SD_BLOCK_DEVICE_ERROR_ERASE;
+    sd_release(pSD);
+    return status;
+}
+
+/* Multi-card transfers
+
+The legs run in lockstep: block i is started on every card before any of
+them is waited for, so the DMAs on the different SPIs overlap, and on a
+write all cards program their block while the next one is polled.
+Cards are locked in array order; callers always list the members of a
+volume in the same order, so two transfers cannot deadlock.
+*/
+#define XFER_EACH(i, mask) \
+    for (size_t i = 0; i < n; ++i) if ((mask) & (1u << i))
+
+int sd_write_blocks_multi(sd_xfer_t *xfers, size_t n) {
+    myASSERT(n <= 32);
+    uint32_t open = 0;  // Legs whose write command was accepted
+    for (size_t i = 0; i < n; ++i) {
+        sd_xfer_t *x = &xfers[i];
+        x->status = SD_BLOCK_DEVICE_ERROR_NONE;
+        if (!x->count) continue;
+        sd_acquire(x->pSD);
+        x->status = sd_write_cmd(x->pSD, x->sector, x->count);
+        if (SD_BLOCK_DEVICE_ERROR_NONE == x->status) open |= 1u << i;
+    }
+    for (uint32_t b = 0;; ++b) {
+        uint32_t fed = 0;
+        XFER_EACH(i, open) {
+            sd_xfer_t *x = &xfers[i];
+            if (x->status || b >= x->count) continue;
+            sd_write_block_start(x->pSD, x->block(x, b),
+                                 x->count > 1 ? SPI_START_BLK_MUL_WRITE : SPI_START_BLOCK,
+                                 _block_size);
+            fed |= 1u << i;
+        }
+        if (!fed) break;
+        XFER_EACH(i, fed) {
+            sd_xfer_t *x = &xfers[i];
+            uint8_t response = sd_write_block_finish(x->pSD, x->block(x, b), _block_size);
+            if (response != SPI_DATA_ACCEPTED) {
+                DBG_PRINTF("%s: Block Write failed on %s: 0x%x\r\n",
+                           __FUNCTION__, x->pSD->pcName, response);
+                x->status = SD_BLOCK_DEVICE_ERROR_WRITE;
+            }
+        }
+        XFER_EACH(i, fed) {
+            if (false == sd_wait_ready(xfers[i].pSD, SD_COMMAND_TIMEOUT)) {
+                DBG_PRINTF("%s:%d: Card not ready yet\r\n", __FILE__, __LINE__);
+            }
+        }
+    }
+    XFER_EACH(i, open) {
+        int status = sd_write_stop(xfers[i].pSD, xfers[i].count);
+        if (!xfers[i].status) xfers[i].status = status;
+    }
+    int status = SD_BLOCK_DEVICE_ERROR_NONE;
+    for (size_t i = n; i-- > 0;) {
+        if (!xfers[i].count) continue;
+        sd_release(xfers[i].pSD);
+        if (xfers[i].status) status = xfers[i].status;
+    }
+    return status;
+}
+
+int sd_read_blocks_multi(sd_xfer_t *xfers, size_t n) {
+    myASSERT(n <= 32);
+    uint32_t open = 0;  // Legs whose read command was accepted
+    for (size_t i = 0; i < n; ++i) {
+        sd_xfer_t *x = &xfers[i];
+        x->status = SD_BLOCK_DEVICE_ERROR_NONE;
+        if (!x->count) continue;
+        sd_acquire(x->pSD);
+        x->status = sd_read_cmd(x->pSD, x->sector, x->count);
+        if (SD_BLOCK_DEVICE_ERROR_NONE == x->status) open |= 1u << i;
+    }
+    for (uint32_t b = 0;; ++b) {
+        uint32_t fed = 0;
+        XFER_EACH(i, open) {
+            sd_xfer_t *x = &xfers[i];
+            if (x->status || b >= x->count) continue;
+            x->status = sd_read_block_start(x->pSD, x->block(x, b), _block_size);
+            if (!x->status) fed |= 1u << i;
+        }
+        if (!fed) break;
+        XFER_EACH(i, fed) {
+            sd_xfer_t *x = &xfers[i];
+            x->status = sd_read_block_finish(x->pSD, x->block(x, b), _block_size);
+        }
+    }
+    XFER_EACH(i, open) {
+        // Send CMD12(0x00000000) to stop the transmission for multi-block transfer
+        if (xfers[i].count > 1) {
+            int status = sd_cmd(xfers[i].pSD, CMD12_STOP_TRANSMISSION, 0x0, false, 0);
+            if (!xfers[i].status) xfers[i].status = status;
+        }
+    }
+    int status = SD_BLOCK_DEVICE_ERROR_NONE;
+    for (size_t i = n; i-- > 0;) {
+        if (!xfers[i].count) continue;
+        sd_release(xfers[i].pSD);
+        if (xfers[i].status) status = xfers[i].status;
+    }
+    return status;
+}
+
 static int sd_init_medium(sd_card_t *pSD) {
     int32_t status = SD_BLOCK_DEVICE_ERROR_NONE;
     uint32_t response, arg;
@@ -1087,10 +1369,14 @@ static int sd_init_medium(sd_card_t *pSD) {
      * The host repeatedly issues ACMD41 until this bit is set to "0".
      */
     absolute_time_t timeout_time = make_timeout_time_ms(SD_COMMAND_TIMEOUT);
+    uint32_t start = time_us_32();
+    io_stats.sd_acmd41_polls = 0;
     do {
         status = sd_cmd(pSD, ACMD41_SD_SEND_OP_COND, arg, true, &response);
+        ++io_stats.sd_acmd41_polls;
     } while (response & R1_IDLE_STATE &&
              0 < absolute_time_diff_us(get_absolute_time(), timeout_time));
+    io_stats.sd_acmd41_us = time_us_32() - start;
 
     // Initialization complete: ACMD41 successful
     if ((SD_BLOCK_DEVICE_ERROR_NONE != status) || (0x00 != response)) {
@@ -1098,6 +1384,9 @@ static int sd_init_medium(sd_card_t *pSD) {
         DBG_PRINTF("Timeout waiting for card\r\n");
         return status;
     }
+    // Out of the identification phase: the 400 kHz limit is over, so the
+    // rest of the initialization already runs at the data transfer rate.
+    sd_spi_go_high_frequency(pSD);
 
     if (SDCARD_V2 == pSD->card_type) {
         // Get the card capacity CCS: CMD58
@@ -1139,30 +1428,89 @@ static void sd_ctor(sd_card_t *pSD) {
     pSD->read_blocks = sd_read_blocks;
     pSD->sd_test_com = sd_test_com;
 }
+static sd_card_detect_callback_t cd_callback;
+
+void sd_set_card_detect_callback(sd_card_detect_callback_t callback) {
+    cd_callback = callback;
+}
+
+static bool sd_cd_read(sd_card_t *pSD) {
+    return gpio_get(pSD->card_detect_gpio) == pSD->card_detected_true;
+}
+
+// The card detect line has been quiet for SD_CD_DEBOUNCE_MS
+static int64_t sd_cd_alarm(alarm_id_t id, void *user_data) {
+    sd_card_t *pSD = user_data;
+    pSD->cd_alarm = 0;
+    bool present = sd_cd_read(pSD);
+    if (present != pSD->cd_present) {
+        pSD->cd_present = present;
+        // A card put back in is not the card that was initialized
+        pSD->m_Status |= STA_NOINIT;
+        if (cd_callback) cd_callback(pSD, present);
+    }
+    return 0;
+}
+
+// Every edge on a card detect line restarts its debounce timer
+static void sd_cd_irq_handler(void) {
+    for (size_t i = 0; i < sd_get_num(); ++i) {
+        sd_card_t *pSD = sd_get_by_num(i);
+        if (!pSD->use_card_detect) continue;
+        uint32_t events = gpio_get_irq_event_mask(pSD->card_detect_gpio);
+        if (!events) continue;
+        gpio_acknowledge_irq(pSD->card_detect_gpio, events);
+        if (pSD->cd_alarm) cancel_alarm(pSD->cd_alarm);
+        pSD->cd_alarm = add_alarm_in_ms(SD_CD_DEBOUNCE_MS, sd_cd_alarm, pSD, true);
+        if (pSD->cd_alarm < 0) pSD->cd_alarm = 0;  // No alarm free: next edge retries
+    }
+}
+
+static void sd_card_init_gpio(sd_card_t *pSD) {
+    sd_ctor(pSD);
+
+    if (pSD->use_card_detect) {
+        gpio_init(pSD->card_detect_gpio);
+        gpio_pull_up(pSD->card_detect_gpio);
+        gpio_set_dir(pSD->card_detect_gpio, GPIO_IN);
+        busy_wait_us(10);  // Let the pull-up settle
+        pSD->cd_present = sd_cd_read(pSD);
+        pSD->cd_alarm = 0;
+    }
+    if (pSD->set_drive_strength) {
+        gpio_set_drive_strength(pSD->ss_gpio, pSD->ss_gpio_drive_strength);
+    }
+    // Chip select is active-low, so we'll initialise it to a
+    // driven-high state.
+    gpio_put(pSD->ss_gpio, 1);  // Avoid any glitches when enabling output
+    gpio_init(pSD->ss_gpio);
+    gpio_set_dir(pSD->ss_gpio, GPIO_OUT);
+    gpio_put(pSD->ss_gpio, 1);  // In case set_dir does anything
+}
 bool sd_init_driver() {
     static bool initialized;
     auto_init_mutex(sd_init_driver_mutex);
     mutex_enter_blocking(&sd_init_driver_mutex);
     if (!initialized) {
+        uint32_t cd_mask = 0;  // Card detect GPIOs
         for (size_t i = 0; i < sd_get_num(); ++i) {
             sd_card_t *pSD = sd_get_by_num(i);
-
-            sd_ctor(pSD);
-
-            if (pSD->use_card_detect) {
-                gpio_init(pSD->card_detect_gpio);
-                gpio_pull_up(pSD->card_detect_gpio);
-                gpio_set_dir(pSD->card_detect_gpio, GPIO_IN);
-            }
-            if (pSD->set_drive_strength) {
-                gpio_set_drive_strength(pSD->ss_gpio, pSD->ss_gpio_drive_strength);
+            if (pSD->volume) {
+                // The member cards are not in sd_cards[]: set them up here
+                for (size_t j = 0; j < pSD->volume->n_members; ++j)
+                    sd_card_init_gpio(pSD->volume->members[j]);
+                sd_volume_ctor(pSD);
+            } else {
+                sd_card_init_gpio(pSD);
+                if (pSD->use_card_detect) cd_mask |= 1u << pSD->card_detect_gpio;
             }
-            // Chip select is active-low, so we'll initialise it to a
-            // driven-high state.
-            gpio_put(pSD->ss_gpio, 1);  // Avoid any glitches when enabling output
-            gpio_init(pSD->ss_gpio);
-            gpio_set_dir(pSD->ss_gpio, GPIO_OUT);
-            gpio_put(pSD->ss_gpio, 1);  // In case set_dir does anything
+        }
+        if (cd_mask) {
+            gpio_add_raw_irq_handler_masked(cd_mask, sd_cd_irq_handler);
+            for (uint gpio = 0; gpio < 32; ++gpio)
+                if (cd_mask & (1u << gpio))
+                    gpio_set_irq_enabled(gpio, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
+            irq_set_enabled(IO_IRQ_BANK0, true);
         }
         for (size_t i = 0; i < spi_get_num(); ++i) {
             spi_t *pSPI = spi_get_by_num(i);
@@ -1199,6 +1547,8 @@ static int sd_init(sd_card_t *pSD) {
     }
     // Initialize the member variables
     pSD->card_type = SDCARD_NONE;
+    memset(pSD->cid, 0, sizeof pSD->cid);
+    uint32_t start = time_us_32();
 
     sd_spi_acquire(pSD);
 
@@ -1210,25 +1560,35 @@ static int sd_init(sd_card_t *pSD) {
         return pSD->m_Status;
     }
     DBG_PRINTF("SD card initialized\r\n");
-    pSD->sectors = sd_sectors_nolock(pSD);
-    if (0 == pSD->sectors) {
-        // CMD9 failed
-        sd_spi_release(pSD);
-        sd_unlock(pSD);
-        return pSD->m_Status;
+    // Without a CID the card is still usable, just not cached
+    bool have_cid = sd_read_cid(pSD, pSD->cid);
+    const sd_geometry_t *g = have_cid ? sd_geometry_find(pSD->cid) : NULL;
+    if (g) {
+        pSD->sectors = g->sectors;
+        ++io_stats.sd_geometry_hits;
+    } else {
+        pSD->sectors = sd_sectors_nolock(pSD);
+        if (0 == pSD->sectors) {
+            // CMD9 failed
+            sd_spi_release(pSD);
+            sd_unlock(pSD);
+            return pSD->m_Status;
+        }
+        if (have_cid) sd_geometry_add(pSD->cid, pSD->sectors);
     }
-    // Set block length to 512 (CMD16)
-    if (sd_cmd(pSD, CMD16_SET_BLOCKLEN, _block_size, false, 0) != 0) {
+    // Set block length to 512 (CMD16). SDHC/SDXC blocks are always 512 bytes.
+    if (SDCARD_V2HC != pSD->card_type &&
+        sd_cmd(pSD, CMD16_SET_BLOCKLEN, _block_size, false, 0) != 0) {
         DBG_PRINTF("Set %" PRIu32 "-byte block timed out\r\n", _block_size);
         sd_spi_release(pSD);
         sd_unlock(pSD);
         return pSD->m_Status;
     }
-    // Set SCK for data transfer
-    sd_spi_go_high_frequency(pSD);
+    // SCK was set for data transfer at the end of sd_init_medium
 
     // The card is now initialized
     pSD->m_Status &= ~STA_NOINIT;
+    io_stats.sd_init_us = time_us_32() - start;
 
     sd_spi_release(pSD);
     sd_unlock(pSD);
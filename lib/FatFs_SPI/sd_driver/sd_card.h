@@ -21,6 +21,7 @@ specific language governing permissions and limitations under the License.
 //
 #include "hardware/gpio.h"
 #include "pico/mutex.h"
+#include "pico/time.h"
 //
 #include "ff.h"
 //
@@ -31,6 +32,7 @@ extern "C" {
 #endif
 
 typedef struct sd_card_t sd_card_t;
+typedef struct sd_volume_t sd_volume_t;
 
 // "Class" representing SD Cards
 struct sd_card_t {
@@ -46,14 +48,20 @@ struct sd_card_t {
     // GPIO_DRIVE_STRENGTH_12MA = 3 }
     bool set_drive_strength;
     enum gpio_drive_strength ss_gpio_drive_strength;
+    // If set, this "card" is a logical volume made of other cards
+    // (see sd_volume.h) and spi, ss_gpio and card detect are ignored.
+    sd_volume_t *volume;
 
     // Following fields are used to keep track of the state of the card:
     int m_Status;                                    // Card status
     uint64_t sectors;                                // Assigned dynamically
     int card_type;                                   // Assigned dynamically
+    uint8_t cid[16];                                 // Assigned dynamically
     mutex_t mutex;
     FATFS fatfs;
     bool mounted;
+    volatile bool cd_present;  // Debounced card detect (use_card_detect)
+    alarm_id_t cd_alarm;       // Debounce timer in progress, or 0
 
     int (*init)(sd_card_t *sd_card_p);
     int (*write_blocks)(sd_card_t *sd_card_p, const uint8_t *buffer,
@@ -87,12 +95,41 @@ struct sd_card_t {
 //    STA_PROTECT = 0x04 /* Write protected */
 //};
 
+// One leg of a transfer that runs on several cards at once.
+// The cards must be on different SPIs.
+typedef struct sd_xfer_t sd_xfer_t;
+struct sd_xfer_t {
+    sd_card_t *pSD;
+    uint64_t sector;  // First sector on this card
+    uint32_t count;   // Number of sectors; 0 leaves this card out
+    // Returns the buffer for the i-th sector of this leg
+    uint8_t *(*block)(const sd_xfer_t *xfer, uint32_t i);
+    const void *ctx;  // For use by block()
+    int status;       // Result for this card: SD_BLOCK_DEVICE_ERROR_*
+};
+
 bool sd_card_detect(sd_card_t *pSD);
 uint64_t sd_sectors(sd_card_t *pSD);
+// Transfer every leg, with the block DMAs of all cards running concurrently.
+// Returns the first non-zero leg status.
+int sd_write_blocks_multi(sd_xfer_t *xfers, size_t n);
+int sd_read_blocks_multi(sd_xfer_t *xfers, size_t n);
 
 bool sd_init_driver();
 bool sd_card_detect(sd_card_t *sd_card_p);
 
+// Where FatFs found the FAT volume on this card, remembered by CID across
+// warm resets (see FF_USE_MOUNT_HINT). vsn is the volume serial number.
+bool sd_get_mount_hint(sd_card_t *sd_card_p, uint64_t *sector, uint32_t *vsn);
+void sd_set_mount_hint(sd_card_t *sd_card_p, uint64_t sector, uint32_t vsn);
+int sd_erase_zeros(sd_card_t *sd_card_p, uint64_t ulSectorNumber, uint64_t blockCnt);
+
+// Called (from interrupt context) when a card with use_card_detect is inserted
+// or removed, after the card detect line has been stable for SD_CD_DEBOUNCE_MS
+#define SD_CD_DEBOUNCE_MS 50
+typedef void (*sd_card_detect_callback_t)(sd_card_t *sd_card_p, bool present);
+void sd_set_card_detect_callback(sd_card_detect_callback_t callback);
+
 #ifdef __cplusplus
 }
 #endif
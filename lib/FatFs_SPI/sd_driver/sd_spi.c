@@ -90,6 +90,13 @@ bool sd_spi_transfer(sd_card_t *pSD, const uint8_t *tx, uint8_t *rx,
                      size_t length) {
     return spi_transfer(pSD->spi, tx, rx, length);
 }
+void sd_spi_transfer_start(sd_card_t *pSD, const uint8_t *tx, uint8_t *rx,
+                           size_t length) {
+    spi_transfer_start(pSD->spi, tx, rx, length);
+}
+bool sd_spi_transfer_wait_complete(sd_card_t *pSD, uint32_t timeout_ms) {
+    return spi_transfer_wait_complete(pSD->spi, timeout_ms);
+}
 
 uint8_t sd_spi_write(sd_card_t *pSD, const uint8_t value) {
     // TRACE_PRINTF("%s\n", __FUNCTION__);
@@ -108,12 +115,13 @@ void sd_spi_send_initializing_sequence(sd_card_t * pSD) {
     bool old_ss = gpio_get(pSD->ss_gpio);
     // Set DI and CS high and apply 74 or more clock pulses to SCLK:
     gpio_put(pSD->ss_gpio, 1);
+    // The card must have had power for 1 ms first. It is powered with the
+    // Pico, so that is over except right after boot; a card inserted later
+    // is past it by the time the card detect debounce ends. 80 clocks, once.
+    busy_wait_until(from_us_since_boot(1000));
     uint8_t ones[10];
     memset(ones, 0xFF, sizeof ones);
-    absolute_time_t timeout_time = make_timeout_time_ms(1);
-    do {
-        sd_spi_transfer(pSD, ones, NULL, sizeof ones);
-    } while (0 < absolute_time_diff_us(get_absolute_time(), timeout_time));
+    sd_spi_transfer(pSD, ones, NULL, sizeof ones);
     gpio_put(pSD->ss_gpio, old_ss);
 }
 
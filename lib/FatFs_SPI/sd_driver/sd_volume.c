@@ -0,0 +1,373 @@
+/* sd_volume.c
+Striped or mirrored volume over several SD cards (see sd_volume.h).
+*/
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+//
+#include "pico/stdlib.h"
+//
+#include "crc.h"
+#include "my_debug.h"
+#include "sd_card.h"
+#include "sd_volume.h"
+//
+#include "ff.h" /* Obtains integer types */
+//
+#include "diskio.h" /* Declarations of disk functions */  // Needed for STA_NOINIT, ...
+
+#define TRACE_PRINTF(fmt, args...)
+//#define TRACE_PRINTF printf  // task_printf
+
+#define BLOCK_SIZE 512
+
+/* Mirror label, in the last sector of each member */
+
+#define MIRROR_LABEL_MAGIC 0x4C524D53  // "SMRL"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t id;          // Same on every member of one mirror
+    uint32_t generation;  // Raised on the members in use whenever one is missing
+    uint32_t crc;         // crc32 of the fields above
+} mirror_label_t;
+
+static uint8_t label_buf[BLOCK_SIZE] __attribute__((aligned(4)));
+
+static bool label_read(sd_card_t *m, mirror_label_t *l) {
+    if (SD_BLOCK_DEVICE_ERROR_NONE != m->read_blocks(m, label_buf, m->sectors - 1, 1))
+        return false;
+    memcpy(l, label_buf, sizeof *l);
+    return MIRROR_LABEL_MAGIC == l->magic && l->crc == crc32(l, offsetof(mirror_label_t, crc));
+}
+
+static bool label_write(sd_volume_t *v, size_t i) {
+    sd_card_t *m = v->members[i];
+    mirror_label_t l = {MIRROR_LABEL_MAGIC, v->id, v->generation, 0};
+    l.crc = crc32(&l, offsetof(mirror_label_t, crc));
+    memset(label_buf, 0, sizeof label_buf);
+    memcpy(label_buf, &l, sizeof l);
+    if (SD_BLOCK_DEVICE_ERROR_NONE == m->write_blocks(m, label_buf, m->sectors - 1, 1))
+        return true;
+    ++v->errors[i];
+    return false;
+}
+
+// A new generation on the members in use: the ones left out become stale
+static void mirror_new_generation(sd_volume_t *v) {
+    ++v->generation;
+    for (size_t i = 0; i < v->n_members; ++i)
+        if (!(v->degraded & (1u << i))) label_write(v, i);
+}
+
+// Reads the labels of the members that came up and leaves out the stale ones
+static void mirror_check_labels(sd_card_t *pSD, uint32_t up) {
+    sd_volume_t *v = pSD->volume;
+    mirror_label_t labels[SD_VOLUME_MAX_MEMBERS];
+    uint32_t valid = 0;
+    int newest = -1;
+    for (size_t i = 0; i < v->n_members; ++i) {
+        if (!(up & (1u << i)) || !label_read(v->members[i], &labels[i])) continue;
+        valid |= 1u << i;
+        if (newest < 0 || labels[i].generation > labels[newest].generation) newest = i;
+    }
+    v->stale = 0;
+    if (newest < 0) {
+        // A new mirror: label every member that is there
+        v->id = time_us_32() ^ (uint32_t)v->members[0]->sectors;
+        v->generation = 0;
+    } else {
+        v->id = labels[newest].id;
+        v->generation = labels[newest].generation;
+        for (size_t i = 0; i < v->n_members; ++i) {
+            if (!(up & (1u << i))) continue;
+            if (!(valid & (1u << i)) || labels[i].id != v->id ||
+                labels[i].generation != v->generation) {
+                printf("Volume %s: %s missed writes; run resync before using it\n",
+                       pSD->pcName, v->members[i]->pcName);
+                v->stale |= 1u << i;
+            }
+        }
+        // Stale members already hold an older generation: only a missing one
+        // needs a new generation to be left behind
+        if (!(v->degraded & ~v->stale)) {
+            v->degraded |= v->stale;
+            return;
+        }
+        v->degraded |= v->stale;
+    }
+    mirror_new_generation(v);
+}
+
+static int vol_init(sd_card_t *pSD) {
+    TRACE_PRINTF("> %s\r\n", __FUNCTION__);
+    sd_volume_t *v = pSD->volume;
+
+    // Make sure we're not already initialized before proceeding
+    if (!(pSD->m_Status & STA_NOINIT)) return pSD->m_Status;
+
+    uint64_t sectors = UINT64_MAX;
+    size_t up = 0;
+    uint32_t up_mask = 0;
+    v->degraded = 0;
+    for (size_t i = 0; i < v->n_members; ++i) {
+        sd_card_t *m = v->members[i];
+        for (size_t j = 0; j < i; ++j)
+            myASSERT(v->members[j]->spi != m->spi);
+        // Start over: a card may have been swapped while unmounted
+        m->m_Status |= STA_NOINIT;
+        if (m->init(m) & (STA_NOINIT | STA_NODISK)) {
+            DBG_PRINTF("%s: %s failed to initialize\r\n", __FUNCTION__, m->pcName);
+            v->degraded |= 1u << i;
+            continue;
+        }
+        if (m->sectors < sectors) sectors = m->sectors;
+        ++up;
+        up_mask |= 1u << i;
+    }
+    switch (v->mode) {
+        case SD_VOLUME_STRIPE:
+            // Every member holds every n-th chunk: all of them are needed
+            if (up < v->n_members) return pSD->m_Status;
+            sectors = sectors / v->stripe_sectors * v->stripe_sectors * v->n_members;
+            break;
+        case SD_VOLUME_MIRROR:
+            if (!up) return pSD->m_Status;
+            mirror_check_labels(pSD, up_mask);
+            --sectors;  // The label
+            break;
+    }
+    pSD->sectors = sectors;
+    pSD->m_Status &= ~STA_NOINIT;
+    return pSD->m_Status;
+}
+
+// Counts the failed legs of a transfer
+static void count_errors(sd_volume_t *v, const sd_xfer_t *xfers) {
+    for (size_t i = 0; i < v->n_members; ++i)
+        if (xfers[i].count && xfers[i].status) ++v->errors[i];
+}
+
+/* STRIPE */
+
+typedef struct {
+    const sd_volume_t *v;
+    uint8_t *buffer;
+    uint64_t sector;  // First volume sector of the request
+    size_t member;
+} stripe_leg_t;
+
+static uint8_t *stripe_block(const sd_xfer_t *x, uint32_t i) {
+    const stripe_leg_t *leg = x->ctx;
+    const uint32_t chunk = leg->v->stripe_sectors;
+    uint64_t card_sector = x->sector + i;
+    uint64_t sector = (card_sector / chunk * leg->v->n_members + leg->member) * chunk +
+                      card_sector % chunk;
+    return leg->buffer + (sector - leg->sector) * BLOCK_SIZE;
+}
+
+static int stripe_xfer(sd_card_t *pSD, uint8_t *buffer, uint64_t ulSectorNumber,
+                       uint32_t blockCnt, bool write) {
+    sd_volume_t *v = pSD->volume;
+    if (ulSectorNumber + blockCnt > pSD->sectors)
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    if (pSD->m_Status & (STA_NOINIT | STA_NODISK))
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+
+    const size_t n = v->n_members;
+    const uint32_t chunk = v->stripe_sectors;
+    sd_xfer_t xfers[SD_VOLUME_MAX_MEMBERS] = {0};
+    stripe_leg_t legs[SD_VOLUME_MAX_MEMBERS];
+    for (size_t i = 0; i < n; ++i) {
+        legs[i] = (stripe_leg_t){v, buffer, ulSectorNumber, i};
+        xfers[i].pSD = v->members[i];
+        xfers[i].block = stripe_block;
+        xfers[i].ctx = &legs[i];
+    }
+    // The chunks of one member are consecutive on its card, so each member
+    // gets a single run of sectors.
+    const uint64_t end = ulSectorNumber + blockCnt;
+    for (uint64_t c = ulSectorNumber / chunk; c * chunk < end; ++c) {
+        sd_xfer_t *x = &xfers[c % n];
+        uint64_t lo = c * chunk > ulSectorNumber ? c * chunk : ulSectorNumber;
+        uint64_t hi = (c + 1) * chunk < end ? (c + 1) * chunk : end;
+        if (!x->count) x->sector = c / n * chunk + lo % chunk;
+        x->count += hi - lo;
+    }
+    int status = write ? sd_write_blocks_multi(xfers, n) : sd_read_blocks_multi(xfers, n);
+    count_errors(v, xfers);
+    return status;
+}
+
+static int stripe_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
+                               uint64_t ulSectorNumber, uint32_t blockCnt) {
+    // Only read from on a write
+    return stripe_xfer(pSD, (uint8_t *)buffer, ulSectorNumber, blockCnt, true);
+}
+static int stripe_read_blocks(sd_card_t *pSD, uint8_t *buffer,
+                              uint64_t ulSectorNumber, uint32_t ulSectorCount) {
+    return stripe_xfer(pSD, buffer, ulSectorNumber, ulSectorCount, false);
+}
+
+/* MIRROR */
+
+static uint8_t *mirror_block(const sd_xfer_t *x, uint32_t i) {
+    return (uint8_t *)x->ctx + i * BLOCK_SIZE;
+}
+
+// Drops member i from the mirror, unless it is the last one left
+static bool mirror_drop(sd_card_t *pSD, size_t i) {
+    sd_volume_t *v = pSD->volume;
+    uint32_t all = (1u << v->n_members) - 1;
+    if ((v->degraded | (1u << i)) == all) return false;
+    v->degraded |= 1u << i;
+    printf("Volume %s: %s dropped from the mirror\n", pSD->pcName, v->members[i]->pcName);
+    // Recorded on the cards that remain, so the dropped one is stale if it comes back
+    mirror_new_generation(v);
+    return true;
+}
+
+static int mirror_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
+                               uint64_t ulSectorNumber, uint32_t blockCnt) {
+    sd_volume_t *v = pSD->volume;
+    if (ulSectorNumber + blockCnt > pSD->sectors)
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    if (pSD->m_Status & (STA_NOINIT | STA_NODISK))
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+
+    sd_xfer_t xfers[SD_VOLUME_MAX_MEMBERS] = {0};
+    for (size_t i = 0; i < v->n_members; ++i) {
+        if (v->degraded & (1u << i)) continue;
+        xfers[i] = (sd_xfer_t){.pSD = v->members[i],
+                               .sector = ulSectorNumber,
+                               .count = blockCnt,
+                               .block = mirror_block,
+                               .ctx = buffer};
+    }
+    int status = sd_write_blocks_multi(xfers, v->n_members);
+    if (SD_BLOCK_DEVICE_ERROR_NONE == status) return status;
+    count_errors(v, xfers);
+    // The write still succeeded if some member took it
+    bool ok = false;
+    for (size_t i = 0; i < v->n_members; ++i)
+        if (xfers[i].count && !xfers[i].status) ok = true;
+    if (!ok) return status;
+    for (size_t i = 0; i < v->n_members; ++i)
+        if (xfers[i].count && xfers[i].status) mirror_drop(pSD, i);
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+static int mirror_read_blocks(sd_card_t *pSD, uint8_t *buffer,
+                              uint64_t ulSectorNumber, uint32_t ulSectorCount) {
+    sd_volume_t *v = pSD->volume;
+    if (ulSectorNumber + ulSectorCount > pSD->sectors)
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    if (pSD->m_Status & (STA_NOINIT | STA_NODISK))
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+
+    int status = SD_BLOCK_DEVICE_ERROR_NO_DEVICE;
+    for (size_t i = 0; i < v->n_members; ++i) {
+        if (v->degraded & (1u << i)) continue;
+        sd_card_t *m = v->members[i];
+        status = m->read_blocks(m, buffer, ulSectorNumber, ulSectorCount);
+        if (SD_BLOCK_DEVICE_ERROR_NONE == status) break;
+        ++v->errors[i];
+        if (!mirror_drop(pSD, i)) break;
+    }
+    return status;
+}
+
+static bool vol_test_com(sd_card_t *pSD) {
+    sd_volume_t *v = pSD->volume;
+    bool success = true;
+    for (size_t i = 0; i < v->n_members; ++i) {
+        if (v->degraded & (1u << i)) continue;
+        sd_card_t *m = v->members[i];
+        if (!m->sd_test_com(m)) success = false;
+    }
+    return success;
+}
+
+void sd_volume_ctor(sd_card_t *pSD) {
+    sd_volume_t *v = pSD->volume;
+    myASSERT(v->n_members && v->n_members <= SD_VOLUME_MAX_MEMBERS);
+    myASSERT(SD_VOLUME_MIRROR == v->mode || v->stripe_sectors);
+    // State variables:
+    pSD->m_Status = STA_NOINIT;
+    pSD->init = vol_init;
+    if (SD_VOLUME_STRIPE == v->mode) {
+        pSD->write_blocks = stripe_write_blocks;
+        pSD->read_blocks = stripe_read_blocks;
+    } else {
+        pSD->write_blocks = mirror_write_blocks;
+        pSD->read_blocks = mirror_read_blocks;
+    }
+    pSD->sd_test_com = vol_test_com;
+}
+
+int sd_volume_resync(sd_card_t *pSD, uint8_t *buf, size_t size) {
+    sd_volume_t *v = pSD->volume;
+    if (!v || SD_VOLUME_MIRROR != v->mode || size < BLOCK_SIZE)
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    // Fresh look at the cards and their labels
+    pSD->m_Status |= STA_NOINIT;
+    if (vol_init(pSD) & STA_NOINIT) return SD_BLOCK_DEVICE_ERROR_NO_DEVICE;
+    if (!v->stale) {
+        printf("Volume %s: members in sync\n", pSD->pcName);
+        return SD_BLOCK_DEVICE_ERROR_NONE;
+    }
+    size_t from = 0;
+    while (v->degraded & (1u << from)) ++from;
+    sd_card_t *src = v->members[from];
+    const uint32_t chunk = size / BLOCK_SIZE;
+    int status = SD_BLOCK_DEVICE_ERROR_NONE;
+    for (size_t i = 0; i < v->n_members; ++i) {
+        if (!(v->stale & (1u << i))) continue;
+        sd_card_t *m = v->members[i];
+        printf("Volume %s: copying %s to %s (%" PRIu64 " sectors)\n", pSD->pcName,
+               src->pcName, m->pcName, pSD->sectors);
+        unsigned pct = 0;
+        for (uint64_t s = 0; s < pSD->sectors && SD_BLOCK_DEVICE_ERROR_NONE == status; s += chunk) {
+            uint32_t n = pSD->sectors - s < chunk ? pSD->sectors - s : chunk;
+            status = src->read_blocks(src, buf, s, n);
+            if (SD_BLOCK_DEVICE_ERROR_NONE == status) status = m->write_blocks(m, buf, s, n);
+            if ((s + n) * 100 / pSD->sectors >= pct + 10) {
+                pct = (s + n) * 100 / pSD->sectors;
+                printf("  %u%%\n", pct);
+            }
+        }
+        // The label goes last: an interrupted copy leaves the member stale
+        if (SD_BLOCK_DEVICE_ERROR_NONE != status || !label_write(v, i)) {
+            printf("Volume %s: resync of %s failed (%d)\n", pSD->pcName, m->pcName, status);
+            if (SD_BLOCK_DEVICE_ERROR_NONE == status) status = SD_BLOCK_DEVICE_ERROR_WRITE;
+            break;
+        }
+        v->stale &= ~(1u << i);
+        v->degraded &= ~(1u << i);
+    }
+    pSD->m_Status |= STA_NOINIT;  // Mounting checks the labels again
+    return status;
+}
+
+void sd_volume_print(const sd_card_t *pSD) {
+    const sd_volume_t *v = pSD->volume;
+    if (!v) return;
+    if (SD_VOLUME_STRIPE == v->mode)
+        printf("Volume %s: stripe, %lu-sector chunks", pSD->pcName, v->stripe_sectors);
+    else
+        printf("Volume %s: mirror, generation %lu%s", pSD->pcName, v->generation,
+               v->degraded ? " (degraded)" : "");
+    if (pSD->m_Status & STA_NOINIT)
+        printf(", not initialized\n");
+    else
+        printf(", %" PRIu64 " sectors\n", pSD->sectors);
+    for (size_t i = 0; i < v->n_members; ++i) {
+        const sd_card_t *m = v->members[i];
+        printf("  %-4s %" PRIu64 " sectors, %lu errors%s\n", m->pcName, m->sectors,
+               v->errors[i],
+               v->stale & (1u << i) ? ", stale (resync)" : v->degraded & (1u << i) ? ", dropped" : "");
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,66 @@
+/* sd_volume.h
+Logical volume made of several SD cards, presented to FatFs as one drive.
+
+STRIPE: the volume is cut in chunks of stripe_sectors sectors, dealt to the
+members in turn. Chunk c goes to member c % n at chunk c / n of that card, so
+a long sequential write becomes one sequential write on each card, and the
+cards receive their blocks at the same time.
+
+MIRROR: every write goes to all members at once; reads come from the first
+member that works. A member that fails is dropped (the volume is "degraded")
+until the volume is initialized again.
+
+The last sector of each mirror member is kept out of the volume and holds a
+label: the mirror's id and a generation number. Whenever the volume runs
+without a member (dropped, or missing at init), the generation is raised on
+the members that remain. At init, a member whose label is missing, belongs to
+another mirror or has an older generation has missed writes: it is "stale",
+left out of reads and writes until sd_volume_resync copies a good member over
+it.
+
+Each member must be on its own SPI, so that their DMAs can run concurrently.
+*/
+
+#pragma once
+
+#include <stdint.h>
+//
+#include "sd_card.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SD_VOLUME_MAX_MEMBERS 2  // One card per SPI
+
+typedef enum {
+    SD_VOLUME_STRIPE,
+    SD_VOLUME_MIRROR
+} sd_volume_mode_t;
+
+struct sd_volume_t {
+    sd_volume_mode_t mode;
+    uint32_t stripe_sectors;  // Chunk size for SD_VOLUME_STRIPE
+    size_t n_members;
+    sd_card_t *members[SD_VOLUME_MAX_MEMBERS];
+
+    // State variables:
+    uint32_t degraded;  // SD_VOLUME_MIRROR: bit i set if member i was dropped
+    uint32_t stale;     // SD_VOLUME_MIRROR: bit i set if member i needs a resync (also in degraded)
+    uint32_t id;        // SD_VOLUME_MIRROR: label of the members in use
+    uint32_t generation;
+    uint32_t errors[SD_VOLUME_MAX_MEMBERS];  // Failed transfers per member
+};
+
+// Sets up the "card" functions of a volume (called by sd_init_driver)
+void sd_volume_ctor(sd_card_t *pSD);
+void sd_volume_print(const sd_card_t *pSD);
+// Copies an up-to-date member of a mirror over its stale members, using buf
+// (a multiple of 512 bytes) for the transfers. The volume must not be mounted.
+int sd_volume_resync(sd_card_t *pSD, uint8_t *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* [] END OF FILE */
@@ -21,6 +21,8 @@ specific language governing permissions and limitations under the License.
 //
 #include "my_debug.h"
 #include "hw_config.h"
+#include "io_stats.h"
+#include "sd_trace.h"
 //
 #include "spi.h"
 
@@ -54,16 +56,27 @@ void set_spi_dma_irq_channel(bool useChannel1, bool shared) {
     irqShared = shared;
 }
 
-// SPI Transfer: Read & Write (simultaneously) on SPI bus
+// Starts a DMA transfer on the SPI bus and returns without waiting for it.
 //   If the data that will be received is not important, pass NULL as rx.
 //   If the data that will be transmitted is not important,
 //     pass NULL as tx and then the SPI_FILL_CHAR is sent out as each data
 //     element.
-bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
+// Each SPI has its own DMA channels, so transfers on different buses can run
+// at the same time. Finish with spi_transfer_wait_complete().
+void spi_transfer_start(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
     // assert(512 == length || 1 == length);
     assert(tx || rx);
     // assert(!(tx && rx));
 
+    if (1 == length) {
+        ++io_stats.spi_byte_xfers;
+    } else {
+        ++io_stats.spi_block_xfers;
+        sd_trace_begin(SD_TR_DMA, length);
+    }
+    io_stats.spi_bytes += length;
+    spi_p->xfer_length = length;
+
     // tx write increment is already false
     if (tx) {
         channel_config_set_read_increment(&spi_p->tx_dma_cfg, true);
@@ -110,13 +123,19 @@ bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
     // start them exactly simultaneously to avoid races (in extreme cases
     // the FIFO could overflow)
     dma_start_channel_mask((1u << spi_p->tx_dma) | (1u << spi_p->rx_dma));
+}
+
+// Waits for the transfer started by spi_transfer_start()
+bool spi_transfer_wait_complete(spi_t *spi_p, uint32_t timeout_ms) {
+    size_t length = spi_p->xfer_length;
 
     /* Wait until master completes transfer or time out has occured. */
-    uint32_t timeOut = 1000; /* Timeout 1 sec */
     bool rc = sem_acquire_timeout_ms(
-        &spi_p->sem, timeOut);  // Wait for notification from ISR
+        &spi_p->sem, timeout_ms);  // Wait for notification from ISR
     if (!rc) {
         // If the timeout is reached the function will return false
+        ++io_stats.spi_timeouts;
+        if (1 != length) sd_trace_end(SD_TR_DMA, 0);
         DBG_PRINTF("Notification wait timed out in %s\n", __FUNCTION__);
         return false;
     }
@@ -128,9 +147,16 @@ bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
     assert(!dma_channel_is_busy(spi_p->tx_dma));
     assert(!dma_channel_is_busy(spi_p->rx_dma));
 
+    if (1 != length) sd_trace_end(SD_TR_DMA, length);
     return true;
 }
 
+// SPI Transfer: Read & Write (simultaneously) on SPI bus
+bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
+    spi_transfer_start(spi_p, tx, rx, length);
+    return spi_transfer_wait_complete(spi_p, 1000); /* Timeout 1 sec */
+}
+
 void spi_lock(spi_t *spi_p) {
     assert(mutex_is_initialized(&spi_p->mutex));
     mutex_enter_blocking(&spi_p->mutex);
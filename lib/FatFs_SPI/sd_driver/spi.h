@@ -53,6 +53,7 @@ typedef struct {
     bool initialized;  
     semaphore_t sem;
     mutex_t mutex;    
+    size_t xfer_length; // Length of the transfer in progress
 } spi_t;
 
 #ifdef __cplusplus
@@ -60,6 +61,8 @@ extern "C" {
 #endif
   
 bool __not_in_flash_func(spi_transfer)(spi_t *pSPI, const uint8_t *tx, uint8_t *rx, size_t length);  
+void spi_transfer_start(spi_t *pSPI, const uint8_t *tx, uint8_t *rx, size_t length);
+bool spi_transfer_wait_complete(spi_t *pSPI, uint32_t timeout_ms);
 void spi_lock(spi_t *pSPI);
 void spi_unlock(spi_t *pSPI);
 bool my_spi_init(spi_t *pSPI);
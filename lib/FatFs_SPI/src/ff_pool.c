@@ -0,0 +1,55 @@
+/* ff_pool.c
+Fixed-size block pools (see ff_pool.h).
+*/
+#include <stdio.h>
+//
+#include "hardware/sync.h"
+//
+#include "my_debug.h"
+//
+#include "ff_pool.h"
+
+static inline spin_lock_t *pool_lock(void) {
+    return spin_lock_instance(PICO_SPINLOCK_ID_OS1);
+}
+
+void *ff_pool_alloc(ff_pool_t *pool) {
+    void *block = NULL;
+    uint32_t save = spin_lock_blocking(pool_lock());
+    if (pool->free_list) {
+        block = pool->free_list;
+        pool->free_list = *(void **)block;
+    } else if (pool->carved < pool->n_blocks) {
+        block = pool->storage + pool->carved++ * pool->block_size;
+    }
+    if (block) {
+        if (++pool->used > pool->peak) pool->peak = pool->used;
+    } else {
+        ++pool->fails;
+    }
+    spin_unlock(pool_lock(), save);
+    return block;
+}
+
+void ff_pool_free(ff_pool_t *pool, void *block) {
+    if (!block) return;
+    myASSERT(ff_pool_owns(pool, block));
+    myASSERT(0 == ((uint8_t *)block - pool->storage) % pool->block_size);
+    uint32_t save = spin_lock_blocking(pool_lock());
+    *(void **)block = pool->free_list;
+    pool->free_list = block;
+    --pool->used;
+    spin_unlock(pool_lock(), save);
+}
+
+void ff_pool_print(const ff_pool_t *pool) {
+    printf("%-12s %lu x %u bytes: in use %lu, peak %lu, refused %lu\n", pool->name,
+           (uint32_t)pool->n_blocks, pool->block_size, pool->used, pool->peak, pool->fails);
+}
+
+void ff_pool_print_all(void) {
+    ff_pool_print(&ff_pool_lfn);
+    ff_pool_print(&ff_pool_fil);
+}
+
+/* [] END OF FILE */
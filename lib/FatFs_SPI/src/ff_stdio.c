@@ -22,11 +22,19 @@ specific language governing permissions and limitations under the License.
 #include "my_debug.h"
 //
 #include "f_util.h"
+#include "ff_pool.h"
 #include "ff_stdio.h"
 
 #define TRACE_PRINTF(fmt, args...) {}
 //#define TRACE_PRINTF printf
 
+// A FIL for every file FatFs lets be open at once (FF_FS_LOCK)
+#if FF_FS_LOCK
+FF_POOL_DEFINE(ff_pool_fil, sizeof(FIL), FF_FS_LOCK);
+#else
+FF_POOL_DEFINE(ff_pool_fil, sizeof(FIL), 4);
+#endif
+
 static BYTE posix2mode(const char *pcMode) {
     if (0 == strcmp("r", pcMode)) return FA_READ;
     if (0 == strcmp("r+", pcMode)) return FA_READ | FA_WRITE;
@@ -94,16 +102,16 @@ FF_FILE *ff_fopen(const char *pcFile, const char *pcMode) {
     //  const TCHAR* path, /* [IN] File name */
     //  BYTE mode          /* [IN] Mode flags */
     //);
-    FIL *fp = malloc(sizeof(FIL));
+    FIL *fp = ff_pool_alloc(&ff_pool_fil);
     if (!fp) {
-        errno = ENOMEM;
+        errno = ENFILE;
         return NULL;
     }
     FRESULT fr = f_open(fp, pcFile, posix2mode(pcMode));
     errno = fresult2errno(fr);
     if (FR_OK != fr) {
         TRACE_PRINTF("%s error: %s (%d)\n", __func__, FRESULT_str(fr), fr);
-        free(fp);
+        ff_pool_free(&ff_pool_fil, fp);
         fp = 0;
     }
     return fp;
@@ -117,7 +125,7 @@ int ff_fclose(FF_FILE *pxStream) {
     if (FR_OK != fr)
         TRACE_PRINTF("%s error: %s (%d)\n", __func__, FRESULT_str(fr), fr);
     errno = fresult2errno(fr);
-    free(pxStream);
+    ff_pool_free(&ff_pool_fil, pxStream);
     if (FR_OK == fr)
         return 0;
     else
@@ -387,18 +395,29 @@ int ff_findnext(FF_FindData_t *pxFindData) {
         return -1;
     }
 }
+// Gives back the FIL of a failed ff_truncate, keeping its errno
+static FF_FILE *truncate_fail(FIL *fp) {
+    int error = errno;
+    f_close(fp);
+    ff_pool_free(&ff_pool_fil, fp);
+    errno = error;
+    return NULL;
+}
 FF_FILE *ff_truncate(const char *pcFileName, long lTruncateSize) {
     TRACE_PRINTF("%s\n", __func__);
-    FIL *fp = malloc(sizeof(FIL));
+    FIL *fp = ff_pool_alloc(&ff_pool_fil);
     if (!fp) {
-        errno = ENOMEM;
+        errno = ENFILE;
         return NULL;
     }
     FRESULT fr = f_open(fp, pcFileName, FA_OPEN_APPEND | FA_WRITE);
     if (FR_OK != fr)
         printf("%s: f_open error: %s (%d)\n", __func__, FRESULT_str(fr), fr);
     errno = fresult2errno(fr);
-    if (FR_OK != fr) return NULL;
+    if (FR_OK != fr) {
+        ff_pool_free(&ff_pool_fil, fp);
+        return NULL;
+    }
     while (f_tell(fp) < (FSIZE_t)lTruncateSize) {
         UINT bw = 0;
         char c = 0;
@@ -406,13 +425,13 @@ FF_FILE *ff_truncate(const char *pcFileName, long lTruncateSize) {
         if (FR_OK != fr)
             TRACE_PRINTF("%s error: %s (%d)\n", __func__, FRESULT_str(fr), fr);
         errno = fresult2errno(fr);
-        if (1 != bw) return NULL;
+        if (1 != bw) return truncate_fail(fp);
     }
     fr = f_lseek(fp, lTruncateSize);
     errno = fresult2errno(fr);
     if (FR_OK != fr)
         printf("%s: f_lseek error: %s (%d)\n", __func__, FRESULT_str(fr), fr);
-    if (FR_OK != fr) return NULL;
+    if (FR_OK != fr) return truncate_fail(fp);
     fr = f_truncate(fp);
     if (FR_OK != fr)
         printf("%s: f_truncate error: %s (%d)\n", __func__, FRESULT_str(fr),
@@ -421,7 +440,7 @@ FF_FILE *ff_truncate(const char *pcFileName, long lTruncateSize) {
     if (FR_OK == fr)
         return fp;
     else
-        return NULL;
+        return truncate_fail(fp);
 }
 int ff_seteof(FF_FILE *pxStream) {
     TRACE_PRINTF("%s\n", __func__);
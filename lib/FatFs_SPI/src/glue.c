@@ -21,13 +21,17 @@ specific language governing permissions and limitations under the License.
 /*-----------------------------------------------------------------------*/
 #include <stdio.h>
 //
+#include "pico/stdlib.h"
+//
 #include "ff.h" /* Obtains integer types */
 //
 #include "diskio.h" /* Declarations of disk functions */
 //
 #include "hw_config.h"
+#include "io_stats.h"
 #include "my_debug.h"
 #include "sd_card.h"
+#include "sd_trace.h"
 
 #define TRACE_PRINTF(fmt, args...)
 //#define TRACE_PRINTF printf  // task_printf
@@ -98,8 +102,15 @@ DRESULT disk_read(BYTE pdrv,  /* Physical drive nmuber to identify the drive */
     TRACE_PRINTF(">>> %s\n", __FUNCTION__);
     sd_card_t *p_sd = sd_get_by_num(pdrv);
     if (!p_sd) return RES_PARERR;
+    uint32_t start = time_us_32();
+    sd_trace_begin(SD_TR_DISK_READ, count);
     int rc = p_sd->read_blocks(p_sd, buff, sector, count);
-    return sdrc2dresult(rc);
+    io_hist_add(&io_stats.disk_read, time_us_32() - start);
+    io_sect_add(io_stats.disk_read_sect, count);
+    if (rc) ++io_stats.disk_errors;
+    DRESULT dr = sdrc2dresult(rc);
+    sd_trace_end(SD_TR_DISK_READ, dr);
+    return dr;
 }
 
 /*-----------------------------------------------------------------------*/
@@ -116,8 +127,15 @@ DRESULT disk_write(BYTE pdrv, /* Physical drive nmuber to identify the drive */
     TRACE_PRINTF(">>> %s\n", __FUNCTION__);
     sd_card_t *p_sd = sd_get_by_num(pdrv);
     if (!p_sd) return RES_PARERR;
+    uint32_t start = time_us_32();
+    sd_trace_begin(SD_TR_DISK_WRITE, count);
     int rc = p_sd->write_blocks(p_sd, buff, sector, count);
-    return sdrc2dresult(rc);
+    io_hist_add(&io_stats.disk_write, time_us_32() - start);
+    io_sect_add(io_stats.disk_write_sect, count);
+    if (rc) ++io_stats.disk_errors;
+    DRESULT dr = sdrc2dresult(rc);
+    sd_trace_end(SD_TR_DISK_WRITE, dr);
+    return dr;
 }
 
 #endif
@@ -162,6 +180,32 @@ DRESULT disk_ioctl(BYTE pdrv, /* Physical drive nmuber (0..) */
         }
         case CTRL_SYNC:
             return RES_OK;
+#if FF_USE_MOUNT_HINT
+        case GET_MOUNT_HINT: {  // Where f_mount found the volume on this card
+                                // before, into the MOUNT_HINT pointed by buff.
+            MOUNT_HINT *hint = buff;
+            uint64_t sector;
+            uint32_t vsn;
+            if (!sd_get_mount_hint(p_sd, &sector, &vsn)) return RES_ERROR;
+            hint->sect = sector;
+            hint->vsn = vsn;
+            return RES_OK;
+        }
+        case SET_MOUNT_HINT: {
+            const MOUNT_HINT *hint = buff;
+            sd_set_mount_hint(p_sd, hint->sect, hint->vsn);
+            return RES_OK;
+        }
+#endif
+        case CTRL_ERASE_ZEROS: {  // Erases the sectors lba[0]..lba[1] so that
+                                  // they read back as zeros; f_mkfs with
+                                  // FM_ERASE then skips writing zeros there.
+            const LBA_t *lba = buff;
+            if (p_sd->volume || lba[1] < lba[0]) return RES_PARERR;
+            int rc = sd_erase_zeros(p_sd, lba[0], lba[1] - lba[0] + 1);
+            if (SD_BLOCK_DEVICE_ERROR_UNSUPPORTED == rc) return RES_PARERR;
+            return rc ? RES_ERROR : RES_OK;
+        }
         default:
             return RES_PARERR;
     }
@@ -0,0 +1,121 @@
+/* io_stats.c
+Storage and printing of the I/O counters (see io_stats.h).
+*/
+#include <stdio.h>
+#include <string.h>
+//
+#include "io_stats.h"
+
+io_stats_t io_stats;
+
+void io_stats_reset(void) {
+    memset(&io_stats, 0, sizeof io_stats);
+}
+
+static void print_hist(const char *name, const io_hist_t *h) {
+    printf("%-14s n=%lu avg=%lu us max=%lu us\n", name, h->count,
+           h->count ? (uint32_t)(h->total_us / h->count) : 0, h->max_us);
+    if (!h->count) return;
+    for (size_t i = 0; i < IO_HIST_BUCKETS; ++i) {
+        if (!h->hist[i]) continue;
+        if (!i)
+            printf("    %10s us: %lu\n", "0", h->hist[i]);
+        else
+            printf("    %4lu..%-5lu us: %lu\n", 1ul << (i - 1), (1ul << i) - 1, h->hist[i]);
+    }
+}
+
+static void print_sect(const char *name, const uint32_t *b) {
+    printf("%-14s", name);
+    for (size_t i = 0; i < IO_SECT_BUCKETS; ++i)
+        if (b[i]) printf(" %lu+:%lu", 1ul << i, b[i]);
+    printf("\n");
+}
+
+void io_stats_print(void) {
+    printf("SD commands:");
+    for (size_t i = 0; i < 64; ++i)
+        if (io_stats.sd_cmd[i]) printf(" CMD%u:%lu", i, io_stats.sd_cmd[i]);
+    for (size_t i = 0; i < 64; ++i)
+        if (io_stats.sd_acmd[i]) printf(" ACMD%u:%lu", i, io_stats.sd_acmd[i]);
+    printf("\n  retries=%lu errors=%lu timeouts=%lu\n", io_stats.sd_cmd_retries,
+           io_stats.sd_cmd_errors, io_stats.sd_timeouts);
+    print_hist("sd_wait_ready", &io_stats.sd_wait_ready);
+    print_hist("sd_wait_token", &io_stats.sd_wait_token);
+    printf("sd_init: %lu us, ACMD41 %lu us in %lu polls, geometry cache hits=%lu\n",
+           io_stats.sd_init_us, io_stats.sd_acmd41_us, io_stats.sd_acmd41_polls,
+           io_stats.sd_geometry_hits);
+    printf("SPI: %lu single-byte, %lu DMA transfers, %llu bytes, %lu timeouts\n",
+           io_stats.spi_byte_xfers, io_stats.spi_block_xfers, io_stats.spi_bytes,
+           io_stats.spi_timeouts);
+    print_hist("disk_read", &io_stats.disk_read);
+    print_sect("  sectors", io_stats.disk_read_sect);
+    print_hist("disk_write", &io_stats.disk_write);
+    print_sect("  sectors", io_stats.disk_write_sect);
+    printf("disk errors=%lu\n", io_stats.disk_errors);
+    printf("f_write: calls=%lu direct=%lu (%lu sectors) partial=%lu flush=%lu fill=%lu cluster=%lu\n",
+           io_stats.f_write_calls, io_stats.f_write_direct, io_stats.f_write_direct_sect,
+           io_stats.f_write_partial, io_stats.f_write_flush, io_stats.f_write_fill,
+           io_stats.f_write_cluster);
+    printf("f_sync: calls=%lu\n", io_stats.f_sync_calls);
+    printf("mount hint: hits=%lu misses=%lu\n", io_stats.f_mount_hint_hits,
+           io_stats.f_mount_hint_misses);
+    printf("dir index: builds=%lu hits=%lu absent=%lu scans=%lu\n", io_stats.f_dir_index_builds,
+           io_stats.f_dir_index_hits, io_stats.f_dir_index_absent, io_stats.f_dir_index_scans);
+    printf("FatFs locks: takes=%lu contended=%lu timeouts=%lu\n", io_stats.ff_lock_takes,
+           io_stats.ff_lock_wait.count, io_stats.ff_lock_timeouts);
+    if (io_stats.ff_lock_wait.count) print_hist("  lock wait", &io_stats.ff_lock_wait);
+}
+
+static void json_array(const char *name, const uint32_t *a, size_t n) {
+    printf("\"%s\":[", name);
+    for (size_t i = 0; i < n; ++i) printf(i ? ",%lu" : "%lu", a[i]);
+    printf("]");
+}
+
+static void json_hist(const char *name, const io_hist_t *h) {
+    printf(",\"%s\":{\"n\":%lu,\"total_us\":%llu,\"max_us\":%lu,", name, h->count,
+           h->total_us, h->max_us);
+    json_array("hist", h->hist, IO_HIST_BUCKETS);
+    printf("}");
+}
+
+void io_stats_print_json(void) {
+    printf("{");
+    json_array("sd_cmd", io_stats.sd_cmd, 64);
+    printf(",");
+    json_array("sd_acmd", io_stats.sd_acmd, 64);
+    printf(",\"sd_cmd_retries\":%lu,\"sd_cmd_errors\":%lu,\"sd_timeouts\":%lu",
+           io_stats.sd_cmd_retries, io_stats.sd_cmd_errors, io_stats.sd_timeouts);
+    json_hist("sd_wait_ready", &io_stats.sd_wait_ready);
+    json_hist("sd_wait_token", &io_stats.sd_wait_token);
+    printf(",\"sd_init_us\":%lu,\"sd_acmd41_us\":%lu,\"sd_acmd41_polls\":%lu,"
+           "\"sd_geometry_hits\":%lu",
+           io_stats.sd_init_us, io_stats.sd_acmd41_us, io_stats.sd_acmd41_polls,
+           io_stats.sd_geometry_hits);
+    printf(",\"spi_byte_xfers\":%lu,\"spi_block_xfers\":%lu,\"spi_bytes\":%llu,\"spi_timeouts\":%lu",
+           io_stats.spi_byte_xfers, io_stats.spi_block_xfers, io_stats.spi_bytes,
+           io_stats.spi_timeouts);
+    json_hist("disk_read", &io_stats.disk_read);
+    json_hist("disk_write", &io_stats.disk_write);
+    printf(",");
+    json_array("disk_read_sect", io_stats.disk_read_sect, IO_SECT_BUCKETS);
+    printf(",");
+    json_array("disk_write_sect", io_stats.disk_write_sect, IO_SECT_BUCKETS);
+    printf(",\"disk_errors\":%lu", io_stats.disk_errors);
+    printf(",\"f_write\":{\"calls\":%lu,\"direct\":%lu,\"direct_sect\":%lu,\"partial\":%lu,"
+           "\"flush\":%lu,\"fill\":%lu,\"cluster\":%lu}",
+           io_stats.f_write_calls, io_stats.f_write_direct, io_stats.f_write_direct_sect,
+           io_stats.f_write_partial, io_stats.f_write_flush, io_stats.f_write_fill,
+           io_stats.f_write_cluster);
+    printf(",\"f_sync_calls\":%lu", io_stats.f_sync_calls);
+    printf(",\"f_mount_hint\":{\"hits\":%lu,\"misses\":%lu}",
+           io_stats.f_mount_hint_hits, io_stats.f_mount_hint_misses);
+    printf(",\"f_dir_index\":{\"builds\":%lu,\"hits\":%lu,\"absent\":%lu,\"scans\":%lu}",
+           io_stats.f_dir_index_builds, io_stats.f_dir_index_hits, io_stats.f_dir_index_absent,
+           io_stats.f_dir_index_scans);
+    printf(",\"ff_lock_takes\":%lu,\"ff_lock_timeouts\":%lu", io_stats.ff_lock_takes,
+           io_stats.ff_lock_timeouts);
+    json_hist("ff_lock_wait", &io_stats.ff_lock_wait);
+    printf("}\n");
+}
@@ -0,0 +1,543 @@
+/* ring_log.c
+Continuous logging into a ring of preallocated segment files (see ring_log.h).
+*/
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+//
+#include "pico/stdlib.h"
+//
+#include "crc.h"
+#include "f_util.h"
+#include "my_debug.h"
+//
+#include "ring_log.h"
+
+#define TRACE_PRINTF(fmt, args...)
+//#define TRACE_PRINTF printf
+
+_Static_assert(sizeof(ring_log_index_t) == RING_LOG_INDEX_SIZE, "ring_log_index_t size");
+
+static bool seg_present(const ring_log_t *rl, uint32_t segno) {
+    return rl->present[segno / 8] & (1u << (segno % 8));
+}
+static void seg_mark(ring_log_t *rl, uint32_t segno, bool present) {
+    if (present)
+        rl->present[segno / 8] |= 1u << (segno % 8);
+    else
+        rl->present[segno / 8] &= ~(1u << (segno % 8));
+}
+static uint32_t segno_next(uint32_t segno) {
+    return (segno + 1) % RING_LOG_MAX_SEGNO;
+}
+static uint32_t segno_prev(uint32_t segno) {
+    return (segno + RING_LOG_MAX_SEGNO - 1) % RING_LOG_MAX_SEGNO;
+}
+
+void ring_log_segment_name(const ring_log_t *rl, uint32_t segno, char *buf,
+                           size_t size) {
+    snprintf(buf, size, "%s/LOG%04lu.BIN", rl->dir,
+             (unsigned long)(segno % RING_LOG_MAX_SEGNO));
+}
+
+// Returns true if name is "LOGnnnn.BIN", and its number in *segno
+static bool parse_segment_name(const char *name, uint32_t *segno) {
+    if (strlen(name) != 11 || strncmp(name, "LOG", 3) || strcmp(name + 7, ".BIN"))
+        return false;
+    uint32_t n = 0;
+    for (size_t i = 3; i < 7; ++i) {
+        if (name[i] < '0' || name[i] > '9') return false;
+        n = n * 10 + (name[i] - '0');
+    }
+    *segno = n;
+    return true;
+}
+
+// Finds the segments left on the card by earlier runs
+static FRESULT scan_segments(ring_log_t *rl) {
+    memset(rl->present, 0, sizeof rl->present);
+    rl->count = 0;
+
+    DIR dj;
+    FILINFO fno;
+    memset(&dj, 0, sizeof dj);
+    FRESULT fr = f_findfirst(&dj, &fno, rl->dir, "LOG????.BIN");
+    while (FR_OK == fr && fno.fname[0]) {
+        uint32_t segno;
+        if (!(fno.fattrib & AM_DIR) && parse_segment_name(fno.fname, &segno)) {
+            seg_mark(rl, segno, true);
+            ++rl->count;
+        }
+        fr = f_findnext(&dj, &fno);
+    }
+    f_closedir(&dj);
+    if (FR_OK != fr) return fr;
+
+    if (!rl->count) {
+        // The first segment created will be LOG0000.BIN
+        rl->newest = RING_LOG_MAX_SEGNO - 1;
+        rl->oldest = 0;
+        return FR_OK;
+    }
+    // The ring is a run of consecutive numbers, modulo RING_LOG_MAX_SEGNO.
+    // Its newest member is the one whose successor is absent; the oldest is
+    // the first one present after that.
+    for (uint32_t n = 0; n < RING_LOG_MAX_SEGNO; ++n) {
+        if (seg_present(rl, n) && !seg_present(rl, segno_next(n))) {
+            rl->newest = n;
+            break;
+        }
+    }
+    rl->oldest = segno_next(rl->newest);
+    while (!seg_present(rl, rl->oldest)) rl->oldest = segno_next(rl->oldest);
+    TRACE_PRINTF("%s: %lu segments, oldest %lu, newest %lu\n", __func__,
+                 rl->count, rl->oldest, rl->newest);
+    return FR_OK;
+}
+
+static FRESULT delete_oldest(ring_log_t *rl) {
+    char name[FF_LFN_BUF];
+    ring_log_segment_name(rl, rl->oldest, name, sizeof name);
+    FRESULT fr = f_unlink(name);
+    if (FR_OK != fr && FR_NO_FILE != fr) {
+        DBG_PRINTF("%s: f_unlink(%s) error: %s (%d)\n", __func__, name,
+                   FRESULT_str(fr), fr);
+        return fr;
+    }
+    seg_mark(rl, rl->oldest, false);
+    --rl->count;
+    ++rl->deleted;
+    // Advance to the next segment still on the card
+    if (rl->count)
+        do rl->oldest = segno_next(rl->oldest);
+        while (!seg_present(rl, rl->oldest));
+    return FR_OK;
+}
+
+static FRESULT create_segment(ring_log_t *rl, FIL *fp, uint32_t segno) {
+    char name[FF_LFN_BUF];
+    ring_log_segment_name(rl, segno, name, sizeof name);
+    FRESULT fr = f_open(fp, name, FA_WRITE | FA_CREATE_ALWAYS);
+    if (FR_OK != fr) return fr;
+    // Allocate the whole segment as one contiguous cluster run now, so that
+    // writing it never touches the FAT.
+    fr = f_expand(fp, rl->segment_size, 1);
+    if (FR_OK == fr) {
+        // An empty index; the entries are filled in while the segment is written
+        ring_log_index_t h = {.magic = RING_LOG_INDEX_MAGIC, .segno = (uint16_t)segno};
+        UINT bw;
+        fr = f_write(fp, &h, offsetof(ring_log_index_t, entry), &bw);
+        if (FR_OK == fr) fr = f_lseek(fp, RING_LOG_INDEX_SIZE);
+        // Record the allocation in the directory now: the prepared segment can
+        // wait a whole segment lifetime before its first sync, and a power loss
+        // meanwhile would leave its clusters allocated with no entry pointing
+        // at them. Recovery removes a segment that never got a record.
+        if (FR_OK == fr) fr = f_sync(fp);
+    }
+    if (FR_OK != fr) {
+        f_close(fp);
+        f_unlink(name);
+        return fr;
+    }
+    if (!seg_present(rl, segno)) {
+        if (!rl->count) rl->oldest = segno;
+        seg_mark(rl, segno, true);
+        ++rl->count;
+    }
+    return FR_OK;
+}
+
+// Opens and preallocates the segment after the current one, deleting the
+// oldest segments as needed to respect the quota and to find free space.
+static FRESULT prepare_next(ring_log_t *rl) {
+    FIL *fp = &rl->fil[!rl->cur];
+    uint32_t segno = segno_next(rl->newest);
+    FRESULT fr;
+    for (;;) {
+        while (rl->count >= rl->max_segments && rl->oldest != rl->newest) {
+            fr = delete_oldest(rl);
+            if (FR_OK != fr) return fr;
+        }
+        fr = create_segment(rl, fp, segno);
+        // FR_DENIED: no contiguous free area large enough. Free the oldest
+        // segment and try again, unless only the current one is left.
+        if (FR_DENIED != fr || !rl->count || rl->oldest == rl->newest) break;
+        fr = delete_oldest(rl);
+        if (FR_OK != fr) break;
+    }
+    if (FR_OK == fr) rl->next_ready = true;
+    return fr;
+}
+
+static void start_next(ring_log_t *rl) {
+    rl->cur = !rl->cur;
+    rl->newest = segno_next(rl->newest);
+    rl->next_ready = false;
+    rl->pos = RING_LOG_INDEX_SIZE;
+    rl->synced_pos = rl->pos;
+    rl->opened_us = rl->synced_us = time_us_64();
+    rl->index.magic = RING_LOG_INDEX_MAGIC;
+    rl->index.segno = (uint16_t)rl->newest;
+    rl->index.count = 0;
+    rl->index_next = rl->pos;
+    rl->index_dirty = false;
+}
+
+// Rewrites the index block of the current segment and returns to the end
+static FRESULT write_index(ring_log_t *rl) {
+    FIL *fp = &rl->fil[rl->cur];
+    ring_log_index_t *idx = &rl->index;
+    idx->crc = crc32(idx->entry, idx->count * sizeof idx->entry[0]);
+    UINT bw;
+    FRESULT fr = f_lseek(fp, 0);
+    if (FR_OK == fr) fr = f_write(fp, idx, sizeof *idx, &bw);
+    if (FR_OK == fr && bw != sizeof *idx) fr = FR_DENIED;
+    FRESULT fr2 = f_lseek(fp, rl->pos);
+    if (FR_OK == fr) fr = fr2;
+    if (FR_OK == fr) rl->index_dirty = false;
+    return fr;
+}
+
+static FRESULT finish_segment(ring_log_t *rl) {
+    FIL *fp = &rl->fil[rl->cur];
+    FRESULT fr = FR_OK;
+    if (rl->index_dirty) fr = write_index(rl);
+    // Release the unused part of a segment closed early
+    if (FR_OK == fr && rl->pos < rl->segment_size) fr = f_truncate(fp);
+    FRESULT fr2 = f_close(fp);
+    return FR_OK != fr ? fr : fr2;
+}
+
+static FRESULT rotate(ring_log_t *rl) {
+    FRESULT fr;
+    if (!rl->next_ready) {
+        // ring_log_service() did not get to run in time
+        ++rl->stalls;
+        fr = prepare_next(rl);
+        if (FR_OK != fr) return fr;
+    }
+    fr = finish_segment(rl);
+    start_next(rl);
+    ++rl->rotations;
+    return fr;
+}
+
+// Scans a segment for its last valid record and continues the sequence numbers
+// from there. A segment left at full size by a power failure is cut after that
+// record. Returns the record bytes kept.
+static FRESULT recover_segment(ring_log_t *rl, uint32_t segno, FSIZE_t *len) {
+    FIL *fp = &rl->fil[0];
+    char name[FF_LFN_BUF];
+    ring_log_segment_name(rl, segno, name, sizeof name);
+    *len = 0;
+    FRESULT fr = f_open(fp, name, FA_READ | FA_WRITE);
+    if (FR_OK != fr) return fr;
+    // The index is not used here, so rl->index serves as the buffer
+    fr = ring_log_read_index(fp, &rl->index);
+    if (FR_OK != fr) {
+        f_close(fp);
+        return fr;
+    }
+    FSIZE_t start = f_tell(fp);
+    // Closed normally: ring_log_close() or a rotation truncated it, so all its
+    // records are valid and only the last seq is needed. Start from the last
+    // index entry instead of the first record.
+    bool closed = f_size(fp) < rl->segment_size;
+    if (closed && rl->index.count) {
+        const ring_log_index_entry_t *e = &rl->index.entry[rl->index.count - 1];
+        if (e->offset < f_size(fp)) fr = f_lseek(fp, e->offset);
+    }
+    FSIZE_t ofs = f_tell(fp);
+    uint32_t n = 0, seq = 0;
+    for (;;) {
+        ring_log_rec_t h;
+        UINT br;
+        fr = f_read(fp, &h, sizeof h, &br);
+        if (FR_OK != fr || br != sizeof h) break;
+        if (RING_LOG_MAGIC != h.magic || (uint16_t)segno != h.segno ||
+            (h.len & RING_LOG_LEN_MASK) > RING_LOG_MAX_RECORD || (n && h.seq != seq + 1))
+            break;
+        uint32_t crc_rec = h.crc;
+        h.crc = 0;
+        unsigned long crc = crc32(&h, sizeof h);
+        UINT left = h.len & RING_LOG_LEN_MASK;
+        while (left) {
+            BYTE buf[128];
+            UINT chunk = left < sizeof buf ? left : sizeof buf;
+            fr = f_read(fp, buf, chunk, &br);
+            if (FR_OK != fr || br != chunk) break;
+            update_crc32(&crc, buf, chunk);
+            left -= chunk;
+        }
+        if (left || crc != crc_rec) break;
+        ofs = f_tell(fp);
+        seq = h.seq;
+        ++n;
+    }
+    if (n) rl->seq = seq + 1;
+    if (closed) {
+        *len = f_size(fp) > start ? f_size(fp) - start : 0;
+        FRESULT fr2 = f_close(fp);
+        return FR_OK != fr ? fr : fr2;
+    }
+    if (FR_OK == fr) fr = f_lseek(fp, ofs);
+    if (FR_OK == fr) fr = f_truncate(fp);
+    FRESULT fr2 = f_close(fp);
+    if (FR_OK != fr) {
+        DBG_PRINTF("%s: %s: %s (%d)\n", __func__, name, FRESULT_str(fr), fr);
+        return fr;
+    }
+    rl->recovered += n;
+    *len = ofs - start;
+    TRACE_PRINTF("%s: %s: %lu records, %llu bytes\n", __func__, name, n,
+                 (unsigned long long)ofs);
+    return fr2;
+}
+
+// A run that ended without ring_log_close() left its current segment, and
+// possibly the preallocated next one, at full size. Either way the last two
+// segments give the sequence number to continue from.
+static FRESULT recover(ring_log_t *rl) {
+    if (!rl->count) return FR_OK;
+    FSIZE_t len, prev_len = 0;
+    FRESULT fr;
+    uint32_t prev = segno_prev(rl->newest);
+    if (rl->count > 1 && seg_present(rl, prev)) {
+        fr = recover_segment(rl, prev, &prev_len);
+        if (FR_OK != fr) return fr;
+    }
+    fr = recover_segment(rl, rl->newest, &len);
+    if (FR_OK != fr) return fr;
+    if (!len) {
+        // Nothing was written to the newest segment: remove it
+        char name[FF_LFN_BUF];
+        ring_log_segment_name(rl, rl->newest, name, sizeof name);
+        fr = f_unlink(name);
+        if (FR_OK != fr) return fr;
+        seg_mark(rl, rl->newest, false);
+        --rl->count;
+        rl->newest = prev;
+    }
+    // A run that stopped before its first commit left no records in either:
+    // continue the sequence from the newest older segment that has some
+    len = len || prev_len;
+    for (uint32_t segno = prev, i = 1; !len && i < rl->count; ++i) {
+        segno = segno_prev(segno);
+        if (!seg_present(rl, segno)) break;
+        fr = recover_segment(rl, segno, &len);
+        if (FR_OK != fr) return fr;
+    }
+    return FR_OK;
+}
+
+FRESULT ring_log_recover(ring_log_t *rl) {
+    myASSERT(rl->dir && !rl->is_open);
+    rl->seq = 0;
+    FRESULT fr = scan_segments(rl);
+    if (FR_NO_PATH == fr) return FR_OK;  // No log was ever written here
+    if (FR_OK != fr) return fr;
+    return recover(rl);
+}
+
+FRESULT ring_log_open(ring_log_t *rl) {
+    myASSERT(rl->dir);
+    myASSERT(rl->segment_size && !(rl->segment_size % FF_MAX_SS));
+    myASSERT(rl->segment_size >=
+             RING_LOG_INDEX_SIZE + sizeof(ring_log_rec_t) + RING_LOG_MAX_RECORD);
+    myASSERT(rl->sync_max_pct <= 100);
+    if (rl->max_segments < 2) rl->max_segments = 2;
+    if (rl->max_segments >= RING_LOG_MAX_SEGNO)
+        rl->max_segments = RING_LOG_MAX_SEGNO - 1;
+    rl->is_open = false;
+    rl->next_ready = false;
+    rl->cur = 0;
+    rl->sync_hold_us = 0;
+    rl->started_us = time_us_64();
+
+    FRESULT fr = f_mkdir(rl->dir);
+    if (FR_OK != fr && FR_EXIST != fr) return fr;
+    // Usually done already at mount; then every segment is closed and this
+    // only reads the last index entry of each of the newest two
+    fr = ring_log_recover(rl);
+    if (FR_OK != fr) return fr;
+
+    // Create the first segment of this run, then have the next one ready
+    fr = prepare_next(rl);
+    if (FR_OK != fr) return fr;
+    start_next(rl);
+    rl->is_open = true;
+    return ring_log_service(rl);
+}
+
+static FRESULT write_all(ring_log_t *rl, const void *buff, UINT btw) {
+    UINT bw = 0;
+    FRESULT fr = f_write(&rl->fil[rl->cur], buff, btw, &bw);
+    rl->pos += bw;
+    if (FR_OK == fr && bw != btw) fr = FR_DENIED;  // Can't happen: the space is preallocated
+    return fr;
+}
+
+static FRESULT commit(ring_log_t *rl) {
+    uint64_t start = time_us_64();
+    FRESULT fr = rl->index_dirty ? write_index(rl) : FR_OK;
+    if (FR_OK == fr) fr = f_sync(&rl->fil[rl->cur]);
+    uint64_t end = time_us_64();
+    uint64_t took = end - start;
+    ++rl->syncs;
+    rl->sync_us += took;
+    rl->synced_pos = rl->pos;
+    rl->synced_us = end;
+    // A commit that took d us is followed by at least d * (100 - pct) / pct us
+    // without commits, so they never take more than pct % of the time.
+    if (rl->sync_max_pct)
+        rl->sync_hold_us = end + took * (100 - rl->sync_max_pct) / rl->sync_max_pct;
+    return fr;
+}
+
+// Commits if a byte or time bound was reached and the budget allows it
+static FRESULT maybe_commit(ring_log_t *rl) {
+    FSIZE_t dirty = rl->pos - rl->synced_pos;
+    if (!dirty) return FR_OK;
+    uint64_t now = time_us_64();
+    bool due = (rl->sync_bytes && dirty >= rl->sync_bytes) ||
+               (rl->sync_ms && now - rl->synced_us >= rl->sync_ms * 1000ULL);
+    if (!due || now < rl->sync_hold_us) return FR_OK;
+    return commit(rl);
+}
+
+FRESULT ring_log_write(ring_log_t *rl, const void *buff, UINT btw) {
+    return ring_log_write_type(rl, 0, buff, btw);
+}
+
+FRESULT ring_log_write_type(ring_log_t *rl, uint8_t type, const void *buff, UINT btw) {
+    return ring_log_write_at(rl, type, buff, btw, time_us_64());
+}
+
+FRESULT ring_log_write_at(ring_log_t *rl, uint8_t type, const void *buff, UINT btw,
+                          uint64_t t_us) {
+    if (!rl->is_open) return FR_INVALID_OBJECT;
+    if (btw > RING_LOG_MAX_RECORD || type > (0xFFFF >> RING_LOG_TYPE_SHIFT))
+        return FR_INVALID_PARAMETER;
+    FRESULT fr;
+
+    // Records never span segments
+    bool full = rl->pos + sizeof(ring_log_rec_t) + btw > rl->segment_size;
+    bool expired = rl->segment_ms && rl->pos > RING_LOG_INDEX_SIZE &&
+                   time_us_64() - rl->opened_us >= rl->segment_ms * 1000ULL;
+    if (full || expired) {
+        fr = rotate(rl);
+        if (FR_OK != fr) return fr;
+    }
+    // One index entry about every 1/RING_LOG_INDEX_ENTRIES of the segment;
+    // it reaches the card with the next commit
+    if (rl->pos >= rl->index_next && rl->index.count < RING_LOG_INDEX_ENTRIES) {
+        ring_log_index_entry_t *e = &rl->index.entry[rl->index.count++];
+        e->t_us = t_us;
+        e->offset = (uint32_t)rl->pos;
+        e->seq = rl->seq;
+        rl->index_next =
+            rl->pos + (rl->segment_size - RING_LOG_INDEX_SIZE) / RING_LOG_INDEX_ENTRIES;
+        rl->index_dirty = true;
+    }
+    ring_log_rec_t h = {
+        .magic = RING_LOG_MAGIC,
+        .seq = rl->seq,
+        .len = (uint16_t)(btw | type << RING_LOG_TYPE_SHIFT),
+        .segno = rl->newest,
+        .crc = 0
+    };
+    unsigned long crc = crc32(&h, sizeof h);
+    update_crc32(&crc, buff, btw);
+    h.crc = crc;
+    fr = write_all(rl, &h, sizeof h);
+    if (FR_OK == fr) fr = write_all(rl, buff, btw);
+    if (FR_OK != fr) return fr;
+    ++rl->seq;
+    return maybe_commit(rl);
+}
+
+FRESULT ring_log_sync(ring_log_t *rl) {
+    if (!rl->is_open || rl->pos == rl->synced_pos) return FR_OK;
+    return commit(rl);
+}
+
+FRESULT ring_log_service(ring_log_t *rl) {
+    if (!rl->is_open) return FR_OK;
+    FRESULT fr = maybe_commit(rl);
+    if (FR_OK != fr || rl->next_ready) return fr;
+    return prepare_next(rl);
+}
+
+FRESULT ring_log_close(ring_log_t *rl) {
+    if (!rl->is_open) return FR_OK;
+    FRESULT fr = finish_segment(rl);
+    if (rl->next_ready) {
+        // Drop the preallocated segment that was never written
+        uint32_t segno = segno_next(rl->newest);
+        char name[FF_LFN_BUF];
+        f_close(&rl->fil[!rl->cur]);
+        ring_log_segment_name(rl, segno, name, sizeof name);
+        if (FR_OK == f_unlink(name)) {
+            seg_mark(rl, segno, false);
+            --rl->count;
+        }
+        rl->next_ready = false;
+    }
+    rl->is_open = false;
+    return fr;
+}
+
+void ring_log_abandon(ring_log_t *rl) {
+    // The FIL objects die with the volume (f_unmount), so just forget them
+    rl->is_open = false;
+    rl->next_ready = false;
+}
+
+FRESULT ring_log_read_index(FIL *fp, ring_log_index_t *idx) {
+    UINT br;
+    FRESULT fr = f_lseek(fp, 0);
+    if (FR_OK == fr) fr = f_read(fp, idx, sizeof *idx, &br);
+    if (FR_OK != fr) return fr;
+    if (br >= sizeof idx->magic && RING_LOG_MAGIC == idx->magic) {
+        // Written before segments had an index: the records start at 0
+        memset(idx, 0, sizeof *idx);
+        return f_lseek(fp, 0);
+    }
+    if (br < offsetof(ring_log_index_t, entry) || RING_LOG_INDEX_MAGIC != idx->magic ||
+        idx->count > RING_LOG_INDEX_ENTRIES ||
+        offsetof(ring_log_index_t, entry) + idx->count * sizeof idx->entry[0] > br ||
+        crc32(idx->entry, idx->count * sizeof idx->entry[0]) != idx->crc)
+        memset(idx, 0, sizeof *idx);  // segno included: none of it is trusted
+    return f_lseek(fp, RING_LOG_INDEX_SIZE);
+}
+
+FRESULT ring_log_read(FIL *fp, ring_log_rec_t *h, void *buff, UINT size, bool *valid) {
+    *valid = false;
+    UINT br;
+    FRESULT fr = f_read(fp, h, sizeof *h, &br);
+    if (FR_OK != fr || br != sizeof *h) return fr;
+    UINT len = h->len & RING_LOG_LEN_MASK;
+    if (RING_LOG_MAGIC != h->magic || len > RING_LOG_MAX_RECORD || len > size)
+        return FR_OK;
+    fr = f_read(fp, buff, len, &br);
+    if (FR_OK != fr || br != len) return fr;
+    uint32_t crc_rec = h->crc;
+    h->crc = 0;
+    unsigned long crc = crc32(h, sizeof *h);
+    update_crc32(&crc, buff, len);
+    h->crc = crc_rec;
+    *valid = crc == crc_rec;
+    return FR_OK;
+}
+
+int ring_log_index_find(const ring_log_index_t *idx, uint64_t t_us) {
+    int lo = 0, hi = idx->count;  // The answer is lo - 1
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (idx->entry[mid].t_us <= t_us)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo - 1;
+}
@@ -0,0 +1,55 @@
+/* sd_trace.c
+Event ring buffer of the SD/SPI driver and FatFs (see sd_trace.h).
+*/
+#include <stdio.h>
+//
+#include "sd_trace.h"
+
+sd_trace_rec_t sd_trace_buf[SD_TRACE_LEN];
+volatile uint32_t sd_trace_head;
+volatile bool sd_trace_on = true;
+
+static const char *const ev_names[SD_TR_COUNT] = {
+    [SD_TR_CMD] = "cmd",
+    [SD_TR_WAIT_READY] = "wait_ready",
+    [SD_TR_WAIT_TOKEN] = "wait_token",
+    [SD_TR_DMA] = "dma",
+    [SD_TR_LOCK_WAIT] = "lock_wait",
+    [SD_TR_LOCK_HELD] = "lock_held",
+    [SD_TR_DISK_READ] = "disk_read",
+    [SD_TR_DISK_WRITE] = "disk_write",
+    [SD_TR_FF_OPEN] = "f_open",
+    [SD_TR_FF_READ] = "f_read",
+    [SD_TR_FF_WRITE] = "f_write",
+    [SD_TR_FF_SYNC] = "f_sync",
+    [SD_TR_FF_CLOSE] = "f_close",
+    [SD_TR_FF_LSEEK] = "f_lseek",
+    [SD_TR_FF_EXPAND] = "f_expand",
+    [SD_TR_FF_TRUNCATE] = "f_truncate",
+    [SD_TR_FF_UNLINK] = "f_unlink",
+};
+
+void sd_trace_enable(bool on) {
+    sd_trace_on = on;
+}
+
+void sd_trace_clear(void) {
+    sd_trace_head = 0;
+}
+
+void sd_trace_dump(void) {
+    bool was_on = sd_trace_on;
+    sd_trace_on = false;  // Keep the buffer still while printing it
+    uint32_t head = sd_trace_head;
+    uint32_t n = head < SD_TRACE_LEN ? head : SD_TRACE_LEN;
+    printf("# sd_trace events=%lu lost=%lu\n", n, head - n);
+    for (uint32_t i = head - n; i != head; ++i) {
+        const sd_trace_rec_t *r = &sd_trace_buf[i & (SD_TRACE_LEN - 1)];
+        uint8_t ev = r->ev & ~SD_TR_END;
+        printf("T,%lu,%u,%s,%c,%u\n", r->t_us, r->core,
+               ev < SD_TR_COUNT ? ev_names[ev] : "?",
+               r->ev & SD_TR_END ? 'E' : 'B', r->arg);
+    }
+    printf("# end\n");
+    sd_trace_on = was_on;
+}
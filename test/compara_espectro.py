@@ -0,0 +1,81 @@
+"""
+Confere os espectros médios calculados em Q15 por teste_espectro (espectro.h) com
+numpy.fft.rfft em ponto flutuante: mesma remoção da média, mesma janela e mesma
+média das magnitudes. Cada raia pode diferir da referência em até TOLERANCIA vezes
+a maior raia do eixo (o ruído de arredondamento da FFT em 16 bits).
+
+Sai com 77 (teste pulado no ctest) quando o numpy não está instalado.
+
+Uso: python compara_espectro.py espectro_host.bin
+"""
+import struct
+import sys
+
+try:
+    import numpy as np
+except ImportError:
+    print('numpy não instalado: comparação pulada')
+    sys.exit(77)
+
+CABECALHO = struct.Struct('<IIHHBB3bx')  # esp_registro_t até as raias
+EIXOS = ['accel_x', 'accel_y', 'accel_z']
+JANELAS = ['ret', 'hann', 'hamming']
+TOLERANCIA = 1e-3
+
+
+def janela(tipo, n):
+    # Periódicas, como as tabelas de espectro.h: w[i] depende de cos(2πi/n)
+    c = np.cos(2 * np.pi * np.arange(n) / n)
+    if tipo == 1:
+        return 0.5 - 0.5 * c
+    if tipo == 2:
+        return 0.54 - 0.46 * c
+    return np.ones(n)
+
+
+def referencia(quadros, tipo):
+    """Média de |rfft| dos quadros (quadros x n), como esp_calcular e esp_fechar."""
+    n = quadros.shape[1]
+    soma = np.zeros(n // 2 + 1)
+    for x in quadros:
+        s = int(x.sum())
+        media = int((abs(s) + n // 2) // n) * (1 if s >= 0 else -1)  # Arredondada, como em C
+        soma += np.abs(np.fft.rfft((x - media) * janela(tipo, n)))
+    return soma / len(quadros)
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__.strip())
+        sys.exit(2)
+    dados = open(sys.argv[1], 'rb').read()
+    pos = 0
+    falhas = 0
+    casos = 0
+    while pos < len(dados):
+        t0, t1, n, hz, quadros, tipo, *expoentes = CABECALHO.unpack_from(dados, pos)
+        raias = n // 2 + 1
+        valores = np.array(struct.unpack_from(f'<{3 * raias}H', dados, pos + CABECALHO.size), dtype=float)
+        pos += CABECALHO.size + 3 * raias * 2
+        amostras = np.frombuffer(dados, dtype='<i2', count=quadros * 3 * n, offset=pos).astype(np.int64)
+        amostras = amostras.reshape(quadros, 3, n)
+        pos += quadros * 3 * n * 2
+        casos += 1
+        for e, eixo in enumerate(EIXOS):
+            q15 = valores[e * raias:(e + 1) * raias] * 2.0 ** expoentes[e]
+            ref = referencia(amostras[:, e, :], tipo)
+            pico = ref.max()
+            erro = np.abs(q15 - ref).max() / pico
+            k = int(np.abs(q15 - ref).argmax())
+            ok = erro <= TOLERANCIA
+            falhas += not ok
+            print(f'{"ok" if ok else "FALHA"}: N={n:4d} {JANELAS[tipo]:7s} {eixo}: '
+                  f'erro máximo {erro:.2e} do pico (raia {k}: {q15[k]:.1f} x {ref[k]:.1f})')
+    if not casos:
+        print('FALHA: nenhum espectro no arquivo')
+        sys.exit(1)
+    sys.exit(1 if falhas else 0)
+
+
+if __name__ == '__main__':
+    main()
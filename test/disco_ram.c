@@ -0,0 +1,68 @@
+#include <string.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "io_stats.h"
+#include "disco_ram.h"
+
+io_stats_t io_stats; // Contadores do ff.c (FF_USE_IO_STATS)
+
+static BYTE disco[DISCO_RAM_SETORES][FF_MAX_SS];
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+    return 0;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+    return 0;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
+{
+    if (sector + count > DISCO_RAM_SETORES)
+        return RES_PARERR;
+    memcpy(buff, disco[sector], (size_t)count * FF_MAX_SS);
+    return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count)
+{
+    if (sector + count > DISCO_RAM_SETORES)
+        return RES_PARERR;
+    memcpy(disco[sector], buff, (size_t)count * FF_MAX_SS);
+    return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+        return RES_OK;
+    case GET_SECTOR_COUNT:
+        *(LBA_t *)buff = DISCO_RAM_SETORES;
+        return RES_OK;
+    case GET_BLOCK_SIZE:
+        *(DWORD *)buff = 1;
+        return RES_OK;
+    default:
+        return RES_PARERR;
+    }
+}
+
+DWORD get_fattime(void)
+{
+    return (DWORD)(2025 - 1980) << 25 | 1u << 21 | 1u << 16; // 01/01/2025
+}
+
+FRESULT disco_ram_montar(FATFS *fs)
+{
+    static BYTE trabalho[FF_MAX_SS * 4];
+    MKFS_PARM opt = {FM_ANY, 0, 0, 0, 0};
+    FRESULT fr = f_mkfs("", &opt, trabalho, sizeof trabalho);
+    if (fr != FR_OK)
+        return fr;
+    return f_mount(fs, "", 1);
+}
@@ -0,0 +1,14 @@
+#ifndef DISCO_RAM_H
+#define DISCO_RAM_H
+
+#include "ff.h"
+
+// Cartão simulado em RAM para rodar o FatFs do firmware no PC.
+#define DISCO_RAM_SETORES 16384 // 8 MiB
+
+/**
+ * Formata o disco em RAM e o monta como a unidade padrão.
+ */
+FRESULT disco_ram_montar(FATFS *fs);
+
+#endif
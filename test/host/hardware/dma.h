@@ -0,0 +1,56 @@
+#ifndef _HARDWARE_DMA_H
+#define _HARDWARE_DMA_H
+
+#include "pico/stdlib.h"
+
+enum dma_channel_transfer_size
+{
+  DMA_SIZE_8 = 0,
+  DMA_SIZE_16 = 1,
+  DMA_SIZE_32 = 2
+};
+
+typedef struct
+{
+  uint32_t ctrl;
+} dma_channel_config;
+
+typedef struct
+{
+  volatile uint32_t ints0, ints1;
+} dma_hw_t;
+
+static dma_hw_t dma_hw_host;
+#define dma_hw (&dma_hw_host)
+
+static inline int dma_claim_unused_channel(bool required)
+{
+  static int proximo;
+  return proximo++;
+}
+
+static inline dma_channel_config dma_channel_get_default_config(uint channel)
+{
+  dma_channel_config c = {0};
+  return c;
+}
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) {}
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr) {}
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr) {}
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq) {}
+
+static inline void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                                         const volatile void *read_addr, uint transfer_count, bool trigger) {}
+static inline void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger) {}
+static inline void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger) {}
+static inline void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger) {}
+static inline void dma_channel_set_irq1_enabled(uint channel, bool enabled) {}
+static inline void dma_channel_abort(uint channel) {}
+
+static inline bool dma_channel_is_busy(uint channel)
+{
+  return false;
+}
+
+#endif
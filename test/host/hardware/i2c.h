@@ -0,0 +1,35 @@
+#ifndef _HARDWARE_I2C_H
+#define _HARDWARE_I2C_H
+
+#include "pico/stdlib.h"
+
+#define I2C_IC_DATA_CMD_CMD_BITS 0x00000100u
+#define I2C_IC_DATA_CMD_STOP_BITS 0x00000200u
+#define I2C_IC_DATA_CMD_RESTART_BITS 0x00000400u
+
+typedef struct
+{
+  volatile uint32_t enable, tar, data_cmd, clr_tx_abrt;
+} i2c_hw_t;
+
+typedef struct i2c_inst
+{
+  i2c_hw_t hw;
+} i2c_inst_t;
+
+static inline i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c)
+{
+  return &i2c->hw;
+}
+
+static inline size_t i2c_get_read_available(i2c_inst_t *i2c)
+{
+  return 0;
+}
+
+static inline uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx)
+{
+  return is_tx ? 32 : 33;
+}
+
+#endif
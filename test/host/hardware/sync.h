@@ -0,0 +1,7 @@
+#ifndef _HARDWARE_SYNC_H
+#define _HARDWARE_SYNC_H
+
+static inline void __sev(void) {}
+static inline void __wfe(void) {}
+
+#endif
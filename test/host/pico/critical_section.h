@@ -0,0 +1,14 @@
+#ifndef _PICO_CRITICAL_SECTION_H
+#define _PICO_CRITICAL_SECTION_H
+
+// Um núcleo só e sem interrupções no PC: a seção crítica não precisa fazer nada.
+typedef struct
+{
+  int nivel;
+} critical_section_t;
+
+static inline void critical_section_init(critical_section_t *cs) {}
+static inline void critical_section_enter_blocking(critical_section_t *cs) {}
+static inline void critical_section_exit(critical_section_t *cs) {}
+
+#endif
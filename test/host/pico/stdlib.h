@@ -0,0 +1,68 @@
+#ifndef _PICO_STDLIB_H
+#define _PICO_STDLIB_H
+
+// Substitutos do Pico SDK para compilar os cabeçalhos do firmware no PC. Só os
+// tipos e as funções que eles citam; o que mexe no hardware não faz nada.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+static inline uint64_t time_us_64(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000u + t.tv_nsec / 1000;
+}
+
+static inline uint32_t time_us_32(void)
+{
+  return (uint32_t)time_us_64();
+}
+
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms)
+{
+  return time_us_64() + (uint64_t)ms * 1000;
+}
+
+static inline bool time_reached(absolute_time_t t)
+{
+  return time_us_64() >= t;
+}
+
+static inline void tight_loop_contents(void) {}
+
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+struct repeating_timer
+{
+  int64_t delay_us;
+  repeating_timer_callback_t callback;
+  void *user_data;
+};
+
+// Sem temporizador no PC: o teste chama o que precisar diretamente.
+static inline bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback,
+                                          void *user_data, repeating_timer_t *out)
+{
+  out->delay_us = delay_us;
+  out->callback = callback;
+  out->user_data = user_data;
+  return false;
+}
+
+static inline bool cancel_repeating_timer(repeating_timer_t *timer)
+{
+  return true;
+}
+
+static inline void stdio_set_chars_available_callback(void (*fn)(void *), void *param) {}
+
+#endif
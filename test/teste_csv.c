@@ -0,0 +1,329 @@
+// Teste do csv.h no PC: a captura gravada com o csv.h precisa ser idêntica, byte
+// a byte, à que o sprintf("%d,%.2f,...") gravava antes.
+//
+// 1. Refaz o MPU6050_data1.csv gravado pela placa: as contagens do acelerômetro são
+//    recuperadas dos valores impressos, os ângulos voltam a ser floats, e as linhas
+//    são gravadas no cartão simulado exatamente como em capture_data.
+// 2. Compara as contagens brutas de -32768 a 32767 e floats aleatórios, um a um.
+// 3. Mede linhas/s do csv.h (FFMT) contra sprintf + f_write, o caminho antigo.
+//
+// Uso: teste_csv <MPU6050_data1.csv>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ff.h"
+#include "disco_ram.h"
+#include "lib/FatFs_SPI/csv.h"
+
+#define CABECALHO "numero_amostra,accel_x,accel_y,accel_z,giro_x,giro_y,giro_z\n"
+#define MAX_LINHAS 1024
+#define BENCH_LINHAS 50000 // ~2 MB por arquivo, cabem os dois no disco em RAM
+
+typedef struct
+{
+    int n;
+    int16_t accel[3]; // Contagens brutas (±2 g: 16384 por g)
+    float angulo[3];  // roll, pitch, yaw
+} linha_t;
+
+static linha_t linhas[MAX_LINHAS];
+static int num_linhas;
+static int falhas;
+
+static char *ler_arquivo(const char *nome, size_t *tam)
+{
+    FILE *f = fopen(nome, "rb");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = malloc(n + 1);
+    if (buf && fread(buf, 1, n, f) != (size_t)n)
+    {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    if (buf)
+    {
+        buf[n] = '\0';
+        *tam = n;
+    }
+    return buf;
+}
+
+// Linha de referência, como o firmware gravava antes do csv.h.
+static int linha_sprintf(char *buf, size_t tam, const linha_t *l)
+{
+    return snprintf(buf, tam, "%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", l->n,
+                    l->accel[0] / 16384.0f, l->accel[1] / 16384.0f, l->accel[2] / 16384.0f,
+                    l->angulo[0], l->angulo[1], l->angulo[2]);
+}
+
+// Mesma sequência de chamadas de capture_data.
+static void linha_csv(FFMT *fb, const linha_t *l)
+{
+    f_fmt_int(fb, l->n);
+    for (int c = 0; c < 3; c++)
+        csv_bruto(fb, l->accel[c], 14);
+    for (int c = 0; c < 3; c++)
+        csv_float2(fb, l->angulo[c]);
+    f_fmt_putc(fb, '\n');
+}
+
+/**
+ * Lê as linhas do CSV. Cada campo do acelerômetro é v = bruto / 16384 com duas
+ * casas; round(v * 16384) é uma contagem que imprime o mesmo v, o que basta
+ * para refazer o texto.
+ */
+static bool carregar(const char *texto)
+{
+    if (strncmp(texto, CABECALHO, strlen(CABECALHO)))
+    {
+        printf("FALHA: cabeçalho diferente do gravado por capture_data\n");
+        return false;
+    }
+    const char *p = texto + strlen(CABECALHO);
+    while (*p && num_linhas < MAX_LINHAS)
+    {
+        linha_t *l = &linhas[num_linhas];
+        char *fim;
+        l->n = (int)strtol(p, &fim, 10);
+        for (int c = 0; c < 6; c++)
+        {
+            if (*fim != ',')
+            {
+                printf("FALHA: linha %d mal formada\n", num_linhas + 2);
+                return false;
+            }
+            const char *campo = fim + 1;
+            float v = strtof(campo, &fim);
+            if (c < 3)
+                l->accel[c] = (int16_t)lroundf(v * 16384.0f);
+            else
+                l->angulo[c - 3] = v;
+        }
+        if (*fim != '\n')
+        {
+            printf("FALHA: linha %d mal formada\n", num_linhas + 2);
+            return false;
+        }
+        p = fim + 1;
+        num_linhas++;
+    }
+    return num_linhas > 0;
+}
+
+// Grava a captura no cartão simulado, com o flush e o f_sync a cada 32 linhas.
+static FRESULT gravar_csv(const char *nome)
+{
+    FIL f;
+    FRESULT fr = f_open(&f, nome, FA_WRITE | FA_CREATE_ALWAYS);
+    if (fr != FR_OK)
+        return fr;
+    static FFMT csv;
+    f_fmt_init(&csv, &f);
+    f_fmt_puts(&csv, CABECALHO);
+    for (int i = 0; i < num_linhas; i++)
+    {
+        linha_csv(&csv, &linhas[i]);
+        if ((i + 1) % 32 == 0 && FR_OK == f_fmt_flush(&csv))
+            f_sync(&f);
+    }
+    f_fmt_flush(&csv);
+    fr = csv.res;
+    FRESULT fr2 = f_close(&f);
+    return fr != FR_OK ? fr : fr2;
+}
+
+static char *ler_do_cartao(const char *nome, UINT *tam)
+{
+    FIL f;
+    if (f_open(&f, nome, FA_READ) != FR_OK)
+        return NULL;
+    UINT n = (UINT)f_size(&f);
+    char *buf = malloc(n + 1);
+    if (f_read(&f, buf, n, tam) != FR_OK || *tam != n)
+    {
+        free(buf);
+        buf = NULL;
+    }
+    f_close(&f);
+    return buf;
+}
+
+// Primeira diferença entre dois textos, com a linha onde ela aparece.
+static void comparar(const char *oque, const char *a, size_t na, const char *b, size_t nb)
+{
+    size_t i = 0;
+    while (i < na && i < nb && a[i] == b[i])
+        i++;
+    if (i == na && i == nb)
+    {
+        printf("ok: %s (%zu bytes)\n", oque, na);
+        return;
+    }
+    int linha = 1;
+    for (size_t k = 0; k < i; k++)
+        linha += a[k] == '\n';
+    printf("FALHA: %s difere no byte %zu (linha %d): %zu x %zu bytes\n", oque, i, linha, na, nb);
+    falhas++;
+}
+
+static bool valor_igual(FFMT *fb, double v, const char *oque)
+{
+    char ref[64];
+    int n = snprintf(ref, sizeof ref, ",%.2f", v);
+    if ((int)fb->len == n && !memcmp(fb->buf, ref, n))
+        return true;
+    if (falhas++ < 10)
+        printf("FALHA: %s: csv.h \"%.*s\", sprintf \"%s\"\n", oque, (int)fb->len, fb->buf, ref);
+    return false;
+}
+
+static void varrer_valores()
+{
+    static FFMT fb; // Só o buffer: cada valor cabe nele e nada vai para o arquivo
+    f_fmt_init(&fb, NULL);
+    long testados = 0;
+    int antes = falhas;
+
+    for (int32_t b = INT16_MIN; b <= INT16_MAX; b++, testados++)
+    {
+        fb.len = 0;
+        csv_bruto(&fb, (int16_t)b, 14);
+        valor_igual(&fb, b / 16384.0f, "contagem bruta");
+    }
+
+    // Empates exatos em binário, zeros com sinal e valores que arredondam para zero
+    static const float especiais[] = {0.0f, -0.0f, 0.005f, -0.005f, 0.004f, -0.004f, 0.125f,
+                                      0.375f, -0.625f, 2.675f, 1.005f, 179.995f, -180.0f,
+                                      1e-30f, -1e-30f, 1e-45f, 167772.16f, 20000000.0f};
+    for (size_t i = 0; i < sizeof especiais / sizeof especiais[0]; i++, testados++)
+    {
+        fb.len = 0;
+        csv_float2(&fb, especiais[i]);
+        valor_igual(&fb, especiais[i], "float especial");
+    }
+
+    // Aleatórios na faixa dos ângulos e múltiplos de 1/2^k (empates a cada escala)
+    uint32_t x = 2463534242u;
+    for (int i = 0; i < 1000000; i++, testados++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        float v = (i & 1) ? (int32_t)x / (float)(1u << (x % 24 + 8))
+                          : ((float)x / 4294967296.0f - 0.5f) * 400.0f;
+        fb.len = 0;
+        csv_float2(&fb, v);
+        valor_igual(&fb, v, "float aleatório");
+    }
+    if (falhas == antes)
+        printf("ok: %ld valores iguais ao sprintf(\"%%.2f\")\n", testados);
+}
+
+static double segundos()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Linhas/s gravadas no cartão simulado pelos dois caminhos, com as linhas do arquivo.
+static void medir()
+{
+    FIL f;
+    static FFMT csv;
+    double t0 = segundos();
+    f_open(&f, "BENCH1.CSV", FA_WRITE | FA_CREATE_ALWAYS);
+    f_fmt_init(&csv, &f);
+    for (int i = 0; i < BENCH_LINHAS; i++)
+        linha_csv(&csv, &linhas[i % num_linhas]);
+    FRESULT fr = f_fmt_flush(&csv);
+    f_close(&f);
+    double t_csv = segundos() - t0;
+
+    t0 = segundos();
+    f_open(&f, "BENCH2.CSV", FA_WRITE | FA_CREATE_ALWAYS);
+    for (int i = 0; i < BENCH_LINHAS; i++)
+    {
+        char buffer[80];
+        UINT bw;
+        int n = linha_sprintf(buffer, sizeof buffer, &linhas[i % num_linhas]);
+        if (fr == FR_OK)
+            fr = f_write(&f, buffer, n, &bw);
+    }
+    f_close(&f);
+    double t_sprintf = segundos() - t0;
+    f_unlink("BENCH1.CSV");
+    f_unlink("BENCH2.CSV");
+    if (fr != FR_OK)
+    {
+        printf("FALHA: FatFs %d na medição\n", fr);
+        falhas++;
+        return;
+    }
+
+    printf("csv.h: %.0f linhas/s, sprintf + f_write: %.0f linhas/s (%.1fx)\n",
+           BENCH_LINHAS / t_csv, BENCH_LINHAS / t_sprintf, t_sprintf / t_csv);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        printf("Uso: %s <MPU6050_data1.csv>\n", argv[0]);
+        return 2;
+    }
+    size_t tam_original;
+    char *original = ler_arquivo(argv[1], &tam_original);
+    if (!original)
+    {
+        printf("FALHA: não foi possível ler %s\n", argv[1]);
+        return 1;
+    }
+    if (!carregar(original))
+        return 1;
+
+    static FATFS fs;
+    FRESULT fr = disco_ram_montar(&fs);
+    if (fr == FR_OK)
+        fr = gravar_csv("MPU6050.CSV");
+    if (fr != FR_OK)
+    {
+        printf("FALHA: FatFs %d\n", fr);
+        return 1;
+    }
+
+    // Referência: o texto do sprintf para as mesmas amostras
+    size_t tam_ref = strlen(CABECALHO);
+    char *ref = malloc(tam_ref + (size_t)num_linhas * 80 + 1);
+    strcpy(ref, CABECALHO);
+    for (int i = 0; i < num_linhas; i++)
+        tam_ref += linha_sprintf(ref + tam_ref, 80, &linhas[i]);
+
+    UINT tam_csv;
+    char *gravado = ler_do_cartao("MPU6050.CSV", &tam_csv);
+    if (!gravado)
+    {
+        printf("FALHA: não foi possível ler o CSV do cartão simulado\n");
+        return 1;
+    }
+    printf("%d linhas de %s\n", num_linhas, argv[1]);
+    comparar("csv.h x sprintf", gravado, tam_csv, ref, tam_ref);
+    comparar("csv.h x arquivo gravado pela placa", gravado, tam_csv, original, tam_original);
+
+    varrer_valores();
+    medir();
+
+    free(gravado);
+    free(ref);
+    free(original);
+    return falhas ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+// Motor do espectro (espectro.h) no PC, sobre quadros montados com as amostras
+// do acelerômetro do MPU6050_data1.csv. Para cada N e janela, calcula a média de
+// ESP_TESTE_MEDIAS quadros pelo mesmo caminho do log contínuo (esp_bloco em blocos
+// de AQ_BLOCO, esp_pendente/esp_calcular, esp_fechar) e grava, em sequência, o
+// registro e as amostras de cada quadro, para compara_espectro.py conferir com o numpy.
+//
+// Uso: teste_espectro <MPU6050_data1.csv> <saída.bin>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lib/FatFs_SPI/espectro.h"
+
+#define MAX_LINHAS 1024
+#define ESP_TESTE_MEDIAS 4
+#define ESP_TESTE_HZ 100
+#define DESLOCAMENTO 29 // Cada quadro começa 29 linhas adiante, para não repetir o anterior
+
+static int16_t accel[MAX_LINHAS][3];
+static int num_linhas;
+
+static bool carregar(const char *nome)
+{
+    FILE *f = fopen(nome, "r");
+    if (!f)
+        return false;
+    char linha[128];
+    fgets(linha, sizeof linha, f); // Cabeçalho
+    int n;
+    float ax, ay, az;
+    while (num_linhas < MAX_LINHAS && fgets(linha, sizeof linha, f) &&
+           4 == sscanf(linha, "%d,%f,%f,%f", &n, &ax, &ay, &az))
+    {
+        // Contagens brutas a ±2 g, como o firmware grava no log
+        accel[num_linhas][0] = (int16_t)lroundf(ax * 16384.0f);
+        accel[num_linhas][1] = (int16_t)lroundf(ay * 16384.0f);
+        accel[num_linhas][2] = (int16_t)lroundf(az * 16384.0f);
+        num_linhas++;
+    }
+    fclose(f);
+    return num_linhas > 0;
+}
+
+// Amostra j do fluxo: as linhas do arquivo em ordem, começando mais adiante a cada quadro.
+static void amostra(uint32_t j, uint32_t n, amostra_t *a)
+{
+    uint32_t l = (j + (j / n) * DESLOCAMENTO) % num_linhas;
+    a->t_us = j * (1000000 / ESP_TESTE_HZ);
+    for (int e = 0; e < 3; e++)
+    {
+        a->accel[e] = accel[l][e];
+        a->gyro[e] = 0;
+    }
+}
+
+static bool calcular(FILE *saida, uint32_t n, esp_janela_t janela)
+{
+    esp_iniciar(n, ESP_TESTE_MEDIAS, janela, ESP_TESTE_HZ);
+    uint32_t total = n * ESP_TESTE_MEDIAS;
+    for (uint32_t j = 0; j < total; j += AQ_BLOCO)
+    {
+        amostra_t b[AQ_BLOCO];
+        uint32_t m = total - j < AQ_BLOCO ? total - j : AQ_BLOCO;
+        for (uint32_t i = 0; i < m; i++)
+            amostra(j + i, n, &b[i]);
+        esp_bloco(b, m);
+        // O núcleo 1 do firmware; aqui o cálculo acontece na hora
+        esp_quadro_t *q;
+        while ((q = esp_pendente()))
+        {
+            q->estado = ESP_CALCULANDO;
+            esp_calcular(q);
+        }
+    }
+    if (!esp_fechar(false) || esp.registro.quadros != ESP_TESTE_MEDIAS || esp.perdidas)
+    {
+        printf("FALHA: N=%lu janela %d: média não fechou (%u quadros, %lu perdidas)\n",
+               (unsigned long)n, janela, esp.registro.quadros, (unsigned long)esp.perdidas);
+        return false;
+    }
+    fwrite(&esp.registro, 1, esp_tamanho_registro(), saida);
+    for (uint32_t k = 0; k < ESP_TESTE_MEDIAS; k++)
+        for (int e = 0; e < ESP_EIXOS; e++)
+            for (uint32_t i = 0; i < n; i++)
+            {
+                amostra_t a;
+                amostra(k * n + i, n, &a);
+                fwrite(&a.accel[e], sizeof a.accel[e], 1, saida);
+            }
+    esp.pronto = false;
+    printf("N=%4lu janela %d: expoentes %d %d %d\n", (unsigned long)n, janela,
+           esp.registro.expoente[0], esp.registro.expoente[1], esp.registro.expoente[2]);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        printf("Uso: %s <MPU6050_data1.csv> <saída.bin>\n", argv[0]);
+        return 2;
+    }
+    if (!carregar(argv[1]))
+    {
+        printf("FALHA: não foi possível ler %s\n", argv[1]);
+        return 1;
+    }
+    FILE *saida = fopen(argv[2], "wb");
+    if (!saida)
+    {
+        printf("FALHA: não foi possível criar %s\n", argv[2]);
+        return 1;
+    }
+    bool ok = true;
+    for (uint32_t n = ESP_N_MIN; n <= ESP_N_MAX; n <<= 1)
+        for (int janela = ESP_JANELA_RET; janela <= ESP_JANELA_HAMMING; janela++)
+            ok &= calcular(saida, n, (esp_janela_t)janela);
+    fclose(saida);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+// Teste do f_gets no PC: a versão que lê do buffer do setor precisa devolver as
+// mesmas linhas, e deixar o arquivo na mesma posição, que a leitura byte a byte
+// do FatFs original (API em UTF-8, arquivo em UTF-8, como no firmware).
+//
+// 1. Um arquivo com linhas aleatórias de ASCII, caracteres de 2, 3 e 4 bytes,
+//    \r, sequências inválidas e linhas maiores que um setor.
+// 2. Um arquivo em que cada caractere multibyte começa 1, 2 ou 3 bytes antes do
+//    fim de um setor, e que termina com uma sequência cortada.
+// Cada um é lido com vários tamanhos de buffer, a partir de vários deslocamentos.
+//
+// Uso: teste_fgets
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ff.h"
+#include "disco_ram.h"
+
+#if FF_LFN_UNICODE != 2 || FF_STRF_ENCODE != 3 || FF_USE_STRFUNC != 1
+#error O modelo abaixo é o do firmware: FF_LFN_UNICODE 2, FF_STRF_ENCODE 3, FF_USE_STRFUNC 1
+#endif
+
+#define TAM_MAX (64 * 1024)
+#define SETOR 512
+
+static uint8_t dados[TAM_MAX];
+static size_t tam;
+static int falhas;
+static uint32_t x = 2463534242u;
+
+static uint32_t aleatorio()
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+static void por(const char *s, size_t n)
+{
+    memcpy(dados + tam, s, n);
+    tam += n;
+}
+
+// Caracteres válidos de 2, 3 e 4 bytes e sequências que o f_gets descarta
+static const char *const multibyte[] = {"\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80"};
+static const char *const invalidas[] = {
+    "\xFF",             // Não inicia sequência
+    "\x80",             // Continuação solta
+    "\xC0\x80",         // Forma longa de U+0000
+    "\xED\xA0\x80",     // Surrogate
+    "\xF4\x90\x80\x80", // Acima de U+10FFFF
+    "\xE2\x28\xA1",     // Continuação faltando
+};
+
+static void gerar_aleatorio()
+{
+    tam = 0;
+    while (tam < TAM_MAX - 8)
+    {
+        uint32_t r = aleatorio() % 100;
+        if (r < 60)
+            dados[tam++] = ' ' + aleatorio() % 95;
+        else if (r < 63)
+            dados[tam++] = '\n';
+        else if (r < 64)
+            dados[tam++] = '\r';
+        else if (r < 94)
+        {
+            const char *s = multibyte[aleatorio() % 3];
+            por(s, strlen(s));
+        }
+        else
+        {
+            const char *s = invalidas[aleatorio() % (sizeof invalidas / sizeof invalidas[0])];
+            por(s, strlen(s));
+        }
+    }
+}
+
+static void gerar_fronteiras()
+{
+    tam = 0;
+    for (int setor = 1; tam < TAM_MAX - 3 * SETOR; setor++)
+    {
+        const char *s = multibyte[setor % 3];
+        size_t antes = 1 + setor / 3 % 3; // Bytes do caractere no setor anterior
+        if (antes >= strlen(s))
+            antes = strlen(s) - 1;
+        for (; tam % SETOR != SETOR - antes; tam++)
+            dados[tam] = tam % 97 == 0 ? '\n' : 'a' + tam % 26;
+        por(s, strlen(s));
+        if (setor % 5 == 0)
+            dados[tam++] = '\n'; // Às vezes a linha acaba logo depois dele
+    }
+    por("\xF0\x9F", 2); // Cortada pelo fim do arquivo
+}
+
+/**
+ * O f_gets original sobre os bytes em memória: um f_read por byte, com a mesma
+ * decodificação de UTF-8 e o mesmo descarte de sequências inválidas.
+ */
+static char *gets_modelo(char *buff, int len, size_t *pos)
+{
+    int nc = 0;
+    char *p = buff;
+    len -= 4;
+    while (nc < len)
+    {
+        if (*pos >= tam)
+            break;
+        uint32_t dc = dados[(*pos)++];
+        if (dc >= 0x80)
+        {
+            unsigned ct = 0;
+            if ((dc & 0xE0) == 0xC0)
+            {
+                dc &= 0x1F;
+                ct = 1;
+            }
+            if ((dc & 0xF0) == 0xE0)
+            {
+                dc &= 0x0F;
+                ct = 2;
+            }
+            if ((dc & 0xF8) == 0xF0)
+            {
+                dc &= 0x07;
+                ct = 3;
+            }
+            if (ct == 0)
+                continue;
+            size_t rc = tam - *pos < ct ? tam - *pos : ct; // f_read dos bytes seguintes
+            const uint8_t *s = dados + *pos;
+            *pos += rc;
+            if (rc != ct)
+                break;
+            rc = 0;
+            do
+            {
+                if ((s[rc] & 0xC0) != 0x80)
+                    break;
+                dc = dc << 6 | (s[rc] & 0x3F);
+            } while (++rc < ct);
+            if (rc != ct || dc < 0x80 || (dc >= 0xD800 && dc <= 0xDFFF) || dc >= 0x110000)
+                continue;
+        }
+        if (dc < 0x80)
+        {
+            *p++ = (char)dc;
+            nc++;
+            if (dc == '\n')
+                break;
+        }
+        else if (dc < 0x800)
+        {
+            *p++ = (char)(0xC0 | (dc >> 6 & 0x1F));
+            *p++ = (char)(0x80 | (dc & 0x3F));
+            nc += 2;
+        }
+        else if (dc < 0x10000)
+        {
+            *p++ = (char)(0xE0 | (dc >> 12 & 0x0F));
+            *p++ = (char)(0x80 | (dc >> 6 & 0x3F));
+            *p++ = (char)(0x80 | (dc & 0x3F));
+            nc += 3;
+        }
+        else
+        {
+            *p++ = (char)(0xF0 | (dc >> 18 & 0x07));
+            *p++ = (char)(0x80 | (dc >> 12 & 0x3F));
+            *p++ = (char)(0x80 | (dc >> 6 & 0x3F));
+            *p++ = (char)(0x80 | (dc & 0x3F));
+            nc += 4;
+        }
+    }
+    *p = 0;
+    return nc ? buff : NULL;
+}
+
+// Lê o arquivo inteiro a partir de inicio com buffers de len bytes, comparando com o modelo.
+static void comparar(const char *oque, FIL *f, size_t inicio, int len)
+{
+    char lido[2048], esperado[2048];
+    size_t pos = inicio;
+    if (FR_OK != f_lseek(f, inicio))
+    {
+        printf("FALHA: %s: f_lseek(%zu)\n", oque, inicio);
+        falhas++;
+        return;
+    }
+    for (int linha = 1;; linha++)
+    {
+        char *a = f_gets(lido, len, f);
+        char *b = gets_modelo(esperado, len, &pos);
+        if ((a == NULL) != (b == NULL) || (a && strcmp(a, b)) || f_tell(f) != pos)
+        {
+            printf("FALHA: %s, buffer de %d, início %zu, chamada %d: posição %lu x %zu\n", oque, len,
+                   inicio, linha, (unsigned long)f_tell(f), pos);
+            falhas++;
+            return;
+        }
+        if (!a)
+            return;
+    }
+}
+
+static void testar(const char *nome, const char *oque)
+{
+    FIL f;
+    UINT bw;
+    FRESULT fr = f_open(&f, nome, FA_WRITE | FA_CREATE_ALWAYS);
+    if (FR_OK == fr)
+        fr = f_write(&f, dados, (UINT)tam, &bw);
+    if (FR_OK == fr)
+        fr = f_close(&f);
+    if (FR_OK == fr)
+        fr = f_open(&f, nome, FA_READ);
+    if (FR_OK != fr)
+    {
+        printf("FALHA: %s: FatFs %d\n", oque, fr);
+        falhas++;
+        return;
+    }
+    static const int lens[] = {5, 6, 7, 8, 9, 16, 100, 255, 256, 511, 512, 513, 1024, 2048};
+    static const size_t inicios[] = {0, 1, 2, 3, 509, 510, 511, 512, 513, 1021, 1022, 1023, 4097};
+    int antes = falhas;
+    for (size_t i = 0; i < sizeof lens / sizeof lens[0]; i++)
+        for (size_t j = 0; j < sizeof inicios / sizeof inicios[0]; j++)
+            comparar(oque, &f, inicios[j], lens[i]);
+    f_close(&f);
+    if (falhas == antes)
+        printf("ok: %s (%zu bytes, %zu buffers x %zu inícios)\n", oque, tam,
+               sizeof lens / sizeof lens[0], sizeof inicios / sizeof inicios[0]);
+}
+
+int main()
+{
+    static FATFS fs;
+    FRESULT fr = disco_ram_montar(&fs);
+    if (FR_OK != fr)
+    {
+        printf("FALHA: FatFs %d\n", fr);
+        return 1;
+    }
+    gerar_aleatorio();
+    testar("ALEAT.TXT", "texto aleatório");
+    gerar_fronteiras();
+    testar("FRONT.TXT", "multibyte na fronteira do setor");
+    return falhas ? 1 : 0;
+}
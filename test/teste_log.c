@@ -0,0 +1,222 @@
+// Ida e volta do log contínuo no PC: amostras montadas com o MPU6050_data1.csv são
+// gravadas pelo mesmo caminho do firmware (comp_bloco, registros de tipo 1 ou 0 no
+// ring_log, com trocas de segmento) no cartão simulado. Os segmentos são copiados
+// para a pasta <saída> e as amostras vão para <esperado.csv>, no formato do
+// decodifica_log.py: o teste log_decodifica converte os segmentos com ele e o
+// log_compara confere que os dois CSV são iguais.
+//
+// Os blocos cobrem o que o decodificador precisa reproduzir: t_us que dá a volta
+// em 32 bits, período com atraso variável, saltos de ±32767 (resíduos de 17 bits),
+// blocos brutos (incompressíveis ou com -r) e o bloco parcial do log stop, até
+// uma amostra só.
+//
+// Uso: teste_log <MPU6050_data1.csv> <saída> <esperado.csv>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "ff.h"
+#include "disco_ram.h"
+#include "f_util.h"
+#include "ring_log.h"
+#include "lib/FatFs_SPI/compressao.h"
+
+#define MAX_LINHAS 1024
+#define BLOCOS 3000
+#define LOG_HZ 100
+
+static int16_t csv[MAX_LINHAS][6];
+static int num_linhas;
+static int falhas;
+
+// O ring_log.c usa o my_debug.h do driver; o my_debug.c é só para o RP2040.
+void my_printf(const char *pcFormat, ...) {}
+
+void my_assert_func(const char *file, int line, const char *func, const char *pred)
+{
+    printf("FALHA: \"%s\" em %s:%d (%s)\n", pred, file, line, func);
+    exit(1);
+}
+
+static bool carregar(const char *nome)
+{
+    FILE *f = fopen(nome, "r");
+    if (!f)
+        return false;
+    char linha[128];
+    fgets(linha, sizeof linha, f); // Cabeçalho
+    int n;
+    float v[6];
+    while (num_linhas < MAX_LINHAS && fgets(linha, sizeof linha, f) &&
+           7 == sscanf(linha, "%d,%f,%f,%f,%f,%f,%f", &n, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]))
+    {
+        // Contagens a ±2 g; os ângulos, em centésimos de grau, fazem o papel do giroscópio
+        for (int c = 0; c < 3; c++)
+        {
+            csv[num_linhas][c] = (int16_t)lroundf(v[c] * 16384.0f);
+            csv[num_linhas][3 + c] = (int16_t)lroundf(v[3 + c] * 100.0f);
+        }
+        num_linhas++;
+    }
+    fclose(f);
+    return num_linhas > 0;
+}
+
+static uint32_t x = 2463534242u;
+
+static uint32_t aleatorio()
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// Bloco k do fluxo: n amostras a partir do instante *t, que avança.
+static uint32_t montar(uint32_t k, amostra_t *a, uint32_t *t)
+{
+    uint32_t n = AQ_BLOCO;
+    if (k == BLOCOS - 2)
+        n = 13; // Resto de um bloco no log stop
+    else if (k == BLOCOS - 1)
+        n = 1;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const int16_t *l = csv[(k * AQ_BLOCO + i) % num_linhas];
+        a[i].t_us = *t;
+        // O temporizador atrasa um pouco de vez em quando
+        *t += 1000000 / LOG_HZ + (k % 4 == 1 ? aleatorio() % 300 : 0);
+        for (int c = 0; c < 3; c++)
+        {
+            a[i].accel[c] = l[c];
+            a[i].gyro[c] = l[3 + c];
+        }
+        if (k % 10 == 3)
+            a[i].accel[i % 3] = i & 1 ? INT16_MAX : INT16_MIN; // Resíduos de 17 bits
+        else if (k % 10 == 7)
+        {
+            // Ruído em tudo, até no intervalo: o bloco comprimido ficaria maior que o bruto
+            for (int c = 0; c < 3; c++)
+            {
+                a[i].accel[c] = (int16_t)aleatorio();
+                a[i].gyro[c] = (int16_t)aleatorio();
+            }
+            *t += aleatorio() % (1u << 24);
+        }
+    }
+    return n;
+}
+
+static FRESULT copiar(const char *origem, const char *destino)
+{
+    static BYTE buf[64 * 1024];
+    FIL f;
+    UINT br;
+    FRESULT fr = f_open(&f, origem, FA_READ);
+    if (FR_OK != fr)
+        return fr;
+    FILE *h = fopen(destino, "wb");
+    while (h && FR_OK == (fr = f_read(&f, buf, sizeof buf, &br)) && br)
+        fwrite(buf, 1, br, h);
+    f_close(&f);
+    if (!h)
+        return FR_DENIED;
+    fclose(h);
+    return fr;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 4)
+    {
+        printf("Uso: %s <MPU6050_data1.csv> <saída> <esperado.csv>\n", argv[0]);
+        return 2;
+    }
+    if (!carregar(argv[1]))
+    {
+        printf("FALHA: não foi possível ler %s\n", argv[1]);
+        return 1;
+    }
+    static FATFS fs;
+    FRESULT fr = disco_ram_montar(&fs);
+    // Segmentos pequenos, para o fluxo passar por vários; cota que guarda todos
+    static ring_log_t rl = {.dir = "LOGS", .segment_size = 64 * 1024, .max_segments = 100,
+                            .sync_bytes = 8 * 1024};
+    if (FR_OK == fr)
+        fr = ring_log_open(&rl);
+    FILE *esperado = fopen(argv[3], "w");
+    if (FR_OK != fr || !esperado)
+    {
+        printf("FALHA: FatFs %d\n", fr);
+        return 1;
+    }
+    fprintf(esperado, "t_us,accel_x,accel_y,accel_z,giro_x,giro_y,giro_z\n");
+
+    uint32_t t = 4294000000u; // Dá a volta em 32 bits logo no começo do log
+    uint64_t t64 = 0;
+    uint32_t comprimidos = 0, brutos = 0;
+    for (uint32_t k = 0; k < BLOCOS && FR_OK == fr; k++)
+    {
+        amostra_t a[AQ_BLOCO], volta[255];
+        uint8_t comp[sizeof a];
+        uint32_t t0 = t;
+        uint32_t n = montar(k, a, &t);
+        uint32_t tam = k % 50 == 49 ? 0 : comp_bloco(a, n, comp); // Às vezes bruto, como com -r
+        if (tam && (comp_expandir(comp, tam, volta) != n || memcmp(volta, a, n * sizeof a[0])))
+        {
+            printf("FALHA: comp_expandir difere de comp_bloco no bloco %lu\n", (unsigned long)k);
+            falhas++;
+        }
+        t64 += (uint32_t)(t - t0);
+        fr = tam ? ring_log_write_at(&rl, COMP_TIPO_REGISTRO, comp, tam, t64)
+                 : ring_log_write_at(&rl, 0, a, n * sizeof a[0], t64);
+        if (FR_OK == fr)
+            fr = ring_log_service(&rl);
+        if (tam)
+            comprimidos++;
+        else
+            brutos++;
+        for (uint32_t i = 0; i < n; i++)
+            fprintf(esperado, "%lu,%d,%d,%d,%d,%d,%d\n", (unsigned long)a[i].t_us, a[i].accel[0],
+                    a[i].accel[1], a[i].accel[2], a[i].gyro[0], a[i].gyro[1], a[i].gyro[2]);
+    }
+    if (FR_OK == fr)
+        fr = ring_log_close(&rl);
+    fclose(esperado);
+    if (FR_OK != fr)
+    {
+        printf("FALHA: ring_log: %s (%d)\n", FRESULT_str(fr), fr);
+        return 1;
+    }
+
+    // Os segmentos, do cartão simulado para a pasta do decodificador
+    mkdir(argv[2], 0777);
+    uint32_t segmentos = 0;
+    DIR dj;
+    FILINFO fno;
+    fr = f_findfirst(&dj, &fno, "LOGS", "LOG????.BIN");
+    while (FR_OK == fr && fno.fname[0])
+    {
+        char origem[FF_LFN_BUF + 8], destino[1024];
+        snprintf(origem, sizeof origem, "LOGS/%s", fno.fname);
+        snprintf(destino, sizeof destino, "%s/%s", argv[2], fno.fname);
+        fr = copiar(origem, destino);
+        segmentos++;
+        if (FR_OK == fr)
+            fr = f_findnext(&dj, &fno);
+    }
+    f_closedir(&dj);
+    if (FR_OK != fr || segmentos < 2)
+    {
+        printf("FALHA: cópia dos segmentos: %s (%d), %lu segmentos\n", FRESULT_str(fr), fr,
+               (unsigned long)segmentos);
+        return 1;
+    }
+    printf("%lu blocos (%lu comprimidos, %lu brutos) em %lu segmentos, %lu registros\n",
+           (unsigned long)BLOCOS, (unsigned long)comprimidos, (unsigned long)brutos,
+           (unsigned long)segmentos, (unsigned long)rl.seq);
+    return falhas ? 1 : 0;
+}